@@ -134,6 +134,17 @@
 #define likely(expr)     expect((expr) != 0, 1)
 #define unlikely(expr)   expect((expr) != 0, 0)
 
+#if (GCC_VERSION >= 302) || (__INTEL_COMPILER >= 800) || defined(__clang__)
+#  define LZ4_prefetchRead(ptr)    __builtin_prefetch((ptr), 0)
+#  define LZ4_prefetchWrite(ptr)   __builtin_prefetch((ptr), 1)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define LZ4_prefetchRead(ptr)    _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#  define LZ4_prefetchWrite(ptr)   _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#else
+#  define LZ4_prefetchRead(ptr)    (void)(ptr)
+#  define LZ4_prefetchWrite(ptr)   (void)(ptr)
+#endif
+
 
 /**************************************
    Memory routines
@@ -268,17 +279,9 @@ static void LZ4_copy4(void* dstPtr, const void* srcPtr)
 
 static void LZ4_copy8(void* dstPtr, const void* srcPtr)
 {
-#if GCC_VERSION!=409  /* disabled on GCC 4.9, as it generates invalid opcode (crash) */
-    if (LZ4_UNALIGNED_ACCESS)
-    {
-        if (LZ4_64bits())
-            *(U64*)dstPtr = *(U64*)srcPtr;
-        else
-            ((U32*)dstPtr)[0] = ((U32*)srcPtr)[0],
-            ((U32*)dstPtr)[1] = ((U32*)srcPtr)[1];
-        return;
-    }
-#endif
+    /* memcpy() of a constant size is a single load/store on targets with unaligned access,
+     * but unlike a U64 dereference, it does not allow the compiler to assume 8-bytes alignment :
+     * GCC 4.9 generates invalid opcodes, and more recent GCC -O3 vectorizes LZ4_wildCopy() incorrectly */
     memcpy(dstPtr, srcPtr, 8);
 }
 
@@ -292,6 +295,87 @@ static void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
 }
 
 
+/**************************************
+   Runtime CPU dispatch
+**************************************/
+/*
+ * LZ4_DISPATCH :
+ * with GCC on x86, hot kernels are compiled a second time for a more recent instruction set,
+ * and selected at runtime when the CPU supports it (see LZ4_cpuFeatures()) :
+ * - decoder : copies by 16 bytes, and expands overlapping matches (offset < 16)
+ *   with a single byte shuffle (SSSE3 pshufb), instead of 4 + 4 bytes then 8-bytes steps.
+ * - compressors (fast and HC) : AVX2 + BMI2 code generation (tzcnt in LZ4_NbCommonBytes()).
+ * This way, baseline x86-64 builds (distribution packages) benefit from them too.
+ * Define LZ4_DISPATCH to 0 to only keep kernels compiled for the build target.
+ */
+#ifndef LZ4_DISPATCH
+#  if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && (GCC_VERSION >= 600) && (defined(__x86_64__) || defined(__i386__))
+#    define LZ4_DISPATCH 1
+#  else
+#    define LZ4_DISPATCH 0
+#  endif
+#endif
+
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define LZ4_VECTOR_DECODE 1
+#  define LZ4_TARGET_SSSE3
+   typedef __m128i LZ4_vec16;
+#  define LZ4_shuffle16(v, mask)   _mm_shuffle_epi8((v), (mask))
+#elif LZ4_DISPATCH
+#  define LZ4_VECTOR_DECODE 1
+#  define LZ4_TARGET_SSSE3 __attribute__((target("ssse3")))
+   typedef BYTE LZ4_vec16 __attribute__((vector_size(16)));
+#  define LZ4_shuffle16(v, mask)   __builtin_shuffle((v), (mask))
+#else
+#  define LZ4_VECTOR_DECODE 0
+#endif
+
+#define LZ4_KERNEL_AVX2 (LZ4_CPU_AVX2 | LZ4_CPU_BMI2)   /* required by the AVX2 compression kernels */
+#if LZ4_DISPATCH && !(defined(__AVX2__) && defined(__BMI__) && defined(__BMI2__))
+#  define LZ4_COMPRESS_AVX2 1
+#  define LZ4_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2")))
+#else
+#  define LZ4_COMPRESS_AVX2 0   /* not available, or already the build target */
+#endif
+
+#if LZ4_VECTOR_DECODE
+/* same as LZ4_wildCopy(), by 16-bytes steps : may overwrite up to 15 bytes beyond dstEnd */
+static void LZ4_wildCopy16(void* dstPtr, const void* srcPtr, void* dstEnd)
+{
+    BYTE* d = (BYTE*)dstPtr;
+    const BYTE* s = (const BYTE*)srcPtr;
+    BYTE* e = (BYTE*)dstEnd;
+    do { memcpy(d,s,16); d+=16; s+=16; } while (d<e);
+}
+
+static LZ4_vec16 LZ4_readVec16(const void* memPtr) { LZ4_vec16 v; memcpy(&v, memPtr, sizeof(v)); return v; }
+static void LZ4_writeVec16(void* memPtr, LZ4_vec16 v) { memcpy(memPtr, &v, sizeof(v)); }
+
+/* LZ4_vecPattern[offset] : shuffle mask repeating the first 'offset' bytes of a match over 16 bytes.
+ * It can be stored again every LZ4_vecStep[offset] bytes (largest multiple of offset <= 16).
+ * offset 0 is invalid : it just produces garbage, within the output buffer */
+static const BYTE LZ4_vecPattern[16][16] = {
+    { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 },
+    { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 },
+    { 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 },
+    { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+    { 0,1,2,3,0,1,2,3,0,1,2,3,0,1,2,3 },
+    { 0,1,2,3,4,0,1,2,3,4,0,1,2,3,4,0 },
+    { 0,1,2,3,4,5,0,1,2,3,4,5,0,1,2,3 },
+    { 0,1,2,3,4,5,6,0,1,2,3,4,5,6,0,1 },
+    { 0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7 },
+    { 0,1,2,3,4,5,6,7,8,0,1,2,3,4,5,6 },
+    { 0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5 },
+    { 0,1,2,3,4,5,6,7,8,9,10,0,1,2,3,4 },
+    { 0,1,2,3,4,5,6,7,8,9,10,11,0,1,2,3 },
+    { 0,1,2,3,4,5,6,7,8,9,10,11,12,0,1,2 },
+    { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,0,1 },
+    { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,0 } };
+static const BYTE LZ4_vecStep[16] = { 16, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+#endif
+
+
 /**************************************
    Common Constants
 **************************************/
@@ -324,7 +408,7 @@ static const int LZ4_minLength = (MFLIMIT+1);
 /**************************************
 *  Common functions
 **************************************/
-static unsigned LZ4_NbCommonBytes (register size_t val)
+FORCE_INLINE unsigned LZ4_NbCommonBytes (register size_t val)
 {
     if (LZ4_isLittleEndian())
     {
@@ -391,10 +475,46 @@ static unsigned LZ4_NbCommonBytes (register size_t val)
     }
 }
 
-static unsigned LZ4_count(const BYTE* pIn, const BYTE* pMatch, const BYTE* pInLimit)
+/*
+ * LZ4_VECTOR_COUNT :
+ * match length is extended by 16 bytes per step, using a vector compare and a byte mask (SSE2 pcmpeqb + pmovmskb),
+ * then the first different byte is found with a bit scan. SSE2 is part of x86-64 : no runtime selection is needed.
+ */
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(LZ4_FORCE_SW_BITCOUNT)
+#  include <emmintrin.h>
+#  define LZ4_VECTOR_COUNT 1
+/* bit n is set when byte n of p1 and p2 differ */
+FORCE_INLINE unsigned LZ4_diffMask16(const void* p1, const void* p2)
+{
+    __m128i const v1 = _mm_loadu_si128((const __m128i*)p1);
+    __m128i const v2 = _mm_loadu_si128((const __m128i*)p2);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v1, v2)) ^ 0xFFFF;
+}
+#else
+#  define LZ4_VECTOR_COUNT 0
+#endif
+
+FORCE_INLINE unsigned LZ4_count(const BYTE* pIn, const BYTE* pMatch, const BYTE* pInLimit)
 {
     const BYTE* const pStart = pIn;
 
+#if LZ4_VECTOR_COUNT
+    /* most matches are short : first step stays scalar, it has the lowest latency */
+    if (likely(pIn<pInLimit-(STEPSIZE-1)))
+    {
+        size_t const diff = LZ4_read_ARCH(pMatch) ^ LZ4_read_ARCH(pIn);
+        if (diff) return LZ4_NbCommonBytes(diff);
+        pIn+=STEPSIZE; pMatch+=STEPSIZE;
+    }
+    while (likely(pIn<pInLimit-15))
+    {
+        unsigned const diff = LZ4_diffMask16(pMatch, pIn);
+        if (!diff) { pIn+=16; pMatch+=16; continue; }
+        pIn += __builtin_ctz(diff);
+        return (unsigned)(pIn - pStart);
+    }
+#endif
+
     while (likely(pIn<pInLimit-(STEPSIZE-1)))
     {
         size_t diff = LZ4_read_ARCH(pMatch) ^ LZ4_read_ARCH(pIn);
@@ -409,6 +529,25 @@ static unsigned LZ4_count(const BYTE* pIn, const BYTE* pMatch, const BYTE* pInLi
     return (unsigned)(pIn - pStart);
 }
 
+/* LZ4_countBack() : number of identical bytes just before pIn and pMatch, without going below pInMin nor pMatchMin */
+FORCE_INLINE unsigned LZ4_countBack(const BYTE* pIn, const BYTE* pMatch, const BYTE* const pInMin, const BYTE* const pMatchMin)
+{
+    const BYTE* const pStart = pIn;
+
+#if LZ4_VECTOR_COUNT
+    while ((pIn-pInMin >= 16) && (pMatch-pMatchMin >= 16))
+    {
+        unsigned const diff = LZ4_diffMask16(pMatch-16, pIn-16);
+        if (!diff) { pIn-=16; pMatch-=16; continue; }
+        pIn -= __builtin_clz(diff) - 16;   /* identical bytes are the highest ones : leading zeros of a 16-bits mask */
+        return (unsigned)(pStart - pIn);
+    }
+#endif
+
+    while ((pIn>pInMin) && (pMatch>pMatchMin) && (pIn[-1] == pMatch[-1])) { pIn--; pMatch--; }
+    return (unsigned)(pStart - pIn);
+}
+
 
 #ifndef LZ4_COMMONDEFS_ONLY
 /**************************************
@@ -420,6 +559,7 @@ static unsigned LZ4_count(const BYTE* pIn, const BYTE* pMatch, const BYTE* pInLi
 
 static const int LZ4_64Klimit = ((64 KB) + (MFLIMIT-1));
 static const U32 LZ4_skipTrigger = 6;  /* Increase this value ==> compression run slower on incompressible data */
+static const int LZ4_batchShareLimit = 512;   /* larger inputs get a clean table : left-over positions would cost more in branch mispredictions than a reset */
 
 
 /**************************************
@@ -429,6 +569,90 @@ int LZ4_versionNumber (void) { return LZ4_VERSION_NUMBER; }
 int LZ4_compressBound(int isize)  { return LZ4_COMPRESSBOUND(isize); }
 
 
+/**************************************
+*  CPU dispatch
+**************************************/
+#define LZ4_CPU_DETECTED 0x80000000U   /* set once detection is done */
+
+/* Detection is done lazily, by whichever thread compresses or decompresses first :
+ * both settings are single words, read and written atomically (relaxed ordering is enough,
+ * as each value is self-contained, and concurrent first detections store the same one) */
+#if defined(__ATOMIC_RELAXED)   /* GCC >= 4.7, clang */
+#  define LZ4_atomicLoad(ptr)         __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#  define LZ4_atomicStore(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELAXED)
+#else   /* other compilers do not dispatch (LZ4_DISPATCH) : values only change through LZ4_limitCpuFeatures() */
+#  define LZ4_atomicLoad(ptr)         (*(volatile unsigned*)(ptr))
+#  define LZ4_atomicStore(ptr, value) (*(volatile unsigned*)(ptr) = (value))
+#endif
+
+static unsigned LZ4_cpuDetected = 0;
+static unsigned LZ4_cpuAllowed = ~0U;
+
+/* instruction sets of the build target : kernels may use them unconditionally */
+static unsigned LZ4_cpuTarget(void)
+{
+    unsigned features = 0;
+#if defined(__SSSE3__)
+    features |= LZ4_CPU_SSSE3;
+#endif
+#if defined(__SSE4_2__)
+    features |= LZ4_CPU_SSE42;
+#endif
+#if defined(__AVX2__)
+    features |= LZ4_CPU_AVX2;
+#endif
+#if defined(__BMI__) && defined(__BMI2__)
+    features |= LZ4_CPU_BMI2;
+#endif
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__)
+    features |= LZ4_CPU_AVX512;
+#endif
+    return features;
+}
+
+static unsigned LZ4_detectCpuFeatures(void)
+{
+    unsigned features = LZ4_cpuTarget();
+#if LZ4_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) features |= LZ4_CPU_SSSE3;
+    if (__builtin_cpu_supports("sse4.2")) features |= LZ4_CPU_SSE42;
+    if (__builtin_cpu_supports("avx2")) features |= LZ4_CPU_AVX2;
+    if (__builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2")) features |= LZ4_CPU_BMI2;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) features |= LZ4_CPU_AVX512;
+#endif
+    return features;
+}
+
+unsigned LZ4_cpuFeatures(void)
+{
+    unsigned detected = LZ4_atomicLoad(&LZ4_cpuDetected);
+    if (!detected)
+    {
+        detected = LZ4_detectCpuFeatures() | LZ4_CPU_DETECTED;
+        LZ4_atomicStore(&LZ4_cpuDetected, detected);
+    }
+    return (detected & LZ4_atomicLoad(&LZ4_cpuAllowed) & ~LZ4_CPU_DETECTED) | LZ4_cpuTarget();
+}
+
+unsigned LZ4_limitCpuFeatures(unsigned allowedFeatures)
+{
+    LZ4_atomicStore(&LZ4_cpuAllowed, allowedFeatures);
+    return LZ4_cpuFeatures();
+}
+
+const char* LZ4_kernelName(void)
+{
+    static const char* const names[4] = { "baseline compressor, scalar decoder", "baseline compressor, ssse3 decoder",
+                                          "avx2+bmi2 compressor, scalar decoder", "avx2+bmi2 compressor, ssse3 decoder" };
+    unsigned const features = LZ4_cpuFeatures();
+    int const avx2 = ((LZ4_COMPRESS_AVX2) || (LZ4_cpuTarget() & LZ4_KERNEL_AVX2) == LZ4_KERNEL_AVX2)
+                   && ((features & LZ4_KERNEL_AVX2) == LZ4_KERNEL_AVX2);
+    int const ssse3 = (LZ4_VECTOR_DECODE) && (features & LZ4_CPU_SSSE3);
+    return names[avx2*2 + ssse3];
+}
+
+
 /**************************************
 *  Local Structures and types
 **************************************/
@@ -449,6 +673,7 @@ typedef enum { noDictIssue = 0, dictSmall } dictIssue_directive;
 
 typedef enum { endOnOutputSize = 0, endOnInputSize = 1 } endCondition_directive;
 typedef enum { full = 0, partial = 1 } earlyEnd_directive;
+typedef enum { scalarCopy = 0, vectorCopy = 1 } copy_directive;
 
 
 
@@ -495,7 +720,8 @@ static const BYTE* LZ4_getPosition(const BYTE* p, void* tableBase, tableType_t t
     return LZ4_getPositionOnHash(h, tableBase, tableType, srcBase);
 }
 
-static int LZ4_compress_generic(
+/* always inlined : each caller gets a specialized copy, where directives (tableType, dict, ...) are resolved at compilation time */
+FORCE_INLINE int LZ4_compress_generic(
                  void* ctx,
                  const char* source,
                  char* dest,
@@ -707,6 +933,86 @@ _last_literals:
 }
 
 
+/*
+ * Compression kernels :
+ * all compression entry points go through LZ4_compress_noDict() or LZ4_compress_dict(),
+ * so that each instance of LZ4_compress_generic() is compiled once per supported instruction set.
+ */
+FORCE_INLINE int LZ4_compress_noDict_generic(void* ctx, const char* source, char* dest, int inputSize,
+                                             int maxOutputSize, limitedOutput_directive limit)
+{
+    if (inputSize < LZ4_64Klimit)
+    {
+        if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU16, noDict, noDictIssue);
+        return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU16, noDict, noDictIssue);
+    }
+    if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+    return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+}
+
+/* tableType : byU16 is only used by batches of small inputs, in prefix mode and with dictSmall */
+FORCE_INLINE int LZ4_compress_dict_generic(void* ctx, const char* source, char* dest, int inputSize, int maxOutputSize,
+                                           limitedOutput_directive limit, tableType_t tableType, dict_directive dict, dictIssue_directive dictIssue)
+{
+    if (tableType == byU16)
+    {
+        if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU16, withPrefix64k, dictSmall);
+        return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU16, withPrefix64k, dictSmall);
+    }
+    if (dict == withPrefix64k)
+    {
+        if (dictIssue == dictSmall)
+        {
+            if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU32, withPrefix64k, dictSmall);
+            return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU32, withPrefix64k, dictSmall);
+        }
+        if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU32, withPrefix64k, noDictIssue);
+        return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU32, withPrefix64k, noDictIssue);
+    }
+    if (dictIssue == dictSmall)
+    {
+        if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU32, usingExtDict, dictSmall);
+        return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU32, usingExtDict, dictSmall);
+    }
+    if (limit) return LZ4_compress_generic(ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU32, usingExtDict, noDictIssue);
+    return LZ4_compress_generic(ctx, source, dest, inputSize, 0, notLimited, byU32, usingExtDict, noDictIssue);
+}
+
+#if LZ4_COMPRESS_AVX2
+LZ4_TARGET_AVX2 static int LZ4_compress_noDict_avx2(void* ctx, const char* source, char* dest, int inputSize,
+                                                    int maxOutputSize, limitedOutput_directive limit)
+{
+    return LZ4_compress_noDict_generic(ctx, source, dest, inputSize, maxOutputSize, limit);
+}
+
+LZ4_TARGET_AVX2 static int LZ4_compress_dict_avx2(void* ctx, const char* source, char* dest, int inputSize, int maxOutputSize,
+                                                  limitedOutput_directive limit, tableType_t tableType, dict_directive dict, dictIssue_directive dictIssue)
+{
+    return LZ4_compress_dict_generic(ctx, source, dest, inputSize, maxOutputSize, limit, tableType, dict, dictIssue);
+}
+#endif
+
+static int LZ4_compress_noDict(void* ctx, const char* source, char* dest, int inputSize,
+                               int maxOutputSize, limitedOutput_directive limit)
+{
+#if LZ4_COMPRESS_AVX2
+    if ((LZ4_cpuFeatures() & LZ4_KERNEL_AVX2) == LZ4_KERNEL_AVX2)
+        return LZ4_compress_noDict_avx2(ctx, source, dest, inputSize, maxOutputSize, limit);
+#endif
+    return LZ4_compress_noDict_generic(ctx, source, dest, inputSize, maxOutputSize, limit);
+}
+
+static int LZ4_compress_dict(void* ctx, const char* source, char* dest, int inputSize, int maxOutputSize,
+                             limitedOutput_directive limit, tableType_t tableType, dict_directive dict, dictIssue_directive dictIssue)
+{
+#if LZ4_COMPRESS_AVX2
+    if ((LZ4_cpuFeatures() & LZ4_KERNEL_AVX2) == LZ4_KERNEL_AVX2)
+        return LZ4_compress_dict_avx2(ctx, source, dest, inputSize, maxOutputSize, limit, tableType, dict, dictIssue);
+#endif
+    return LZ4_compress_dict_generic(ctx, source, dest, inputSize, maxOutputSize, limit, tableType, dict, dictIssue);
+}
+
+
 int LZ4_compress(const char* source, char* dest, int inputSize)
 {
 #if (HEAPMODE)
@@ -716,10 +1022,7 @@ int LZ4_compress(const char* source, char* dest, int inputSize)
 #endif
     int result;
 
-    if (inputSize < LZ4_64Klimit)
-        result = LZ4_compress_generic((void*)ctx, source, dest, inputSize, 0, notLimited, byU16, noDict, noDictIssue);
-    else
-        result = LZ4_compress_generic((void*)ctx, source, dest, inputSize, 0, notLimited, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+    result = LZ4_compress_noDict((void*)ctx, source, dest, inputSize, 0, notLimited);
 
 #if (HEAPMODE)
     FREEMEM(ctx);
@@ -736,10 +1039,7 @@ int LZ4_compress_limitedOutput(const char* source, char* dest, int inputSize, in
 #endif
     int result;
 
-    if (inputSize < LZ4_64Klimit)
-        result = LZ4_compress_generic((void*)ctx, source, dest, inputSize, maxOutputSize, limitedOutput, byU16, noDict, noDictIssue);
-    else
-        result = LZ4_compress_generic((void*)ctx, source, dest, inputSize, maxOutputSize, limitedOutput, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+    result = LZ4_compress_noDict((void*)ctx, source, dest, inputSize, maxOutputSize, limitedOutput);
 
 #if (HEAPMODE)
     FREEMEM(ctx);
@@ -748,6 +1048,51 @@ int LZ4_compress_limitedOutput(const char* source, char* dest, int inputSize, in
 }
 
 
+int LZ4_compress_batch_withState (void* state, const char* const* sources, const int* inputSizes,
+                                  char* const* dests, const int* maxOutputSizes, int* results, int nbInputs)
+{
+    LZ4_stream_t_internal* const ctx = (LZ4_stream_t_internal*)state;
+    int n, nbErrors = 0;
+
+    if (((size_t)(state)&3) != 0)   /* Error : state is not aligned on 4-bytes boundary */
+    {
+        for (n=0; n<nbInputs; n++) results[n] = 0;
+        return nbInputs;
+    }
+    MEM_INIT(state, 0, LZ4_STREAMSIZE);
+
+    for (n=0; n<nbInputs; n++)
+    {
+        int const inputSize = inputSizes[n];
+        limitedOutput_directive const limit = (maxOutputSizes[n] < LZ4_compressBound(inputSize)) ? limitedOutput : notLimited;
+
+        if ((inputSize >= 0) && (inputSize <= LZ4_batchShareLimit) && (ctx->currentOffset + (U32)inputSize < (U32)LZ4_64Klimit))
+        {
+            /* Small inputs follow each other within a 64 KB index space : positions left in the table by previous inputs
+               are below the current one, and rejected as out of dictionary (dictSize==0), so the table needs no reset */
+            ctx->dictSize = 0;
+            results[n] = LZ4_compress_dict(state, sources[n], dests[n], inputSize, maxOutputSizes[n], limit, byU16, withPrefix64k, dictSmall);
+            ctx->currentOffset += (U32)inputSize;
+        }
+        else if ((inputSize >= 0) && (inputSize < LZ4_64Klimit))
+        {
+            MEM_INIT(state, 0, LZ4_STREAMSIZE);
+            results[n] = LZ4_compress_noDict(state, sources[n], dests[n], inputSize, maxOutputSizes[n], limit);
+            ctx->currentOffset = (U32)inputSize;   /* same index space : next small inputs can share the table */
+        }
+        else
+        {
+            MEM_INIT(state, 0, LZ4_STREAMSIZE);
+            results[n] = LZ4_compress_noDict(state, sources[n], dests[n], inputSize, maxOutputSizes[n], limitedOutput);
+            ctx->currentOffset = 64 KB;   /* table layout differs : force a reset before next small input */
+        }
+        nbErrors += (results[n]==0);
+    }
+
+    return nbErrors;
+}
+
+
 /*****************************************
 *  Experimental : Streaming functions
 *****************************************/
@@ -762,6 +1107,21 @@ void LZ4_resetStream (LZ4_stream_t* LZ4_stream)
     MEM_INIT(LZ4_stream, 0, sizeof(LZ4_stream_t));
 }
 
+void LZ4_resetStream_fast (LZ4_stream_t* LZ4_stream)
+{
+    LZ4_stream_t_internal* const ctx = (LZ4_stream_t_internal*)LZ4_stream;
+    if ((ctx->initCheck) || (ctx->currentOffset == 0))   /* Uninitialized structure, or table not filled by streaming functions */
+    {
+        LZ4_resetStream(LZ4_stream);
+        return;
+    }
+    /* Table is kept : all positions it contains are below currentOffset, where next block starts.
+       With an empty dictionary, they are rejected as out of dictionary (dictSmall), and can't produce a match.
+       The table is only cleared later, if next input is large enough to make it worthwhile (see LZ4_compress_continue_generic()) */
+    ctx->dictionary = NULL;
+    ctx->dictSize = 0;
+}
+
 LZ4_stream_t* LZ4_createStream(void)
 {
     LZ4_stream_t* lz4s = (LZ4_stream_t*)ALLOCATOR(8, LZ4_STREAMSIZE_U64);
@@ -784,7 +1144,8 @@ int LZ4_loadDict (LZ4_stream_t* LZ4_dict, const char* dictionary, int dictSize)
     const BYTE* const dictEnd = p + dictSize;
     const BYTE* base;
 
-    if (dict->initCheck) LZ4_resetStream(LZ4_dict);                         /* Uninitialized structure detected */
+    if ((dict->initCheck) || ((dict->dictSize == 0) && (dict->currentOffset > 0)))   /* Uninitialized structure, or only unreachable positions left (fast reset) */
+        LZ4_resetStream(LZ4_dict);
 
     if (dictSize < MINMATCH)
     {
@@ -838,6 +1199,8 @@ FORCE_INLINE int LZ4_compress_continue_generic (void* LZ4_stream, const char* so
 
     const BYTE* smallest = (const BYTE*) source;
     if (streamPtr->initCheck) return 0;   /* Uninitialized structure detected */
+    if ((streamPtr->dictSize == 0) && (streamPtr->currentOffset > 0) && (inputSize > LZ4_batchShareLimit))
+        LZ4_resetStream((LZ4_stream_t*)LZ4_stream);   /* no history (fast reset) : a clean table is faster than rejecting left-over positions */
     if ((streamPtr->dictSize>0) && (smallest>dictEnd)) smallest = dictEnd;
     LZ4_renormDictT(streamPtr, smallest);
 
@@ -857,10 +1220,8 @@ FORCE_INLINE int LZ4_compress_continue_generic (void* LZ4_stream, const char* so
     if (dictEnd == (const BYTE*)source)
     {
         int result;
-        if ((streamPtr->dictSize < 64 KB) && (streamPtr->dictSize < streamPtr->currentOffset))
-            result = LZ4_compress_generic(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, withPrefix64k, dictSmall);
-        else
-            result = LZ4_compress_generic(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, withPrefix64k, noDictIssue);
+        dictIssue_directive const dictIssue = ((streamPtr->dictSize < 64 KB) && (streamPtr->dictSize < streamPtr->currentOffset)) ? dictSmall : noDictIssue;
+        result = LZ4_compress_dict(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, withPrefix64k, dictIssue);
         streamPtr->dictSize += (U32)inputSize;
         streamPtr->currentOffset += (U32)inputSize;
         return result;
@@ -869,10 +1230,8 @@ FORCE_INLINE int LZ4_compress_continue_generic (void* LZ4_stream, const char* so
     /* external dictionary mode */
     {
         int result;
-        if ((streamPtr->dictSize < 64 KB) && (streamPtr->dictSize < streamPtr->currentOffset))
-            result = LZ4_compress_generic(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, usingExtDict, dictSmall);
-        else
-            result = LZ4_compress_generic(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, usingExtDict, noDictIssue);
+        dictIssue_directive const dictIssue = ((streamPtr->dictSize < 64 KB) && (streamPtr->dictSize < streamPtr->currentOffset)) ? dictSmall : noDictIssue;
+        result = LZ4_compress_dict(LZ4_stream, source, dest, inputSize, maxOutputSize, limit, byU32, usingExtDict, dictIssue);
         streamPtr->dictionary = (const BYTE*)source;
         streamPtr->dictSize = (U32)inputSize;
         streamPtr->currentOffset += (U32)inputSize;
@@ -902,7 +1261,7 @@ int LZ4_compress_forceExtDict (LZ4_stream_t* LZ4_dict, const char* source, char*
     if (smallest > (const BYTE*) source) smallest = (const BYTE*) source;
     LZ4_renormDictT((LZ4_stream_t_internal*)LZ4_dict, smallest);
 
-    result = LZ4_compress_generic(LZ4_dict, source, dest, inputSize, 0, notLimited, byU32, usingExtDict, noDictIssue);
+    result = LZ4_compress_dict(LZ4_dict, source, dest, inputSize, 0, notLimited, byU32, usingExtDict, noDictIssue);
 
     streamPtr->dictionary = (const BYTE*)source;
     streamPtr->dictSize = (U32)inputSize;
@@ -951,7 +1310,8 @@ FORCE_INLINE int LZ4_decompress_generic(
                  int dict,               /* noDict, withPrefix64k, usingExtDict */
                  const BYTE* const lowPrefix,  /* == dest if dict == noDict */
                  const BYTE* const dictStart,  /* only if dict==usingExtDict */
-                 const size_t dictSize         /* note : = 0 if noDict */
+                 const size_t dictSize,        /* note : = 0 if noDict */
+                 int copy                      /* scalarCopy, vectorCopy (only if LZ4_VECTOR_DECODE) */
                  )
 {
     /* Local Variables */
@@ -970,6 +1330,9 @@ FORCE_INLINE int LZ4_decompress_generic(
 
     const int safeDecode = (endOnInput==endOnInputSize);
     const int checkOffset = ((safeDecode) && (dictSize < (int)(64 KB)));
+#if !LZ4_VECTOR_DECODE
+    (void)copy;
+#endif
 
 
     /* Special cases */
@@ -1020,6 +1383,11 @@ FORCE_INLINE int LZ4_decompress_generic(
             op += length;
             break;     /* Necessarily EOF, due to parsing restrictions */
         }
+#if LZ4_VECTOR_DECODE
+        if ((copy==vectorCopy) && (endOnInput) && (cpy <= oend-16) && (ip+length <= iend-16))   /* trusted input (!endOnInput) may end right after the block */
+            LZ4_wildCopy16(op, ip, cpy);
+        else
+#endif
         LZ4_wildCopy(op, ip, cpy);
         ip += length; op = cpy;
 
@@ -1078,6 +1446,23 @@ FORCE_INLINE int LZ4_decompress_generic(
 
         /* copy repeated sequence */
         cpy = op + length;
+#if LZ4_VECTOR_DECODE
+        if ((copy==vectorCopy) && likely(cpy <= oend-16))
+        {
+            const size_t offset = (size_t)(op-match);
+            if (offset >= 16)
+                LZ4_wildCopy16(op, match, cpy);
+            else
+            {
+                /* overlapping match : its first 'offset' bytes are repeated over a vector, stored as many times as needed */
+                const LZ4_vec16 pattern = LZ4_shuffle16(LZ4_readVec16(match), LZ4_readVec16(LZ4_vecPattern[offset]));
+                const size_t step = LZ4_vecStep[offset];
+                do { LZ4_writeVec16(op, pattern); op += step; } while (op < cpy);
+            }
+            op = cpy;
+            continue;
+        }
+#endif
         if (unlikely((op-match)<8))
         {
             const size_t dec64 = dec64table[op-match];
@@ -1118,19 +1503,65 @@ _output_error:
 }
 
 
+#if LZ4_VECTOR_DECODE
+LZ4_TARGET_SSSE3 static int LZ4_decompress_safe_vector(const char* source, char* dest, int compressedSize, int maxDecompressedSize)
+{
+    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, full, 0, noDict, (BYTE*)dest, NULL, 0, vectorCopy);
+}
+
+LZ4_TARGET_SSSE3 static int LZ4_decompress_fast_vector(const char* source, char* dest, int originalSize)
+{
+    return LZ4_decompress_generic(source, dest, 0, originalSize, endOnOutputSize, full, 0, withPrefix64k, (BYTE*)(dest - 64 KB), NULL, 64 KB, vectorCopy);
+}
+#endif
+
 int LZ4_decompress_safe(const char* source, char* dest, int compressedSize, int maxDecompressedSize)
 {
-    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, full, 0, noDict, (BYTE*)dest, NULL, 0);
+#if LZ4_VECTOR_DECODE
+    if (LZ4_cpuFeatures() & LZ4_CPU_SSSE3) return LZ4_decompress_safe_vector(source, dest, compressedSize, maxDecompressedSize);
+#endif
+    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, full, 0, noDict, (BYTE*)dest, NULL, 0, scalarCopy);
+}
+
+/* Hidden debug function, to measure the vector decoder against the scalar one */
+int LZ4_decompress_safe_forceScalar(const char* source, char* dest, int compressedSize, int maxDecompressedSize)
+{
+    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, full, 0, noDict, (BYTE*)dest, NULL, 0, scalarCopy);
 }
 
 int LZ4_decompress_safe_partial(const char* source, char* dest, int compressedSize, int targetOutputSize, int maxDecompressedSize)
 {
-    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, partial, targetOutputSize, noDict, (BYTE*)dest, NULL, 0);
+    return LZ4_decompress_generic(source, dest, compressedSize, maxDecompressedSize, endOnInputSize, partial, targetOutputSize, noDict, (BYTE*)dest, NULL, 0, scalarCopy);
 }
 
 int LZ4_decompress_fast(const char* source, char* dest, int originalSize)
 {
-    return LZ4_decompress_generic(source, dest, 0, originalSize, endOnOutputSize, full, 0, withPrefix64k, (BYTE*)(dest - 64 KB), NULL, 64 KB);
+#if LZ4_VECTOR_DECODE
+    if (LZ4_cpuFeatures() & LZ4_CPU_SSSE3) return LZ4_decompress_fast_vector(source, dest, originalSize);
+#endif
+    return LZ4_decompress_generic(source, dest, 0, originalSize, endOnOutputSize, full, 0, withPrefix64k, (BYTE*)(dest - 64 KB), NULL, 64 KB, scalarCopy);
+}
+
+int LZ4_decompress_safe_batch(const char* const* sources, char* const* dests, const int* compressedSizes,
+                              const int* maxDecompressedSizes, int* results, int nbInputs)
+{
+    int n, nbErrors = 0;
+
+    for (n=0; n<nbInputs; n++)
+    {
+        if (n+1 < nbInputs)
+        {
+            /* Start loading next block while decoding current one : its first token and literals,
+               and the beginning of its destination, are then likely in cache when it's its turn */
+            LZ4_prefetchRead(sources[n+1]);
+            LZ4_prefetchRead(sources[n+1] + 64);
+            LZ4_prefetchWrite(dests[n+1]);
+        }
+        results[n] = LZ4_decompress_safe(sources[n], dests[n], compressedSizes[n], maxDecompressedSizes[n]);
+        nbErrors += (results[n] < 0);
+    }
+
+    return nbErrors;
 }
 
 
@@ -1194,7 +1625,7 @@ int LZ4_decompress_safe_continue (LZ4_streamDecode_t* LZ4_streamDecode, const ch
     {
         result = LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize,
                                         endOnInputSize, full, 0,
-                                        usingExtDict, lz4sd->prefixEnd - lz4sd->prefixSize, lz4sd->externalDict, lz4sd->extDictSize);
+                                        usingExtDict, lz4sd->prefixEnd - lz4sd->prefixSize, lz4sd->externalDict, lz4sd->extDictSize, scalarCopy);
         if (result <= 0) return result;
         lz4sd->prefixSize += result;
         lz4sd->prefixEnd  += result;
@@ -1205,7 +1636,7 @@ int LZ4_decompress_safe_continue (LZ4_streamDecode_t* LZ4_streamDecode, const ch
         lz4sd->externalDict = lz4sd->prefixEnd - lz4sd->extDictSize;
         result = LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize,
                                         endOnInputSize, full, 0,
-                                        usingExtDict, (BYTE*)dest, lz4sd->externalDict, lz4sd->extDictSize);
+                                        usingExtDict, (BYTE*)dest, lz4sd->externalDict, lz4sd->extDictSize, scalarCopy);
         if (result <= 0) return result;
         lz4sd->prefixSize = result;
         lz4sd->prefixEnd  = (BYTE*)dest + result;
@@ -1223,7 +1654,7 @@ int LZ4_decompress_fast_continue (LZ4_streamDecode_t* LZ4_streamDecode, const ch
     {
         result = LZ4_decompress_generic(source, dest, 0, originalSize,
                                         endOnOutputSize, full, 0,
-                                        usingExtDict, lz4sd->prefixEnd - lz4sd->prefixSize, lz4sd->externalDict, lz4sd->extDictSize);
+                                        usingExtDict, lz4sd->prefixEnd - lz4sd->prefixSize, lz4sd->externalDict, lz4sd->extDictSize, scalarCopy);
         if (result <= 0) return result;
         lz4sd->prefixSize += originalSize;
         lz4sd->prefixEnd  += originalSize;
@@ -1234,7 +1665,7 @@ int LZ4_decompress_fast_continue (LZ4_streamDecode_t* LZ4_streamDecode, const ch
         lz4sd->externalDict = (BYTE*)dest - lz4sd->extDictSize;
         result = LZ4_decompress_generic(source, dest, 0, originalSize,
                                         endOnOutputSize, full, 0,
-                                        usingExtDict, (BYTE*)dest, lz4sd->externalDict, lz4sd->extDictSize);
+                                        usingExtDict, (BYTE*)dest, lz4sd->externalDict, lz4sd->extDictSize, scalarCopy);
         if (result <= 0) return result;
         lz4sd->prefixSize = originalSize;
         lz4sd->prefixEnd  = (BYTE*)dest + originalSize;
@@ -1251,33 +1682,43 @@ Advanced decoding functions :
     the dictionary must be explicitly provided within parameters
 */
 
-FORCE_INLINE int LZ4_decompress_usingDict_generic(const char* source, char* dest, int compressedSize, int maxOutputSize, int safe, const char* dictStart, int dictSize)
+FORCE_INLINE int LZ4_decompress_usingDict_generic(const char* source, char* dest, int compressedSize, int maxOutputSize, int safe, const char* dictStart, int dictSize, int copy)
 {
     if (dictSize==0)
-        return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, noDict, (BYTE*)dest, NULL, 0);
+        return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, noDict, (BYTE*)dest, NULL, 0, copy);
     if (dictStart+dictSize == dest)
     {
         if (dictSize >= (int)(64 KB - 1))
-            return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, withPrefix64k, (BYTE*)dest-64 KB, NULL, 0);
-        return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, noDict, (BYTE*)dest-dictSize, NULL, 0);
+            return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, withPrefix64k, (BYTE*)dest-64 KB, NULL, 0, copy);
+        return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, noDict, (BYTE*)dest-dictSize, NULL, 0, copy);
     }
-    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, usingExtDict, (BYTE*)dest, (BYTE*)dictStart, dictSize);
+    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, safe, full, 0, usingExtDict, (BYTE*)dest, (BYTE*)dictStart, dictSize, copy);
+}
+
+#if LZ4_VECTOR_DECODE
+LZ4_TARGET_SSSE3 static int LZ4_decompress_safe_usingDict_vector(const char* source, char* dest, int compressedSize, int maxOutputSize, const char* dictStart, int dictSize)
+{
+    return LZ4_decompress_usingDict_generic(source, dest, compressedSize, maxOutputSize, 1, dictStart, dictSize, vectorCopy);
 }
+#endif
 
 int LZ4_decompress_safe_usingDict(const char* source, char* dest, int compressedSize, int maxOutputSize, const char* dictStart, int dictSize)
 {
-    return LZ4_decompress_usingDict_generic(source, dest, compressedSize, maxOutputSize, 1, dictStart, dictSize);
+#if LZ4_VECTOR_DECODE
+    if (LZ4_cpuFeatures() & LZ4_CPU_SSSE3) return LZ4_decompress_safe_usingDict_vector(source, dest, compressedSize, maxOutputSize, dictStart, dictSize);
+#endif
+    return LZ4_decompress_usingDict_generic(source, dest, compressedSize, maxOutputSize, 1, dictStart, dictSize, scalarCopy);
 }
 
 int LZ4_decompress_fast_usingDict(const char* source, char* dest, int originalSize, const char* dictStart, int dictSize)
 {
-    return LZ4_decompress_usingDict_generic(source, dest, 0, originalSize, 0, dictStart, dictSize);
+    return LZ4_decompress_usingDict_generic(source, dest, 0, originalSize, 0, dictStart, dictSize, scalarCopy);
 }
 
 /* debug function */
 int LZ4_decompress_safe_forceExtDict(const char* source, char* dest, int compressedSize, int maxOutputSize, const char* dictStart, int dictSize)
 {
-    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, endOnInputSize, full, 0, usingExtDict, (BYTE*)dest, (BYTE*)dictStart, dictSize);
+    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, endOnInputSize, full, 0, usingExtDict, (BYTE*)dest, (BYTE*)dictStart, dictSize, scalarCopy);
 }
 
 
@@ -1334,10 +1775,7 @@ int LZ4_compress_withState (void* state, const char* source, char* dest, int inp
     if (((size_t)(state)&3) != 0) return 0;   /* Error : state is not aligned on 4-bytes boundary */
     MEM_INIT(state, 0, LZ4_STREAMSIZE);
 
-    if (inputSize < LZ4_64Klimit)
-        return LZ4_compress_generic(state, source, dest, inputSize, 0, notLimited, byU16, noDict, noDictIssue);
-    else
-        return LZ4_compress_generic(state, source, dest, inputSize, 0, notLimited, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+    return LZ4_compress_noDict(state, source, dest, inputSize, 0, notLimited);
 }
 
 int LZ4_compress_limitedOutput_withState (void* state, const char* source, char* dest, int inputSize, int maxOutputSize)
@@ -1345,22 +1783,19 @@ int LZ4_compress_limitedOutput_withState (void* state, const char* source, char*
     if (((size_t)(state)&3) != 0) return 0;   /* Error : state is not aligned on 4-bytes boundary */
     MEM_INIT(state, 0, LZ4_STREAMSIZE);
 
-    if (inputSize < LZ4_64Klimit)
-        return LZ4_compress_generic(state, source, dest, inputSize, maxOutputSize, limitedOutput, byU16, noDict, noDictIssue);
-    else
-        return LZ4_compress_generic(state, source, dest, inputSize, maxOutputSize, limitedOutput, LZ4_64bits() ? byU32 : byPtr, noDict, noDictIssue);
+    return LZ4_compress_noDict(state, source, dest, inputSize, maxOutputSize, limitedOutput);
 }
 
 /* Obsolete streaming decompression functions */
 
 int LZ4_decompress_safe_withPrefix64k(const char* source, char* dest, int compressedSize, int maxOutputSize)
 {
-    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, endOnInputSize, full, 0, withPrefix64k, (BYTE*)dest - 64 KB, NULL, 64 KB);
+    return LZ4_decompress_generic(source, dest, compressedSize, maxOutputSize, endOnInputSize, full, 0, withPrefix64k, (BYTE*)dest - 64 KB, NULL, 64 KB, scalarCopy);
 }
 
 int LZ4_decompress_fast_withPrefix64k(const char* source, char* dest, int originalSize)
 {
-    return LZ4_decompress_generic(source, dest, 0, originalSize, endOnOutputSize, full, 0, withPrefix64k, (BYTE*)dest - 64 KB, NULL, 64 KB);
+    return LZ4_decompress_generic(source, dest, 0, originalSize, endOnOutputSize, full, 0, withPrefix64k, (BYTE*)dest - 64 KB, NULL, 64 KB, scalarCopy);
 }
 
 #endif   /* LZ4_COMMONDEFS_ONLY */
@@ -140,6 +140,20 @@ int LZ4_compress_withState               (void* state, const char* source, char*
 int LZ4_compress_limitedOutput_withState (void* state, const char* source, char* dest, int inputSize, int maxOutputSize);
 
 
+/*
+LZ4_compress_batch_withState() :
+    Compress 'nbInputs' independent buffers in a single call, using a single state (see LZ4_sizeofState()).
+    Input n is compressed from sources[n] (inputSizes[n] bytes) into dests[n] (maxOutputSizes[n] bytes),
+    exactly like LZ4_compress_limitedOutput() : results[n] receives the compressed size, or 0 if compression failed.
+    Small inputs (up to 512 bytes) share the hash table without resetting it, which makes them much cheaper to compress
+    than with one call each. Compressed blocks may differ slightly from LZ4_compress_limitedOutput() ones,
+    and are decoded the same way, independently of each other.
+    return : the number of inputs which could not be compressed (0 when all results are valid)
+*/
+int LZ4_compress_batch_withState (void* state, const char* const* sources, const int* inputSizes,
+                                  char* const* dests, const int* maxOutputSizes, int* results, int nbInputs);
+
+
 /*
 LZ4_decompress_fast() :
     originalSize : is the original and therefore uncompressed size
@@ -168,6 +182,47 @@ LZ4_decompress_safe_partial() :
 */
 int LZ4_decompress_safe_partial (const char* source, char* dest, int compressedSize, int targetOutputSize, int maxDecompressedSize);
 
+/*
+LZ4_decompress_safe_batch() :
+    Decompress 'nbInputs' independent blocks in a single call.
+    Block n is decoded from sources[n] (compressedSizes[n] bytes) into dests[n] (maxDecompressedSizes[n] bytes),
+    exactly like LZ4_decompress_safe() : results[n] receives the decompressed size, or a negative result if block n is malformed.
+    While a block is decoded, the beginning of the next one and of its destination are prefetched,
+    which hides part of the memory latency when blocks are small and scattered.
+    return : the number of blocks which could not be decoded (0 when all results are valid)
+*/
+int LZ4_decompress_safe_batch (const char* const* sources, char* const* dests, const int* compressedSizes,
+                               const int* maxDecompressedSizes, int* results, int nbInputs);
+
+
+/**************************************
+*  CPU dispatch
+**************************************/
+#define LZ4_CPU_SSSE3    0x01
+#define LZ4_CPU_SSE42    0x02
+#define LZ4_CPU_AVX2     0x04
+#define LZ4_CPU_BMI2     0x08   /* BMI1 + BMI2 */
+#define LZ4_CPU_AVX512   0x10   /* AVX-512 F + BW + VL */
+
+unsigned    LZ4_cpuFeatures (void);
+unsigned    LZ4_limitCpuFeatures (unsigned allowedFeatures);
+const char* LZ4_kernelName (void);
+
+/*
+LZ4_cpuFeatures() :
+    Return the instruction sets LZ4 kernels can use, as a combination of LZ4_CPU_* flags.
+    They are detected once, at first use : on x86, the library selects at runtime
+    kernels compiled for more recent instruction sets than its build target (see LZ4_DISPATCH in lz4.c).
+LZ4_limitCpuFeatures() :
+    Restrict kernel selection to the instruction sets listed in allowedFeatures (0 selects baseline kernels),
+    for tests and benchmarks. Instruction sets of the build target remain in use.
+    The setting is a relaxed atomic : it can be changed while other threads use the library,
+    and is honoured by calls starting after it, while calls already running keep their kernels.
+    return : the new value of LZ4_cpuFeatures()
+LZ4_kernelName() :
+    Return a description of the kernels currently selected, such as "avx2+bmi2 compressor, ssse3 decoder".
+*/
+
 
 /***********************************************
 *  Streaming Compression Functions
@@ -190,6 +245,18 @@ typedef struct { long long table[LZ4_STREAMSIZE_U64]; } LZ4_stream_t;
  */
 void LZ4_resetStream (LZ4_stream_t* LZ4_streamPtr);
 
+/*
+ * LZ4_resetStream_fast
+ * Same as LZ4_resetStream(), for a stream already initialized and used since with streaming functions only.
+ * The table is not cleared : previous data is forgotten by making its positions unreachable,
+ * so the cost no longer depends on LZ4_MEMORY_USAGE. This makes re-using a stream for many small inputs nearly free.
+ * The table is still cleared when next input is larger than 512 bytes, or a dictionary is loaded, since it's then faster.
+ * The stream must already have been initialized by LZ4_resetStream() or LZ4_createStream() :
+ * uninitialized memory is not detected, and would make next compression read out of bounds.
+ * A stream only used by the one-shot *_withState() functions since its initialization gets a full reset.
+ */
+void LZ4_resetStream_fast (LZ4_stream_t* LZ4_streamPtr);
+
 /*
  * LZ4_createStream will allocate and initialize an LZ4_stream_t structure
  * LZ4_freeStream releases its memory.
@@ -100,7 +100,8 @@ typedef unsigned long long  U64;
 #define LZ4F_MAGIC_SKIPPABLE_START 0x184D2A50U
 #define LZ4F_MAGICNUMBER 0x184D2204U
 #define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
-#define LZ4F_MAXHEADERFRAME_SIZE 15
+#define LZ4F_MAXHEADERFRAME_SIZE 19   /* 15, or 19 with a dictionary ID */
+#define LZ4F_DICTID_SIZE 4
 #define LZ4F_BLOCKSIZEID_DEFAULT max64KB
 
 static const size_t minFHSize = 5;
@@ -123,8 +124,20 @@ typedef struct
     XXH32_state_t xxh;
     void*  lz4CtxPtr;
     U32    lz4CtxLevel;     /* 0: unallocated;  1: LZ4_stream_t;  3: LZ4_streamHC_t */
+    U32    lz4CtxState;     /* kind of stream initialized by LZ4F_initStream(), which can then be reset fast;  0: none */
+    const BYTE* dict;       /* dictionary of current frame, referenced (not copied) */
+    size_t dictSize;
+    const LZ4F_CDict* cdict;   /* pre-digested dictionary of current frame, or NULL */
 } LZ4F_cctx_internal_t;
 
+struct LZ4F_CDict_s
+{
+    void*  dictContent;     /* private copy of the dictionary (last 64 KB) */
+    size_t dictSize;
+    LZ4_stream_t*   fastCtx;   /* stream loaded with the dictionary, for fast levels */
+    LZ4_streamHC_t* HCCtx;     /* stream loaded with the dictionary, for HC levels */
+};
+
 typedef struct
 {
     LZ4F_frameInfo_t frameInfo;
@@ -143,7 +156,10 @@ typedef struct
     size_t tmpOutSize;
     size_t tmpOutStart;
     XXH32_state_t xxh;
-    BYTE   header[16];
+    XXH32_state_t blockChecksum;   /* of the uncompressed block being copied */
+    const BYTE* userDict;   /* dictionary for the next frame, set by LZ4F_decompress_usingDict() */
+    size_t userDictSize;
+    BYTE   header[LZ4F_MAXHEADERFRAME_SIZE];
 } LZ4F_dctx_internal_t;
 
 
@@ -262,7 +278,7 @@ size_t LZ4F_compressFrameBound(size_t srcSize, const LZ4F_preferences_t* prefere
     prefs.frameInfo.blockSizeID = LZ4F_optimalBSID(prefs.frameInfo.blockSizeID, srcSize);
     prefs.autoFlush = 1;
 
-    headerSize = 15;      /* header size, including magic number and frame content size*/
+    headerSize = LZ4F_MAXHEADERFRAME_SIZE;      /* header size, including magic number, frame content size and dictID */
     streamSize = LZ4F_compressBound(srcSize, &prefs);
 
     return headerSize + streamSize;
@@ -379,13 +395,134 @@ LZ4F_errorCode_t LZ4F_freeCompressionContext(LZ4F_compressionContext_t LZ4F_comp
 }
 
 
+/* LZ4F_resetCompressionContext() :
+* Abandons any frame in progress, so that the context can start a new frame with LZ4F_compressBegin().
+* Allocated resources are kept for the next frame.
+*/
+LZ4F_errorCode_t LZ4F_resetCompressionContext(LZ4F_compressionContext_t compressionContext)
+{
+    LZ4F_cctx_internal_t* cctxPtr = (LZ4F_cctx_internal_t*)compressionContext;
+
+    cctxPtr->cStage = 0;
+    cctxPtr->tmpInSize = 0;
+
+    return OK_NoError;
+}
+
+
+/* LZ4F_createCDict() :
+* digests dictBuffer once, for both fast and HC levels, so that each frame (or independent block)
+* starting from it only costs a copy of the loaded stream, instead of re-hashing the dictionary.
+* dictBuffer is copied : it can be released after creation.
+* The resulting object is read-only, hence can be shared by several compression contexts and threads.
+*/
+LZ4F_CDict* LZ4F_createCDict(const void* dictBuffer, size_t dictSize)
+{
+    LZ4F_CDict* cdict;
+    if (dictSize > 64 KB) { dictBuffer = (const BYTE*)dictBuffer + dictSize - 64 KB; dictSize = 64 KB; }
+    cdict = (LZ4F_CDict*)ALLOCATOR(sizeof(LZ4F_CDict));
+    if (cdict == NULL) return NULL;
+    cdict->dictContent = ALLOCATOR(dictSize ? dictSize : 1);
+    cdict->fastCtx = LZ4_createStream();
+    cdict->HCCtx = LZ4_createStreamHC();
+    if (!cdict->dictContent || !cdict->fastCtx || !cdict->HCCtx) { LZ4F_freeCDict(cdict); return NULL; }
+    if (dictSize) memcpy(cdict->dictContent, dictBuffer, dictSize);
+    cdict->dictSize = dictSize;
+    LZ4_resetStream(cdict->fastCtx);
+    LZ4_loadDict(cdict->fastCtx, (const char*)cdict->dictContent, (int)dictSize);
+    LZ4_resetStreamHC(cdict->HCCtx, minHClevel);
+    LZ4_loadDictHC(cdict->HCCtx, (const char*)cdict->dictContent, (int)dictSize);
+    return cdict;
+}
+
+void LZ4F_freeCDict(LZ4F_CDict* cdict)
+{
+    if (cdict == NULL) return;
+    FREEMEM(cdict->dictContent);
+    LZ4_freeStream(cdict->fastCtx);
+    LZ4_freeStreamHC(cdict->HCCtx);
+    FREEMEM(cdict);
+}
+
+
+/* LZ4F_initStream() :
+* resets the LZ4 stream of cctx, then loads the frame dictionary into it, if any.
+* A pre-digested dictionary is copied instead, which gives the same stream state.
+* When the stream was already started with the same kind of tables, they are not cleared (fast reset).
+*/
+static void LZ4F_initStream(LZ4F_cctx_internal_t* cctxPtr)
+{
+    U32 const tableID = cctxPtr->prefs.compressionLevel<minHClevel ? 1 : 2;
+    int const fastReset = (cctxPtr->lz4CtxState == tableID);
+    cctxPtr->lz4CtxState = tableID;
+    if (cctxPtr->prefs.compressionLevel < minHClevel)
+    {
+        if (cctxPtr->cdict)
+        {
+            memcpy(cctxPtr->lz4CtxPtr, cctxPtr->cdict->fastCtx, sizeof(LZ4_stream_t));
+            return;
+        }
+        if (fastReset) LZ4_resetStream_fast((LZ4_stream_t*)(cctxPtr->lz4CtxPtr));
+        else LZ4_resetStream((LZ4_stream_t*)(cctxPtr->lz4CtxPtr));
+        if (cctxPtr->dictSize) LZ4_loadDict((LZ4_stream_t*)(cctxPtr->lz4CtxPtr), (const char*)cctxPtr->dict, (int)cctxPtr->dictSize);
+    }
+    else
+    {
+        if (cctxPtr->cdict)
+        {
+            memcpy(cctxPtr->lz4CtxPtr, cctxPtr->cdict->HCCtx, sizeof(LZ4_streamHC_t));
+            LZ4_setCompressionLevelHC((LZ4_streamHC_t*)(cctxPtr->lz4CtxPtr), cctxPtr->prefs.compressionLevel);
+            return;
+        }
+        if (fastReset) LZ4_resetStreamHC_fast((LZ4_streamHC_t*)(cctxPtr->lz4CtxPtr), cctxPtr->prefs.compressionLevel);
+        else LZ4_resetStreamHC((LZ4_streamHC_t*)(cctxPtr->lz4CtxPtr), cctxPtr->prefs.compressionLevel);
+        if (cctxPtr->dictSize) LZ4_loadDictHC((LZ4_streamHC_t*)(cctxPtr->lz4CtxPtr), (const char*)cctxPtr->dict, (int)cctxPtr->dictSize);
+    }
+}
+
+
+static size_t LZ4F_compressBegin_internal(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize,
+                                          const void* dict, size_t dictSize, const LZ4F_CDict* cdict, const LZ4F_preferences_t* preferencesPtr);
+
 /* LZ4F_compressBegin() :
 * will write the frame header into dstBuffer.
-* dstBuffer must be large enough to accommodate a header (dstMaxSize). Maximum header size is LZ4F_MAXHEADERFRAME_SIZE bytes.
+* dstBuffer must be large enough to accommodate a header (dstMaxSize). Maximum header size is 15 bytes,
+* or LZ4F_MAXHEADERFRAME_SIZE (19) bytes with a dictionary ID.
 * The result of the function is the number of bytes written into dstBuffer for the header
 * or an error code (can be tested using LZ4F_isError())
 */
 size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize, const LZ4F_preferences_t* preferencesPtr)
+{
+    return LZ4F_compressBegin_usingDict(compressionContext, dstBuffer, dstMaxSize, NULL, 0, preferencesPtr);
+}
+
+
+/* LZ4F_compressBegin_usingDict() :
+* same as LZ4F_compressBegin(), but the frame is compressed using dict as a prefix of every independent block,
+* or of the first block in linked mode. Only the last 64 KB of dict are useful.
+* dict is referenced, not copied : it must remain unmodified until LZ4F_compressEnd().
+*/
+size_t LZ4F_compressBegin_usingDict(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize,
+                                    const void* dict, size_t dictSize, const LZ4F_preferences_t* preferencesPtr)
+{
+    return LZ4F_compressBegin_internal(compressionContext, dstBuffer, dstMaxSize, dict, dictSize, NULL, preferencesPtr);
+}
+
+
+/* LZ4F_compressBegin_usingCDict() :
+* same as LZ4F_compressBegin_usingDict(), with a dictionary digested by LZ4F_createCDict().
+* cdict (or NULL, meaning no dictionary) must remain valid until LZ4F_compressEnd().
+*/
+size_t LZ4F_compressBegin_usingCDict(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize,
+                                     const LZ4F_CDict* cdict, const LZ4F_preferences_t* preferencesPtr)
+{
+    if (cdict == NULL) return LZ4F_compressBegin_internal(compressionContext, dstBuffer, dstMaxSize, NULL, 0, NULL, preferencesPtr);
+    return LZ4F_compressBegin_internal(compressionContext, dstBuffer, dstMaxSize, cdict->dictContent, cdict->dictSize, cdict, preferencesPtr);
+}
+
+
+static size_t LZ4F_compressBegin_internal(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize,
+                                          const void* dict, size_t dictSize, const LZ4F_CDict* cdict, const LZ4F_preferences_t* preferencesPtr)
 {
     LZ4F_preferences_t prefNull;
     LZ4F_cctx_internal_t* cctxPtr = (LZ4F_cctx_internal_t*)compressionContext;
@@ -394,10 +531,10 @@ size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* ds
     BYTE* headerStart;
     size_t requiredBuffSize;
 
-    if (dstMaxSize < LZ4F_MAXHEADERFRAME_SIZE) return (size_t)-ERROR_dstMaxSize_tooSmall;
     if (cctxPtr->cStage != 0) return (size_t)-ERROR_GENERIC;
     memset(&prefNull, 0, sizeof(prefNull));
     if (preferencesPtr == NULL) preferencesPtr = &prefNull;
+    if (dstMaxSize < LZ4F_MAXHEADERFRAME_SIZE - (preferencesPtr->frameInfo.dictID ? 0 : LZ4F_DICTID_SIZE)) return (size_t)-ERROR_dstMaxSize_tooSmall;
     cctxPtr->prefs = *preferencesPtr;
 
     /* ctx Management */
@@ -411,6 +548,7 @@ size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* ds
             else
                 cctxPtr->lz4CtxPtr = (void*)LZ4_createStreamHC();
             cctxPtr->lz4CtxLevel = tableID;
+            cctxPtr->lz4CtxState = 0;
         }
     }
 
@@ -432,10 +570,12 @@ size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* ds
     cctxPtr->tmpIn = cctxPtr->tmpBuff;
     cctxPtr->tmpInSize = 0;
     XXH32_reset(&(cctxPtr->xxh), 0);
-    if (cctxPtr->prefs.compressionLevel < minHClevel)
-        LZ4_resetStream((LZ4_stream_t*)(cctxPtr->lz4CtxPtr));
-    else
-        LZ4_resetStreamHC((LZ4_streamHC_t*)(cctxPtr->lz4CtxPtr), cctxPtr->prefs.compressionLevel);
+    if (dict == NULL) dictSize = 0;
+    if (dictSize > 64 KB) { dict = (const BYTE*)dict + dictSize - 64 KB; dictSize = 64 KB; }
+    cctxPtr->dict = (const BYTE*)dict;
+    cctxPtr->dictSize = dictSize;
+    cctxPtr->cdict = dictSize ? cdict : NULL;
+    LZ4F_initStream(cctxPtr);
 
     /* Magic Number */
     LZ4F_writeLE32(dstPtr, LZ4F_MAGICNUMBER);
@@ -445,8 +585,10 @@ size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* ds
     /* FLG Byte */
     *dstPtr++ = ((1 & _2BITS) << 6)    /* Version('01') */
         + ((cctxPtr->prefs.frameInfo.blockMode & _1BIT ) << 5)    /* Block mode */
+        + (BYTE)((cctxPtr->prefs.frameInfo.blockChecksumFlag & _1BIT ) << 4)   /* Block checksum */
         + (BYTE)((cctxPtr->prefs.frameInfo.contentChecksumFlag & _1BIT ) << 2)   /* Frame checksum */
-        + (BYTE)((cctxPtr->prefs.frameInfo.contentSize > 0) << 3);   /* Frame content size */
+        + (BYTE)((cctxPtr->prefs.frameInfo.contentSize > 0) << 3)   /* Frame content size */
+        + (BYTE)(cctxPtr->prefs.frameInfo.dictID > 0);   /* Dictionary ID */
     /* BD Byte */
     *dstPtr++ = (BYTE)((cctxPtr->prefs.frameInfo.blockSizeID & _3BITS) << 4);
     /* Optional Frame content size field */
@@ -456,6 +598,12 @@ size_t LZ4F_compressBegin(LZ4F_compressionContext_t compressionContext, void* ds
         dstPtr += 8;
         cctxPtr->totalInSize = 0;
     }
+    /* Optional Dictionary ID field */
+    if (cctxPtr->prefs.frameInfo.dictID)
+    {
+        LZ4F_writeLE32(dstPtr, cctxPtr->prefs.frameInfo.dictID);
+        dstPtr += 4;
+    }
     /* CRC Byte */
     *dstPtr = LZ4F_headerChecksum(headerStart, dstPtr - headerStart);
     dstPtr++;
@@ -480,7 +628,7 @@ size_t LZ4F_compressBound(size_t srcSize, const LZ4F_preferences_t* preferencesP
         size_t blockSize = LZ4F_getBlockSize(bid);
         unsigned nbBlocks = (unsigned)(srcSize / blockSize) + 1;
         size_t lastBlockSize = prefsPtr->autoFlush ? srcSize % blockSize : blockSize;
-        size_t blockInfo = 4;   /* default, without block CRC option */
+        size_t blockInfo = 4 + (prefsPtr->frameInfo.blockChecksumFlag*4);   /* block size, and block checksum if selected */
         size_t frameEnd = 4 + (prefsPtr->frameInfo.contentChecksumFlag*4);
 
         return (blockInfo * nbBlocks) + (blockSize * (nbBlocks-1)) + lastBlockSize + frameEnd;;
@@ -490,12 +638,14 @@ size_t LZ4F_compressBound(size_t srcSize, const LZ4F_preferences_t* preferencesP
 
 typedef int (*compressFunc_t)(void* ctx, const char* src, char* dst, int srcSize, int dstSize, int level);
 
-static size_t LZ4F_compressBlock(void* dst, const void* src, size_t srcSize, compressFunc_t compress, void* lz4ctx, int level)
+static size_t LZ4F_compressBlock(void* dst, const void* src, size_t srcSize, compressFunc_t compress, LZ4F_cctx_internal_t* cctxPtr)
 {
     /* compress one block */
     BYTE* cSizePtr = (BYTE*)dst;
     U32 cSize;
-    cSize = (U32)compress(lz4ctx, (const char*)src, (char*)(cSizePtr+4), (int)(srcSize), (int)(srcSize-1), level);
+    if ((cctxPtr->prefs.frameInfo.blockMode == blockIndependent) && ((cctxPtr->dictSize) || (cctxPtr->prefs.compressionLevel >= minHClevel)))
+        LZ4F_initStream(cctxPtr);   /* each block starts a new stream, which only references the dictionary */
+    cSize = (U32)compress(cctxPtr->lz4CtxPtr, (const char*)src, (char*)(cSizePtr+4), (int)(srcSize), (int)(srcSize-1), cctxPtr->prefs.compressionLevel);
     LZ4F_writeLE32(cSizePtr, cSize);
     if (cSize == 0)   /* compression failed */
     {
@@ -503,6 +653,11 @@ static size_t LZ4F_compressBlock(void* dst, const void* src, size_t srcSize, com
         LZ4F_writeLE32(cSizePtr, cSize + LZ4F_BLOCKUNCOMPRESSED_FLAG);
         memcpy(cSizePtr+4, src, srcSize);
     }
+    if (cctxPtr->prefs.frameInfo.blockChecksumFlag == blockChecksumEnabled)
+    {
+        LZ4F_writeLE32(cSizePtr+4+cSize, XXH32(cSizePtr+4, cSize, 0));   /* checksum of stored data */
+        return cSize + 8;
+    }
     return cSize + 4;
 }
 
@@ -525,14 +680,16 @@ static int LZ4F_localLZ4_compressHC_limitedOutput_continue(void* ctx, const char
     return LZ4_compressHC_limitedOutput_continue((LZ4_streamHC_t*)ctx, src, dst, srcSize, dstSize);
 }
 
-static compressFunc_t LZ4F_selectCompression(blockMode_t blockMode, U32 level)
+static compressFunc_t LZ4F_selectCompression(blockMode_t blockMode, U32 level, size_t dictSize)
 {
+    if (dictSize) blockMode = blockLinked;   /* independent blocks continue from the dictionary, re-loaded before each block */
     if (level < minHClevel)
     {
         if (blockMode == blockIndependent) return LZ4F_localLZ4_compress_limitedOutput_withState;
         return LZ4F_localLZ4_compress_limitedOutput_continue;
     }
-    if (blockMode == blockIndependent) return LZ4_compressHC2_limitedOutput_withStateHC;
+    /* independent HC blocks : the stream is reset (fast) before each block, which avoids clearing 256 KB of tables,
+       and compresses exactly like LZ4_compressHC2_limitedOutput_withStateHC() */
     return LZ4F_localLZ4_compressHC_limitedOutput_continue;
 }
 
@@ -573,7 +730,7 @@ size_t LZ4F_compressUpdate(LZ4F_compressionContext_t compressionContext, void* d
     if (compressOptionsPtr == NULL) compressOptionsPtr = &cOptionsNull;
 
     /* select compression function */
-    compress = LZ4F_selectCompression(cctxPtr->prefs.frameInfo.blockMode, cctxPtr->prefs.compressionLevel);
+    compress = LZ4F_selectCompression(cctxPtr->prefs.frameInfo.blockMode, cctxPtr->prefs.compressionLevel, cctxPtr->dictSize);
 
     /* complete tmp buffer */
     if (cctxPtr->tmpInSize > 0)   /* some data already within tmp buffer */
@@ -594,7 +751,7 @@ size_t LZ4F_compressUpdate(LZ4F_compressionContext_t compressionContext, void* d
             memcpy(cctxPtr->tmpIn + cctxPtr->tmpInSize, srcBuffer, sizeToCopy);
             srcPtr += sizeToCopy;
 
-            dstPtr += LZ4F_compressBlock(dstPtr, cctxPtr->tmpIn, blockSize, compress, cctxPtr->lz4CtxPtr, cctxPtr->prefs.compressionLevel);
+            dstPtr += LZ4F_compressBlock(dstPtr, cctxPtr->tmpIn, blockSize, compress, cctxPtr);
 
             if (cctxPtr->prefs.frameInfo.blockMode==blockLinked) cctxPtr->tmpIn += blockSize;
             cctxPtr->tmpInSize = 0;
@@ -605,7 +762,7 @@ size_t LZ4F_compressUpdate(LZ4F_compressionContext_t compressionContext, void* d
     {
         /* compress full block */
         lastBlockCompressed = fromSrcBuffer;
-        dstPtr += LZ4F_compressBlock(dstPtr, srcPtr, blockSize, compress, cctxPtr->lz4CtxPtr, cctxPtr->prefs.compressionLevel);
+        dstPtr += LZ4F_compressBlock(dstPtr, srcPtr, blockSize, compress, cctxPtr);
         srcPtr += blockSize;
     }
 
@@ -613,7 +770,7 @@ size_t LZ4F_compressUpdate(LZ4F_compressionContext_t compressionContext, void* d
     {
         /* compress remaining input < blockSize */
         lastBlockCompressed = fromSrcBuffer;
-        dstPtr += LZ4F_compressBlock(dstPtr, srcPtr, srcEnd - srcPtr, compress, cctxPtr->lz4CtxPtr, cctxPtr->prefs.compressionLevel);
+        dstPtr += LZ4F_compressBlock(dstPtr, srcPtr, srcEnd - srcPtr, compress, cctxPtr);
         srcPtr  = srcEnd;
     }
 
@@ -657,6 +814,31 @@ size_t LZ4F_compressUpdate(LZ4F_compressionContext_t compressionContext, void* d
 }
 
 
+/* LZ4F_insertBlock()
+* Writes blockBuffer, a complete block (size prefix included) previously produced by this frame for the same srcBuffer content,
+* instead of compressing srcBuffer again. srcBuffer is still needed, to maintain the content checksum.
+* Only valid for independent blocks, when no input is buffered within compressionContext.
+* The result of the function is the number of bytes written into dstBuffer (blockSize),
+* or an error code (can be tested using LZ4F_isError())
+*/
+size_t LZ4F_insertBlock(LZ4F_compressionContext_t compressionContext, void* dstBuffer, size_t dstMaxSize,
+                        const void* srcBuffer, size_t srcSize, const void* blockBuffer, size_t blockSize)
+{
+    LZ4F_cctx_internal_t* cctxPtr = (LZ4F_cctx_internal_t*)compressionContext;
+
+    if ((cctxPtr->cStage != 1) || (cctxPtr->tmpInSize > 0)) return (size_t)-ERROR_GENERIC;
+    if (cctxPtr->prefs.frameInfo.blockMode != blockIndependent) return (size_t)-ERROR_blockMode_invalid;
+    if (srcSize > cctxPtr->maxBlockSize) return (size_t)-ERROR_srcSize_tooLarge;
+    if (dstMaxSize < blockSize) return (size_t)-ERROR_dstMaxSize_tooSmall;
+
+    memcpy(dstBuffer, blockBuffer, blockSize);
+    if (cctxPtr->prefs.frameInfo.contentChecksumFlag == contentChecksumEnabled)
+        XXH32_update(&(cctxPtr->xxh), srcBuffer, srcSize);
+    cctxPtr->totalInSize += srcSize;
+    return blockSize;
+}
+
+
 /* LZ4F_flush()
 * Should you need to create compressed data immediately, without waiting for a block to be filled,
 * you can call LZ4_flush(), which will immediately compress any remaining data stored within compressionContext.
@@ -679,10 +861,10 @@ size_t LZ4F_flush(LZ4F_compressionContext_t compressionContext, void* dstBuffer,
     (void)compressOptionsPtr;   /* not yet useful */
 
     /* select compression function */
-    compress = LZ4F_selectCompression(cctxPtr->prefs.frameInfo.blockMode, cctxPtr->prefs.compressionLevel);
+    compress = LZ4F_selectCompression(cctxPtr->prefs.frameInfo.blockMode, cctxPtr->prefs.compressionLevel, cctxPtr->dictSize);
 
     /* compress tmp buffer */
-    dstPtr += LZ4F_compressBlock(dstPtr, cctxPtr->tmpIn, cctxPtr->tmpInSize, compress, cctxPtr->lz4CtxPtr, cctxPtr->prefs.compressionLevel);
+    dstPtr += LZ4F_compressBlock(dstPtr, cctxPtr->tmpIn, cctxPtr->tmpInSize, compress, cctxPtr);
     if (cctxPtr->prefs.frameInfo.blockMode==blockLinked) cctxPtr->tmpIn += cctxPtr->tmpInSize;
     cctxPtr->tmpInSize = 0;
 
@@ -778,9 +960,9 @@ LZ4F_errorCode_t LZ4F_freeDecompressionContext(LZ4F_decompressionContext_t LZ4F_
 /* ********************* Decompression ******************************** */
 /* ******************************************************************** */
 
-typedef enum { dstage_getHeader=0, dstage_storeHeader,
+typedef enum { dstage_getHeader=0, dstage_storeHeader, dstage_init,
     dstage_getCBlockSize, dstage_storeCBlockSize,
-    dstage_copyDirect,
+    dstage_copyDirect, dstage_getBlockChecksum, dstage_storeBlockChecksum,
     dstage_getCBlock, dstage_storeCBlock, dstage_decodeCBlock,
     dstage_decodeCBlock_intoDst, dstage_decodeCBlock_intoTmp, dstage_flushOut,
     dstage_getSuffix, dstage_storeSuffix,
@@ -789,6 +971,22 @@ typedef enum { dstage_getHeader=0, dstage_storeHeader,
 } dStage_t;
 
 
+/* LZ4F_resetDecompressionContext() :
+* Abandons any frame in progress : next call to LZ4F_decompress() or LZ4F_getFrameInfo() expects a new frame header.
+* Allocated resources are kept for the next frame.
+*/
+LZ4F_errorCode_t LZ4F_resetDecompressionContext(LZ4F_decompressionContext_t decompressionContext)
+{
+    LZ4F_dctx_internal_t* dctxPtr = (LZ4F_dctx_internal_t*)decompressionContext;
+
+    dctxPtr->dStage = dstage_getHeader;
+    dctxPtr->srcExpect = NULL;
+    dctxPtr->userDict = NULL;
+
+    return OK_NoError;
+}
+
+
 /* LZ4F_decodeHeader
    return : nb Bytes read from srcVoidPtr (necessarily <= srcSize)
             or an error code (testable with LZ4F_isError())
@@ -798,7 +996,7 @@ typedef enum { dstage_getHeader=0, dstage_storeHeader,
 static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVoidPtr, size_t srcSize)
 {
     BYTE FLG, BD, HC;
-    unsigned version, blockMode, blockChecksumFlag, contentSizeFlag, contentChecksumFlag, blockSizeID;
+    unsigned version, blockMode, blockChecksumFlag, contentSizeFlag, contentChecksumFlag, dictIDFlag, blockSizeID;
     size_t bufferNeeded;
     size_t frameHeaderSize;
     const BYTE* srcPtr = (const BYTE*)srcVoidPtr;
@@ -836,9 +1034,10 @@ static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVo
     blockChecksumFlag = (FLG>>4) & _1BIT;
     contentSizeFlag = (FLG>>3) & _1BIT;
     contentChecksumFlag = (FLG>>2) & _1BIT;
+    dictIDFlag = FLG & _1BIT;
 
     /* Frame Header Size */
-    frameHeaderSize = contentSizeFlag ? 15 : 7;
+    frameHeaderSize = 7 + (contentSizeFlag ? 8 : 0) + (dictIDFlag ? 4 : 0);
 
     if (srcSize < frameHeaderSize)
     {
@@ -855,8 +1054,7 @@ static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVo
 
     /* validate */
     if (version != 1) return (size_t)-ERROR_GENERIC;           /* Version Number, only supported value */
-    if (blockChecksumFlag != 0) return (size_t)-ERROR_GENERIC; /* Only supported value for the time being */
-    if (((FLG>>0)&_2BITS) != 0) return (size_t)-ERROR_GENERIC; /* Reserved bits */
+    if (((FLG>>1)&_1BIT) != 0) return (size_t)-ERROR_GENERIC;  /* Reserved bit */
     if (((BD>>7)&_1BIT) != 0) return (size_t)-ERROR_GENERIC;   /* Reserved bit */
     if (blockSizeID < 4) return (size_t)-ERROR_GENERIC;        /* 4-7 only supported values for the time being */
     if (((BD>>0)&_4BITS) != 0) return (size_t)-ERROR_GENERIC;  /* Reserved bits */
@@ -868,10 +1066,13 @@ static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVo
     /* save */
     dctxPtr->frameInfo.blockMode = (blockMode_t)blockMode;
     dctxPtr->frameInfo.contentChecksumFlag = (contentChecksum_t)contentChecksumFlag;
+    dctxPtr->frameInfo.blockChecksumFlag = (blockChecksum_t)blockChecksumFlag;
     dctxPtr->frameInfo.blockSizeID = (blockSizeID_t)blockSizeID;
     dctxPtr->maxBlockSize = LZ4F_getBlockSize(blockSizeID);
     if (contentSizeFlag)
         dctxPtr->frameInfo.contentSize = LZ4F_readLE64(srcPtr+6);
+    if (dictIDFlag)
+        dctxPtr->frameInfo.dictID = LZ4F_readLE32(srcPtr + frameHeaderSize - 5);
 
     /* init */
     if (contentChecksumFlag) XXH32_reset(&(dctxPtr->xxh), 0);
@@ -883,7 +1084,7 @@ static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVo
         FREEMEM(dctxPtr->tmpIn);
         FREEMEM(dctxPtr->tmpOutBuffer);
         dctxPtr->maxBufferSize = bufferNeeded;
-        dctxPtr->tmpIn = (BYTE*)ALLOCATOR(dctxPtr->maxBlockSize);
+        dctxPtr->tmpIn = (BYTE*)ALLOCATOR(dctxPtr->maxBlockSize + 4);   /* +4 : block checksum */
         if (dctxPtr->tmpIn == NULL) return (size_t)-ERROR_GENERIC;
         dctxPtr->tmpOutBuffer= (BYTE*)ALLOCATOR(dctxPtr->maxBufferSize);
         if (dctxPtr->tmpOutBuffer== NULL) return (size_t)-ERROR_GENERIC;
@@ -896,7 +1097,7 @@ static size_t LZ4F_decodeHeader(LZ4F_dctx_internal_t* dctxPtr, const void* srcVo
     dctxPtr->tmpOutStart = 0;
     dctxPtr->tmpOutSize = 0;
 
-    dctxPtr->dStage = dstage_getCBlockSize;
+    dctxPtr->dStage = dstage_init;
 
     return frameHeaderSize;
 }
@@ -1095,6 +1296,19 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                 break;
             }
 
+        case dstage_init:
+            {
+                /* frame starts with the dictionary given to LZ4F_decompress_usingDict(), if any */
+                if (dctxPtr->userDict)
+                {
+                    dctxPtr->dict = (BYTE*)dctxPtr->userDict;
+                    dctxPtr->dictSize = dctxPtr->userDictSize;
+                    dctxPtr->userDict = NULL;
+                }
+                dctxPtr->dStage = dstage_getCBlockSize;
+                break;
+            }
+
         case dstage_getCBlockSize:
             {
                 if ((srcEnd - srcPtr) >= 4)
@@ -1136,16 +1350,18 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                     break;
                 }
                 if (nextCBlockSize > dctxPtr->maxBlockSize) return (size_t)-ERROR_GENERIC;   /* invalid cBlockSize */
-                dctxPtr->tmpInTarget = nextCBlockSize;
                 if (LZ4F_readLE32(selectedIn) & LZ4F_BLOCKUNCOMPRESSED_FLAG)
                 {
+                    dctxPtr->tmpInTarget = nextCBlockSize;
+                    if (dctxPtr->frameInfo.blockChecksumFlag) XXH32_reset(&(dctxPtr->blockChecksum), 0);
                     dctxPtr->dStage = dstage_copyDirect;
                     break;
                 }
+                dctxPtr->tmpInTarget = nextCBlockSize + dctxPtr->frameInfo.blockChecksumFlag*4;   /* block checksum is read along with the block */
                 dctxPtr->dStage = dstage_getCBlock;
                 if (dstPtr==dstEnd)
                 {
-                    nextSrcSizeHint = nextCBlockSize + 4;
+                    nextSrcSizeHint = dctxPtr->tmpInTarget + 4;
                     doAnotherStage = 0;
                 }
                 break;
@@ -1158,6 +1374,7 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                 if ((size_t)(dstEnd-dstPtr) < sizeToCopy) sizeToCopy = dstEnd - dstPtr;
                 memcpy(dstPtr, srcPtr, sizeToCopy);
                 if (dctxPtr->frameInfo.contentChecksumFlag) XXH32_update(&(dctxPtr->xxh), srcPtr, sizeToCopy);
+                if (dctxPtr->frameInfo.blockChecksumFlag) XXH32_update(&(dctxPtr->blockChecksum), srcPtr, sizeToCopy);
                 if (dctxPtr->frameInfo.contentSize) dctxPtr->frameInfo.contentSize -= sizeToCopy;
 
                 /* dictionary management */
@@ -1168,15 +1385,54 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                 dstPtr += sizeToCopy;
                 if (sizeToCopy == dctxPtr->tmpInTarget)   /* all copied */
                 {
-                    dctxPtr->dStage = dstage_getCBlockSize;
+                    dctxPtr->dStage = dctxPtr->frameInfo.blockChecksumFlag ? dstage_getBlockChecksum : dstage_getCBlockSize;
                     break;
                 }
                 dctxPtr->tmpInTarget -= sizeToCopy;   /* still need to copy more */
-                nextSrcSizeHint = dctxPtr->tmpInTarget + 4;
+                nextSrcSizeHint = dctxPtr->tmpInTarget + dctxPtr->frameInfo.blockChecksumFlag*4 + 4;
                 doAnotherStage = 0;
                 break;
             }
 
+        case dstage_getBlockChecksum:   /* after the data of an uncompressed block */
+            {
+                if ((srcEnd - srcPtr) >= 4)
+                {
+                    selectedIn = srcPtr;
+                    srcPtr += 4;
+                }
+                else
+                {
+                /* not enough input to read block checksum */
+                    dctxPtr->tmpInSize = 0;
+                    dctxPtr->dStage = dstage_storeBlockChecksum;
+                }
+            }
+
+            if (dctxPtr->dStage == dstage_storeBlockChecksum)
+        case dstage_storeBlockChecksum:
+            {
+                size_t sizeToCopy = 4 - dctxPtr->tmpInSize;
+                if (sizeToCopy > (size_t)(srcEnd - srcPtr)) sizeToCopy = srcEnd - srcPtr;
+                memcpy(dctxPtr->tmpIn + dctxPtr->tmpInSize, srcPtr, sizeToCopy);
+                srcPtr += sizeToCopy;
+                dctxPtr->tmpInSize += sizeToCopy;
+                if (dctxPtr->tmpInSize < 4)   /* not enough input to get full block checksum; wait for more */
+                {
+                    nextSrcSizeHint = (4 - dctxPtr->tmpInSize) + 4;
+                    doAnotherStage = 0;
+                    break;
+                }
+                selectedIn = dctxPtr->tmpIn;
+            }
+
+        /* case dstage_checkBlockChecksum: */   /* no direct access, to prevent scan-build warning */
+            {
+                if (LZ4F_readLE32(selectedIn) != XXH32_digest(&(dctxPtr->blockChecksum))) return (size_t)-ERROR_blockChecksum_invalid;
+                dctxPtr->dStage = dstage_getCBlockSize;
+                break;
+            }
+
         case dstage_getCBlock:   /* entry from dstage_decodeCBlockSize */
             {
                 if ((size_t)(srcEnd-srcPtr) < dctxPtr->tmpInTarget)
@@ -1211,6 +1467,12 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
 
         case dstage_decodeCBlock:
             {
+                if (dctxPtr->frameInfo.blockChecksumFlag)   /* block is verified before being decoded */
+                {
+                    size_t const cSize = dctxPtr->tmpInTarget - 4;
+                    if (LZ4F_readLE32(selectedIn + cSize) != XXH32(selectedIn, cSize, 0)) return (size_t)-ERROR_blockChecksum_invalid;
+                    dctxPtr->tmpInTarget = cSize;
+                }
                 if ((size_t)(dstEnd-dstPtr) < dctxPtr->maxBlockSize)   /* not enough place into dst : decode into tmpOut */
                     dctxPtr->dStage = dstage_decodeCBlock_intoTmp;
                 else
@@ -1223,7 +1485,7 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                 int (*decoder)(const char*, char*, int, int, const char*, int);
                 int decodedSize;
 
-                if (dctxPtr->frameInfo.blockMode == blockLinked)
+                if ((dctxPtr->frameInfo.blockMode == blockLinked) || (dctxPtr->dictSize))   /* independent blocks keep the frame dictionary */
                     decoder = LZ4_decompress_safe_usingDict;
                 else
                     decoder = LZ4F_decompress_safe;
@@ -1248,7 +1510,7 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
                 int (*decoder)(const char*, char*, int, int, const char*, int);
                 int decodedSize;
 
-                if (dctxPtr->frameInfo.blockMode == blockLinked)
+                if ((dctxPtr->frameInfo.blockMode == blockLinked) || (dctxPtr->dictSize))   /* independent blocks keep the frame dictionary */
                     decoder = LZ4_decompress_safe_usingDict;
                 else
                     decoder = LZ4F_decompress_safe;
@@ -1460,3 +1722,26 @@ size_t LZ4F_decompress(LZ4F_decompressionContext_t decompressionContext,
     *dstSizePtr = (dstPtr - dstStart);
     return nextSrcSizeHint;
 }
+
+
+/* LZ4F_decompress_usingDict()
+* Same as LZ4F_decompress(), but the frame is decoded using dict, as given to LZ4F_compressBegin_usingDict().
+* dict is only taken into account before the first block of a frame is decoded (after LZ4F_getFrameInfo() is fine);
+* it is referenced, not copied : it must remain unmodified until the frame is fully decoded.
+*/
+size_t LZ4F_decompress_usingDict(LZ4F_decompressionContext_t decompressionContext,
+                       void* dstBuffer, size_t* dstSizePtr,
+                       const void* srcBuffer, size_t* srcSizePtr,
+                       const void* dict, size_t dictSize,
+                       const LZ4F_decompressOptions_t* decompressOptionsPtr)
+{
+    LZ4F_dctx_internal_t* dctxPtr = (LZ4F_dctx_internal_t*)decompressionContext;
+
+    if ((dctxPtr->dStage <= dstage_init) && (dict != NULL) && (dictSize > 0))
+    {
+        if (dictSize > 64 KB) { dict = (const BYTE*)dict + dictSize - 64 KB; dictSize = 64 KB; }
+        dctxPtr->userDict = (const BYTE*)dict;
+        dctxPtr->userDictSize = dictSize;
+    }
+    return LZ4F_decompress(decompressionContext, dstBuffer, dstSizePtr, srcBuffer, srcSizePtr, decompressOptionsPtr);
+}
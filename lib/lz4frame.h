@@ -66,6 +66,7 @@ const char* LZ4F_getErrorName(LZ4F_errorCode_t code);   /* return error code str
 typedef enum { LZ4F_default=0, max64KB=4, max256KB=5, max1MB=6, max4MB=7 } blockSizeID_t;
 typedef enum { blockLinked=0, blockIndependent} blockMode_t;
 typedef enum { noContentChecksum=0, contentChecksumEnabled } contentChecksum_t;
+typedef enum { noBlockChecksum=0, blockChecksumEnabled } blockChecksum_t;
 typedef enum { LZ4F_frame=0, skippableFrame } frameType_t;
 
 typedef struct {
@@ -74,7 +75,8 @@ typedef struct {
   contentChecksum_t  contentChecksumFlag;   /* noContentChecksum, contentChecksumEnabled ; 0 == default  */
   frameType_t        frameType;             /* LZ4F_frame, skippableFrame ; 0 == default */
   unsigned long long contentSize;           /* Size of uncompressed (original) content ; 0 == unknown */
-  unsigned           reserved[2];           /* must be zero for forward compatibility */
+  unsigned           dictID;                /* Dictionary ID, written into frame header to help select the dictionary ; 0 == none */
+  blockChecksum_t    blockChecksumFlag;     /* noBlockChecksum, blockChecksumEnabled ; 0 == default ; XXH32 of each block, checked before decoding it */
 } LZ4F_frameInfo_t;
 
 typedef struct {
@@ -139,7 +141,7 @@ LZ4F_errorCode_t LZ4F_freeCompressionContext(LZ4F_compressionContext_t cctx);
 size_t LZ4F_compressBegin(LZ4F_compressionContext_t cctx, void* dstBuffer, size_t dstMaxSize, const LZ4F_preferences_t* prefsPtr);
 /* LZ4F_compressBegin() :
  * will write the frame header into dstBuffer.
- * dstBuffer must be large enough to accommodate a header (dstMaxSize). Maximum header size is 15 bytes.
+ * dstBuffer must be large enough to accommodate a header (dstMaxSize). Maximum header size is 15 bytes, or 19 with a dictionary ID.
  * The LZ4F_preferences_t structure is optional : you can provide NULL as argument, all preferences will then be set to default.
  * The result of the function is the number of bytes written into dstBuffer for the header
  * or an error code (can be tested using LZ4F_isError())
@@ -222,7 +224,7 @@ size_t LZ4F_getFrameInfo(LZ4F_decompressionContext_t dctx,
  * It is optional : you could start by calling directly LZ4F_decompress() instead.
  * The objective is to extract header information without starting decompression, typically for allocation purposes.
  * The function will work only if srcBuffer points at the beginning of the frame,
- * and *srcSizePtr is large enough to decode the whole header (typically, between 7 & 15 bytes).
+ * and *srcSizePtr is large enough to decode the whole header (typically, between 7 & 19 bytes).
  * The result is copied into an LZ4F_frameInfo_t structure, which is pointed by frameInfoPtr, and must be already allocated.
  * LZ4F_getFrameInfo() can also be used *after* starting decompression, on a valid LZ4F_decompressionContext_t.
  * The number of bytes read from srcBuffer will be provided within *srcSizePtr (necessarily <= original value).
@@ -57,6 +57,7 @@ extern "C" {
         ITEM(ERROR_wrongSrcPtr) \
         ITEM(ERROR_decompressionFailed) \
         ITEM(ERROR_checksum_invalid) \
+        ITEM(ERROR_blockChecksum_invalid) \
         ITEM(ERROR_maxCode)
 
 #define LZ4F_GENERATE_ENUM(ENUM) ENUM,
@@ -69,6 +70,65 @@ typedef enum { LZ4F_LIST_ERRORS(LZ4F_GENERATE_ENUM) } LZ4F_errorCodes;  /* enum
 #include "lz4frame.h"
 
 
+/**************************************
+ * Context reset
+ * ************************************/
+LZ4F_errorCode_t LZ4F_resetCompressionContext(LZ4F_compressionContext_t cctx);
+LZ4F_errorCode_t LZ4F_resetDecompressionContext(LZ4F_decompressionContext_t dctx);
+/* Both functions abandon any frame in progress, typically after an error,
+ * so that the context can be re-used for a new frame without being re-allocated.
+ * A compression context then starts again with LZ4F_compressBegin().
+ * A decompression context then expects a new frame header.
+ */
+
+
+/**************************************
+ * Block re-use
+ * ************************************/
+size_t LZ4F_insertBlock(LZ4F_compressionContext_t cctx, void* dstBuffer, size_t dstMaxSize,
+                        const void* srcBuffer, size_t srcSize, const void* blockBuffer, size_t blockSize);
+/* Writes blockBuffer, a complete block (4-bytes size prefix included) previously produced within the same frame
+ * from identical content, instead of compressing srcBuffer again (srcBuffer is only read for the content checksum).
+ * Typical use : repeated all-zero blocks, such as holes of sparse files.
+ * Only valid for independent blocks, when no input is buffered within cctx (autoFlush, or whole blocks).
+ * Result : nb of bytes written into dstBuffer (blockSize), or an error code (test with LZ4F_isError()).
+ */
+
+
+
+/**************************************
+ * Dictionary
+ * ************************************/
+size_t LZ4F_compressBegin_usingDict(LZ4F_compressionContext_t cctx, void* dstBuffer, size_t dstMaxSize,
+                                    const void* dict, size_t dictSize, const LZ4F_preferences_t* prefsPtr);
+size_t LZ4F_decompress_usingDict(LZ4F_decompressionContext_t dctx,
+                                 void* dstBuffer, size_t* dstSizePtr,
+                                 const void* srcBuffer, size_t* srcSizePtr,
+                                 const void* dict, size_t dictSize,
+                                 const LZ4F_decompressOptions_t* dOptPtr);
+/* Frames of small, similar payloads compress much better when both sides share a dictionary (typically, sample content).
+ * LZ4F_compressBegin_usingDict() starts a frame compressed against dict : every independent block,
+ * or the first block in linked mode, can reference its last 64 KB. prefsPtr->frameInfo.dictID, when not 0,
+ * is written into the frame header, so that the decoder can check it uses the same dictionary.
+ * LZ4F_decompress_usingDict() decodes such a frame; dict is taken into account only before the first block of a frame
+ * (LZ4F_getFrameInfo() may be called before), then it is ignored until the next frame.
+ * Neither function copies dict : it must remain unmodified until the frame is completed (LZ4F_compressEnd()) or fully decoded.
+ */
+
+typedef struct LZ4F_CDict_s LZ4F_CDict;
+LZ4F_CDict* LZ4F_createCDict(const void* dictBuffer, size_t dictSize);
+void        LZ4F_freeCDict(LZ4F_CDict* cdict);
+size_t LZ4F_compressBegin_usingCDict(LZ4F_compressionContext_t cctx, void* dstBuffer, size_t dstMaxSize,
+                                     const LZ4F_CDict* cdict, const LZ4F_preferences_t* prefsPtr);
+/* LZ4F_compressBegin_usingDict() loads dict into the LZ4 stream at the start of each frame, and before each independent block,
+ * which can cost more than compressing small payloads. LZ4F_createCDict() digests a dictionary once (returns NULL on allocation failure);
+ * LZ4F_compressBegin_usingCDict() then starts from a copy of the loaded stream. Frames are decoded the same way as those of
+ * LZ4F_compressBegin_usingDict(), and are identical to them unless src directly follows dict in memory : usingDict() then
+ * compresses src as a continuation of dict, while a CDict always references it as a separate dictionary, so frames may differ slightly.
+ * A CDict owns a copy of its dictionary, is never modified after creation, and can be shared
+ * between contexts and threads. It must outlive the frames using it.
+ */
+
 #if defined (__cplusplus)
 }
 #endif
@@ -43,6 +43,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define _LARGE_FILES           /* Large file support on 32-bits AIX */
 #define _FILE_OFFSET_BITS 64   /* Large file support on 32-bits unix */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L   /* pthread, sysconf, pwrite */
+#endif
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE               /* O_DIRECT, syscall, fallocate */
+#endif
 
 
 /*****************************
@@ -57,6 +63,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "lz4.h"      /* still required for legacy format */
 #include "lz4hc.h"    /* still required for legacy format */
 #include "lz4frame.h"
+#include "lz4frame_static.h"   /* LZ4F_resetCompressionContext, LZ4F_resetDecompressionContext, LZ4F_compressBegin_usingCDict */
+#include "xxhash.h"   /* frame checksum of the multi-threaded compressor */
+#include "lz4g.h"
 
 /******************************
 *  OS-specific Includes
@@ -69,12 +78,102 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #  define SET_SPARSE_FILE_MODE(file) { DWORD dw; DeviceIoControl((HANDLE) _get_osfhandle(_fileno(file)), FSCTL_SET_SPARSE, 0, 0, 0, 0, &dw, 0); }
 #  if defined(_MSC_VER) && (_MSC_VER >= 1400)  /* Avoid MSVC fseek()'s 2GiB barrier */
 #    define fseek _fseeki64
+#    define fseeko _fseeki64
+#    define ftello _ftelli64
 #  endif
 #else
 #  define SET_BINARY_MODE(file)
 #  define SET_SPARSE_FILE_MODE(file)
 #endif
 
+/* LZ4G_MULTITHREAD : set to 0 to build without pthread (LZ4G_setNbThreads() then always returns 1) */
+#ifndef LZ4G_MULTITHREAD
+#  if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(_WIN32)
+#    define LZ4G_MULTITHREAD 0
+#  else
+#    define LZ4G_MULTITHREAD 1
+#  endif
+#endif
+
+#if LZ4G_MULTITHREAD
+#  include <pthread.h>   /* pthread_create, pthread_mutex_t, pthread_cond_t */
+#  include <unistd.h>    /* sysconf */
+#endif
+
+/* LZ4G_FDAPI : set to 0 to build without the file descriptor API (mmap, pwrite) */
+#ifndef LZ4G_FDAPI
+#  if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(_WIN32)
+#    define LZ4G_FDAPI 0
+#  else
+#    define LZ4G_FDAPI 1
+#  endif
+#endif
+
+#if LZ4G_FDAPI
+#  include <errno.h>      /* errno, EINTR */
+#  include <sys/mman.h>   /* mmap, munmap, posix_madvise */
+#  include <unistd.h>     /* pwrite, write, lseek, dup, close */
+#endif
+
+/* LZ4G_FALLOCATE : set to 0 to never reserve disk space for decoded frames of known size */
+#ifndef LZ4G_FALLOCATE
+#  if defined(__linux__)
+#    define LZ4G_FALLOCATE 1
+#  else
+#    define LZ4G_FALLOCATE 0
+#  endif
+#endif
+
+#if LZ4G_FALLOCATE
+#  include <fcntl.h>      /* posix_fallocate, fallocate, FALLOC_FL_PUNCH_HOLE */
+#endif
+
+/* LZ4G_SEEKHOLE : set to 0 to read holes of sparse input files, instead of locating them with SEEK_DATA / SEEK_HOLE */
+#ifndef LZ4G_SEEKHOLE
+#  if LZ4G_FDAPI && defined(SEEK_DATA) && defined(SEEK_HOLE)
+#    define LZ4G_SEEKHOLE 1
+#  else
+#    define LZ4G_SEEKHOLE 0
+#  endif
+#endif
+
+/* LZ4G_URING : set to 0 to write file descriptor API output with pwrite() only, instead of io_uring (Linux) */
+#ifndef LZ4G_URING
+#  if LZ4G_FDAPI && defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#      define LZ4G_URING 1
+#    endif
+#  endif
+#  ifndef LZ4G_URING
+#    define LZ4G_URING 0
+#  endif
+#endif
+
+/* LZ4G_ZERO_AVX2 : with GCC on x86, zero detection of the sparse writer is also compiled for AVX2,
+ * and selected at runtime through LZ4_cpuFeatures(), as lz4.c does for its kernels (LZ4_DISPATCH).
+ * Define it to 0 to only use the vector unit of the build target. */
+#ifndef LZ4G_ZERO_AVX2
+#  if !defined(__AVX2__) && defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) \
+   && (__GNUC__ >= 6) && (defined(__x86_64__) || defined(__i386__))
+#    define LZ4G_ZERO_AVX2 1
+#  else
+#    define LZ4G_ZERO_AVX2 0
+#  endif
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_1__) || LZ4G_ZERO_AVX2
+#  include <immintrin.h>        /* _mm256_testz_si256, _mm_testz_si128 */
+#elif defined(__SSE2__)
+#  include <emmintrin.h>        /* _mm_cmpeq_epi8, _mm_movemask_epi8 */
+#endif
+
+#if LZ4G_URING
+#  include <fcntl.h>            /* fcntl, O_DIRECT */
+#  include <sys/syscall.h>      /* __NR_io_uring_setup, __NR_io_uring_enter, __NR_io_uring_register */
+#  include <sys/uio.h>          /* struct iovec */
+#  include <linux/io_uring.h>   /* struct io_uring_params, io_uring_sqe, io_uring_cqe */
+#endif
+
 
 /*****************************
 *  Constants
@@ -99,6 +198,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define LEGACY_BLOCKSIZE   (8 MB)
 #define MIN_STREAM_BUFSIZE (192 KB)
 #define LZ4G_BLOCKSIZEID_DEFAULT 7
+#define LZ4G_BLOCKUNCOMPRESSED_FLAG 0x80000000U
+#define LZ4G_MINHCLEVEL 3
+#define LZ4G_MAXHEADERFRAME_SIZE 19
+#define LZ4G_DICT_MAXSIZE (64 KB)      /* LZ4 only references the last 64 KB of a dictionary */
+#define LZ4G_NBTHREADS_MAX 64
+#define LZ4G_READ_ERROR ((size_t)-1)
+#define LZ4G_SINGLESHOT_MAX (8 MB)    /* frames up to this content size are decoded into a single buffer */
+#define LZ4G_SEEKTABLE_MAGIC  0x184D2A5E   /* skippable frame holding the block index of a seekable frame */
+#define LZ4G_SEEKFOOTER_MAGIC 0x4B454553   /* "SEEK" */
+#define LZ4G_SEEKENTRY_SIZE   8
+#define LZ4G_SEEKFOOTER_SIZE  10
 
 #define sizeT sizeof(size_t)
 #define maskT (sizeT - 1)
@@ -120,18 +230,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 }
 
 
-#define LZ4G_BLOCKSIZEID_DEFAULT 7
 
 /**************************************
 *  Local Parameters
 **************************************/
-static int g_overwrite = 1;
-static int g_blockSizeId = LZ4G_BLOCKSIZEID_DEFAULT;
-static int g_blockChecksum = 0;
-static int g_streamChecksum = 1;
-static int g_blockIndependence = 1;
-static int g_sparseFileSupport = 0;
-static int g_contentSizeFlag = 0;
+/* defaults of LZ4G_createCtx(NULL), and parameters of the context-less API */
+static LZ4G_params_t g_params = {
+    1,                          /* overwrite */
+    LZ4G_BLOCKSIZEID_DEFAULT,   /* blockSizeID */
+    0,                          /* blockChecksum */
+    1,                          /* streamChecksum */
+    1,                          /* blockIndependence */
+    0,                          /* sparseFileSupport */
+    0,                          /* contentSize */
+    1,                          /* nbThreads */
+    0,                          /* asyncIO */
+    0,                          /* directIO */
+    0                           /* seekable */
+};
 
 static const int minBlockSizeID = 4;
 static const int maxBlockSizeID = 7;
@@ -150,11 +266,28 @@ static const int maxBlockSizeID = 7;
 /* ****************** Parameters ******************** */
 /* ************************************************** */
 
+static int LZ4G_resolveNbThreads(int nbThreads)
+{
+#if LZ4G_MULTITHREAD
+    if (nbThreads == 0)
+    {
+        long const nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+        nbThreads = (nbCores > 0) ? (int)nbCores : 1;
+    }
+    if (nbThreads < 1) nbThreads = 1;
+    if (nbThreads > LZ4G_NBTHREADS_MAX) nbThreads = LZ4G_NBTHREADS_MAX;
+    return nbThreads;
+#else
+    (void)nbThreads;
+    return 1;
+#endif
+}
+
 /* Default setting : overwrite = 1; return : overwrite mode (0/1) */
 int LZ4G_setOverwrite(int yes)
 {
-   g_overwrite = (yes!=0);
-   return g_overwrite;
+   g_params.overwrite = (yes!=0);
+   return g_params.overwrite;
 }
 
 /* blockSizeID : valid values : 4-5-6-7 */
@@ -162,44 +295,267 @@ int LZ4G_setBlockSizeID(int bsid)
 {
     static const int blockSizeTable[] = { 64 KB, 256 KB, 1 MB, 4 MB };
     if ((bsid < minBlockSizeID) || (bsid > maxBlockSizeID)) return -1;
-    g_blockSizeId = bsid;
-    return blockSizeTable[g_blockSizeId-minBlockSizeID];
+    g_params.blockSizeID = bsid;
+    return blockSizeTable[g_params.blockSizeID-minBlockSizeID];
 }
 
-typedef enum { LZ4G_blockLinked=0, LZ4G_blockIndependent} LZ4G_blockMode_t;
 int LZ4G_setBlockMode(LZ4G_blockMode_t blockMode)
 {
-    g_blockIndependence = (blockMode == LZ4G_blockIndependent);
-    return g_blockIndependence;
+    g_params.blockIndependence = (blockMode == LZ4G_blockIndependent);
+    return g_params.blockIndependence;
 }
 
 /* Default setting : no checksum */
 int LZ4G_setBlockChecksumMode(int xxhash)
 {
-    g_blockChecksum = (xxhash != 0);
-    return g_blockChecksum;
+    g_params.blockChecksum = (xxhash != 0);
+    return g_params.blockChecksum;
 }
 
 /* Default setting : checksum enabled */
 int LZ4G_setStreamChecksumMode(int xxhash)
 {
-    g_streamChecksum = (xxhash != 0);
-    return g_streamChecksum;
+    g_params.streamChecksum = (xxhash != 0);
+    return g_params.streamChecksum;
 }
 
 
 /* Default setting : 0 (disabled) */
 int LZ4G_setSparseFile(int enable)
 {
-    g_sparseFileSupport = (enable!=0);
-    return g_sparseFileSupport;
+    g_params.sparseFileSupport = (enable!=0);
+    return g_params.sparseFileSupport;
 }
 
 /* Default setting : 0 (disabled) */
 int LZ4G_setContentSize(int enable)
 {
-    g_contentSizeFlag = (enable!=0);
-    return g_contentSizeFlag;
+    g_params.contentSize = (enable!=0);
+    return g_params.contentSize;
+}
+
+/* Default setting : 1 (single-threaded) ; 0 means : one thread per online core */
+int LZ4G_setNbThreads(int nbThreads)
+{
+    g_params.nbThreads = LZ4G_resolveNbThreads(nbThreads);
+    return g_params.nbThreads;
+}
+
+/* Default setting : 0 (disabled) ; always 0 without LZ4G_MULTITHREAD */
+int LZ4G_setAsyncIO(int enable)
+{
+    g_params.asyncIO = LZ4G_MULTITHREAD && (enable!=0);
+    return g_params.asyncIO;
+}
+
+/* Default setting : 0 (disabled) ; always 0 without LZ4G_URING */
+int LZ4G_setDirectIO(int enable)
+{
+    g_params.directIO = LZ4G_URING && (enable!=0);
+    return g_params.directIO;
+}
+
+/* Default setting : 0 (disabled) */
+int LZ4G_setSeekable(int enable)
+{
+    g_params.seekable = (enable!=0);
+    return g_params.seekable;
+}
+
+
+/* ************************************************** */
+/* ****************** Context *********************** */
+/* ************************************************** */
+
+/* block index of a seekable frame : skippable frame header, then one entry per block */
+typedef struct {
+    unsigned char* buffer;
+    size_t size;
+    size_t capacity;
+} LZ4G_seekTable_t;
+
+struct LZ4G_ctx_s
+{
+    LZ4G_params_t params;
+    LZ4F_compressionContext_t cctx;     /* created on first compression */
+    LZ4F_decompressionContext_t dctx;   /* created on first decompression */
+    void*  inBuff;
+    void*  outBuff;
+    size_t inBuffSize;
+    size_t outBuffSize;
+    unsigned nbFrames;                  /* streams met by current decompression */
+    LZ4G_seekTable_t seekTable;         /* block index of the frame being compressed (seekable frames) */
+    void*  dict;                        /* private copy of the loaded dictionary (last 64 KB) */
+    size_t dictSize;
+    unsigned dictID;
+    LZ4F_CDict* cdict;                  /* dict, digested once for all compressions */
+#if LZ4G_URING
+    struct LZ4G_uring_s* uring;         /* created by the first file descriptor API stream */
+#endif
+};
+
+#if LZ4G_URING
+static void LZ4G_uringFree(struct LZ4G_uring_s* uring);
+#endif
+
+LZ4G_ctx* LZ4G_createCtx(const LZ4G_params_t* paramsPtr)
+{
+    LZ4G_ctx* const ctx = (LZ4G_ctx*)calloc(1, sizeof(LZ4G_ctx));
+    if (ctx == NULL) return NULL;
+    ctx->params = g_params;
+    if ((paramsPtr != NULL) && LZ4G_setCtxParams(ctx, paramsPtr)) { free(ctx); return NULL; }
+    return ctx;
+}
+
+void LZ4G_freeCtx(LZ4G_ctx* ctx)
+{
+    if (ctx == NULL) return;
+    if (ctx->cctx) LZ4F_freeCompressionContext(ctx->cctx);
+    if (ctx->dctx) LZ4F_freeDecompressionContext(ctx->dctx);
+#if LZ4G_URING
+    LZ4G_uringFree(ctx->uring);
+#endif
+    free(ctx->inBuff);
+    free(ctx->outBuff);
+    free(ctx->seekTable.buffer);
+    free(ctx->dict);
+    LZ4F_freeCDict(ctx->cdict);
+    free(ctx);
+}
+
+int LZ4G_loadDictionary(LZ4G_ctx* ctx, const void* dict, size_t dictSize, unsigned dictID)
+{
+    free(ctx->dict);
+    LZ4F_freeCDict(ctx->cdict);
+    ctx->dict = NULL;
+    ctx->cdict = NULL;
+    ctx->dictSize = 0;
+    ctx->dictID = 0;
+    if ((dict == NULL) || (dictSize == 0)) return 0;
+    if (dictSize > LZ4G_DICT_MAXSIZE) { dict = (const char*)dict + (dictSize - LZ4G_DICT_MAXSIZE); dictSize = LZ4G_DICT_MAXSIZE; }
+    ctx->dict = malloc(dictSize);
+    ctx->cdict = LZ4F_createCDict(dict, dictSize);
+    if ((ctx->dict == NULL) || (ctx->cdict == NULL)) { LZ4G_loadDictionary(ctx, NULL, 0, 0); return -1; }
+    memcpy(ctx->dict, dict, dictSize);
+    ctx->dictSize = dictSize;
+    ctx->dictID = dictID;
+    return 0;
+}
+
+/* LZ4G_checkDictID() : a frame can be decoded if it references no dictionary, or the one loaded into ctx.
+ * Frames referencing no dictionary are decoded with the loaded one, if any, as LZ4F_decompress_usingDict() does */
+static int LZ4G_checkDictID(const LZ4G_ctx* ctx, unsigned frameDictID, char** errstring, int* nerrbytes)
+{
+    if (frameDictID == 0) return 0;
+    if (ctx->dictSize == 0) LZ4G_RETURN_ERROR_DOTS(64, "Dictionary error : frame requires dictionary %u", frameDictID);
+    if ((ctx->dictID != 0) && (ctx->dictID != frameDictID))
+        LZ4G_RETURN_ERROR_DOTS(64, "Dictionary error : frame requires dictionary %u, not %u", frameDictID, ctx->dictID);
+    return 0;
+}
+
+int LZ4G_setCtxParams(LZ4G_ctx* ctx, const LZ4G_params_t* params)
+{
+    if ((params->blockSizeID < minBlockSizeID) || (params->blockSizeID > maxBlockSizeID)) return -1;
+    ctx->params.overwrite = (params->overwrite != 0);
+    ctx->params.blockSizeID = params->blockSizeID;
+    ctx->params.blockChecksum = (params->blockChecksum != 0);
+    ctx->params.streamChecksum = (params->streamChecksum != 0);
+    ctx->params.blockIndependence = (params->blockIndependence != 0);
+    ctx->params.sparseFileSupport = (params->sparseFileSupport != 0);
+    ctx->params.contentSize = (params->contentSize != 0);
+    ctx->params.nbThreads = LZ4G_resolveNbThreads(params->nbThreads);
+    ctx->params.asyncIO = LZ4G_MULTITHREAD && (params->asyncIO != 0);
+    ctx->params.directIO = LZ4G_URING && (params->directIO != 0);
+    ctx->params.seekable = (params->seekable != 0);
+    return 0;
+}
+
+void LZ4G_getCtxParams(const LZ4G_ctx* ctx, LZ4G_params_t* params)
+{
+    *params = ctx->params;
+}
+
+/* LZ4G_reserveBuffers() :
+ * grows context I/O buffers if needed; result : 0 on success, 1 on allocation failure */
+static int LZ4G_reserveBuffers(LZ4G_ctx* ctx, size_t inSize, size_t outSize)
+{
+    if (ctx->inBuffSize < inSize)
+    {
+        free(ctx->inBuff);
+        ctx->inBuff = malloc(inSize);
+        ctx->inBuffSize = ctx->inBuff ? inSize : 0;
+        if (ctx->inBuff == NULL) return 1;
+    }
+    if (ctx->outBuffSize < outSize)
+    {
+        free(ctx->outBuff);
+        ctx->outBuff = malloc(outSize);
+        ctx->outBuffSize = ctx->outBuff ? outSize : 0;
+        if (ctx->outBuff == NULL) return 1;
+    }
+    return 0;
+}
+
+
+/* ************************************************** */
+/* ****************** Context pool ****************** */
+/* ************************************************** */
+
+/* LZ4G_POOL_SIZE : max nb of idle contexts kept by the context-less API (0 disables the pool).
+ * A pooled context keeps its LZ4F contexts and buffers, so steady-state streams do not allocate.
+ * The pool is protected by a mutex, hence requires LZ4G_MULTITHREAD. */
+#ifndef LZ4G_POOL_SIZE
+#  define LZ4G_POOL_SIZE 16
+#endif
+
+#if LZ4G_MULTITHREAD && (LZ4G_POOL_SIZE > 0)
+#  define LZ4G_POOL 1
+static pthread_mutex_t g_poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static LZ4G_ctx* g_pool[LZ4G_POOL_SIZE];
+static int g_poolCount = 0;
+#else
+#  define LZ4G_POOL 0
+#endif
+
+/* LZ4G_poolAcquire() : idle context if any, using current defaults, otherwise a new one */
+static LZ4G_ctx* LZ4G_poolAcquire(void)
+{
+#if LZ4G_POOL
+    LZ4G_ctx* ctx = NULL;
+    pthread_mutex_lock(&g_poolMutex);
+    if (g_poolCount > 0) ctx = g_pool[--g_poolCount];
+    pthread_mutex_unlock(&g_poolMutex);
+    if (ctx != NULL)
+    {
+        ctx->params = g_params;
+        return ctx;
+    }
+#endif
+    return LZ4G_createCtx(NULL);
+}
+
+/* LZ4G_poolRelease() : contexts remain valid after an error, so they are always given back */
+static void LZ4G_poolRelease(LZ4G_ctx* ctx)
+{
+#if LZ4G_POOL
+    pthread_mutex_lock(&g_poolMutex);
+    if (g_poolCount < LZ4G_POOL_SIZE)
+    {
+        g_pool[g_poolCount++] = ctx;
+        ctx = NULL;
+    }
+    pthread_mutex_unlock(&g_poolMutex);
+#endif
+    LZ4G_freeCtx(ctx);
+}
+
+void LZ4G_freePool(void)
+{
+#if LZ4G_POOL
+    pthread_mutex_lock(&g_poolMutex);
+    while (g_poolCount > 0) LZ4G_freeCtx(g_pool[--g_poolCount]);
+    pthread_mutex_unlock(&g_poolMutex);
+#endif
 }
 
 
@@ -230,16 +586,16 @@ static void LZ4G_writeLE32 (void* p, unsigned value32)
     dstPtr[3] = (unsigned char)(value32 >> 24);
 }
 
-static int LZ4G_decodeLegacyStream(FILE* finput, FILE* foutput, unsigned long long* ret, char** errstring, int* nerrbytes)
+static int LZ4G_decodeLegacyStream(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, unsigned long long* ret, char** errstring, int* nerrbytes)
 {
     unsigned long long filesize = 0;
     char* in_buff;
     char* out_buff;
 
     /* Allocate Memory */
-    in_buff = (char*)malloc(LZ4_compressBound(LEGACY_BLOCKSIZE));
-    out_buff = (char*)malloc(LEGACY_BLOCKSIZE);
-    if (!in_buff || !out_buff) LZ4G_RETURN_ERROR(51, "Allocation error : not enough memory");
+    if (LZ4G_reserveBuffers(ctx, LZ4_compressBound(LEGACY_BLOCKSIZE), LEGACY_BLOCKSIZE)) LZ4G_RETURN_ERROR(51, "Allocation error : not enough memory");
+    in_buff = (char*)ctx->inBuff;
+    out_buff = (char*)ctx->outBuff;
 
     /* Main Loop */
     while (1)
@@ -272,377 +628,2820 @@ static int LZ4G_decodeLegacyStream(FILE* finput, FILE* foutput, unsigned long lo
         if (sizeCheck != (size_t)decodeSize) LZ4G_RETURN_ERROR(54, "Write error : cannot write decoded block into output\n");
     }
 
-    /* Free */
-    free(in_buff);
-    free(out_buff);
-
     *ret = filesize;
     return 0;
 }
 
-static int LZ4G_decodeLZ4S(FILE* finput, FILE* foutput,  unsigned long long* ret, char** errstring, int* nerrbytes)
-{
-    unsigned long long filesize = 0;
-    void* inBuff;
-    void* outBuff;
-#   define HEADERMAX 20
-    char  headerBuff[HEADERMAX];
-    size_t sizeCheck;
-    const size_t inBuffSize = 256 KB;
-    const size_t outBuffSize = 256 KB;
-    LZ4F_decompressionContext_t ctx;
-    LZ4F_errorCode_t errorCode;
-    unsigned storedSkips = 0;
-
-    /* init */
-    errorCode = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
-    if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(60, "Can't create context : %s", LZ4F_getErrorName(errorCode));
-    LZ4G_writeLE32(headerBuff, LZ4G_MAGICNUMBER);   /* regenerated here, as it was already read from finput */
+/***************************************
+*   Sparse file output
+***************************************/
 
-    /* Allocate Memory */
-    inBuff = malloc(256 KB);
-    outBuff = malloc(256 KB);
-    if (!inBuff || !outBuff) LZ4G_RETURN_ERROR(61, "Allocation error : not enough memory");
+#define LZ4G_SPARSE_SEGMENT (32 KB)
 
-    /* Init feed with magic number (already consumed from FILE) */
+#if defined(__AVX2__) || LZ4G_ZERO_AVX2
+#  if LZ4G_ZERO_AVX2
+#    define LZ4G_TARGET_AVX2 __attribute__((target("avx2")))
+#  else
+#    define LZ4G_TARGET_AVX2
+#  endif
+/* LZ4G_zeroScanAVX2() : skips leading zeroes by 128 then 32 bytes; result : first position not skipped */
+static LZ4G_TARGET_AVX2 const unsigned char* LZ4G_zeroScanAVX2(const unsigned char* ptr, const unsigned char* end)
+{
+    while ((size_t)(end - ptr) >= 128)
     {
-        size_t inSize = 4;
-        size_t outSize=0;
-        LZ4G_writeLE32(inBuff, LZ4G_MAGICNUMBER);
-        errorCode = LZ4F_decompress(ctx, outBuff, &outSize, inBuff, &inSize, NULL);
-        if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(62, "Header error : %s", LZ4F_getErrorName(errorCode));
+        const __m256i* const v = (const __m256i*)(const void*)ptr;
+        __m256i const acc = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256(v), _mm256_loadu_si256(v+1)),
+                                            _mm256_or_si256(_mm256_loadu_si256(v+2), _mm256_loadu_si256(v+3)));
+        if (!_mm256_testz_si256(acc, acc)) break;
+        ptr += 128;
     }
-
-
-    /* Main Loop */
-    for (;;)
+    while ((size_t)(end - ptr) >= 32)
     {
-        size_t readSize;
-        size_t pos = 0;
-
-        /* Read input */
-        readSize = fread(inBuff, 1, inBuffSize, finput);
-        if (!readSize) break;   /* empty file or stream */
+        __m256i const v = _mm256_loadu_si256((const __m256i*)(const void*)ptr);
+        if (!_mm256_testz_si256(v, v)) break;
+        ptr += 32;
+    }
+    return ptr;
+}
+#endif
 
-        while (pos < readSize)
-        {
-            /* Decode Input (at least partially) */
-            size_t remaining = readSize - pos;
-            size_t decodedBytes = outBuffSize;
-            errorCode = LZ4F_decompress(ctx, outBuff, &decodedBytes, (char*)inBuff+pos, &remaining, NULL);
-            if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(66, "Decompression error : %s", LZ4F_getErrorName(errorCode));
-            pos += remaining;
+/* LZ4G_zeroScan() : same, with the widest vector unit of the build target */
+static const unsigned char* LZ4G_zeroScan(const unsigned char* ptr, const unsigned char* end)
+{
+#if defined(__AVX2__)
+    ptr = LZ4G_zeroScanAVX2(ptr, end);
+#elif defined(__SSE2__)
+    while ((size_t)(end - ptr) >= 64)
+    {
+        const __m128i* const v = (const __m128i*)(const void*)ptr;
+        __m128i const acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(v), _mm_loadu_si128(v+1)),
+                                         _mm_or_si128(_mm_loadu_si128(v+2), _mm_loadu_si128(v+3)));
+#  if defined(__SSE4_1__)
+        if (!_mm_testz_si128(acc, acc)) break;
+#  else
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) break;
+#  endif
+        ptr += 64;
+    }
+#else
+    (void)end;
+#endif
+    return ptr;
+}
 
-            if (decodedBytes)
-            {
-                /* Write Block */
-                filesize += decodedBytes;
-                if (g_sparseFileSupport)
-                {
-                    size_t* const oBuffStartT = (size_t*)outBuff;   /* since outBuff is malloc'ed, it's aligned on size_t */
-                    size_t* oBuffPosT = oBuffStartT;
-                    size_t  oBuffSizeT = decodedBytes / sizeT;
-                    size_t* const oBuffEndT = oBuffStartT + oBuffSizeT;
-                    static const size_t bs0T = (32 KB) / sizeT;
-                    while (oBuffPosT < oBuffEndT)
-                    {
-                        size_t seg0SizeT = bs0T;
-                        size_t nb0T;
-                        int seekResult;
-                        if (seg0SizeT > oBuffSizeT) seg0SizeT = oBuffSizeT;
-                        oBuffSizeT -= seg0SizeT;
-                        for (nb0T=0; (nb0T < seg0SizeT) && (oBuffPosT[nb0T] == 0); nb0T++) ;
-                        storedSkips += (unsigned)(nb0T * sizeT);
-                        if (storedSkips > 1 GB)   /* avoid int overflow */
-                        {
-                            seekResult = fseek(foutput, 1 GB, SEEK_CUR);
-                            if (seekResult != 0) LZ4G_RETURN_ERROR(68, "1 GB skip error (sparse file)");
-                            storedSkips -= 1 GB;
-                        }
-                        if (nb0T != seg0SizeT)   /* not all 0s */
-                        {
-                            seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-                            if (seekResult) LZ4G_RETURN_ERROR(68, "Skip error (sparse file)");
-                            storedSkips = 0;
-                            seg0SizeT -= nb0T;
-                            oBuffPosT += nb0T;
-                            sizeCheck = fwrite(oBuffPosT, sizeT, seg0SizeT, foutput);
-                            if (sizeCheck != seg0SizeT) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded block");
-                        }
-                        oBuffPosT += seg0SizeT;
-                    }
-                    if (decodedBytes & maskT)   /* size not multiple of sizeT (necessarily end of block) */
-                    {
-                        const char* const restStart = (char*)oBuffEndT;
-                        const char* restPtr = restStart;
-                        size_t  restSize =  decodedBytes & maskT;
-                        const char* const restEnd = restStart + restSize;
-                        for (; (restPtr < restEnd) && (*restPtr == 0); restPtr++) ;
-                        storedSkips += (unsigned) (restPtr - restStart);
-                        if (restPtr != restEnd)
-                        {
-                            int seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-                            if (seekResult) LZ4G_RETURN_ERROR(68, "Skip error (end of block)");
-                            storedSkips = 0;
-                            sizeCheck = fwrite(restPtr, 1, restEnd - restPtr, foutput);
-                            if (sizeCheck != (size_t)(restEnd - restPtr)) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded end of block");
-                        }
-                    }
-                }
-                else
-                {
-                    sizeCheck = fwrite(outBuff, 1, decodedBytes, foutput);
-                    if (sizeCheck != decodedBytes) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded block");
-                }
-            }
-        }
+/* LZ4G_zeroPrefix() :
+ * nb of leading zero bytes of buffer, scanned with AVX2 when the CPU supports it (see LZ4G_ZERO_AVX2),
+ * or else with the widest vector unit of the build target */
+static size_t LZ4G_zeroPrefix(const void* buffer, size_t size)
+{
+    const unsigned char* const start = (const unsigned char*)buffer;
+    const unsigned char* const end = start + size;
+    const unsigned char* ptr = start;
 
+#if LZ4G_ZERO_AVX2
+    ptr = (LZ4_cpuFeatures() & LZ4_CPU_AVX2) ? LZ4G_zeroScanAVX2(ptr, end) : LZ4G_zeroScan(ptr, end);
+#else
+    ptr = LZ4G_zeroScan(ptr, end);
+#endif
+    while ((size_t)(end - ptr) >= sizeT)
+    {
+        size_t word;
+        memcpy(&word, ptr, sizeT);
+        if (word) break;
+        ptr += sizeT;
     }
+    while ((ptr < end) && (*ptr == 0)) ptr++;
+    return (size_t)(ptr - start);
+}
 
-    if ((g_sparseFileSupport) && (storedSkips>0))
+/* LZ4G_sparseSeek() : moves forward by skips bytes, by steps fseek() can represent */
+static int LZ4G_sparseSeek(FILE* file, unsigned long long skips)
+{
+    while (skips > 1 GB)
     {
-        int seekResult;
-        storedSkips --;
-        seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-        if (seekResult != 0) LZ4G_RETURN_ERROR(69, "Final skip error (sparse file)\n");
-        memset(outBuff, 0, 1);
-        sizeCheck = fwrite(outBuff, 1, 1, foutput);
-        if (sizeCheck != 1) LZ4G_RETURN_ERROR(69, "Write error : cannot write last zero\n");
+        if (fseek(file, 1 GB, SEEK_CUR)) return 1;
+        skips -= 1 GB;
     }
+    return (skips > 0) ? (fseek(file, (long)skips, SEEK_CUR) != 0) : 0;
+}
 
-    /* Free */
-    free(inBuff);
-    free(outBuff);
-    errorCode = LZ4F_freeDecompressionContext(ctx);
-    if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(69, "Error : can't free LZ4F context resource : %s", LZ4F_getErrorName(errorCode));
+/* Output is cut into segments of LZ4G_SPARSE_SEGMENT bytes; the leading zeroes of each segment
+ * are skipped, and consecutive non-zero parts are written by a single fwrite() */
+int LZ4G_sparseWrite(FILE* file, const void* buffer, size_t size, unsigned long long* storedSkips)
+{
+    const char* const end = (const char*)buffer + size;
+    const char* ptr = (const char*)buffer;
+    const char* extent = NULL;   /* start of data not written yet */
 
-    *ret = filesize;
+    while (ptr < end)
+    {
+        size_t const segSize = ((size_t)(end - ptr) < LZ4G_SPARSE_SEGMENT) ? (size_t)(end - ptr) : LZ4G_SPARSE_SEGMENT;
+        size_t const nb0 = LZ4G_zeroPrefix(ptr, segSize);
+        if (nb0 && extent)
+        {
+            if (fwrite(extent, 1, (size_t)(ptr - extent), file) != (size_t)(ptr - extent)) return 1;
+            extent = NULL;
+        }
+        *storedSkips += nb0;
+        if ((nb0 < segSize) && (extent == NULL))
+        {
+            if (LZ4G_sparseSeek(file, *storedSkips)) return 1;
+            *storedSkips = 0;
+            extent = ptr + nb0;
+        }
+        ptr += segSize;
+    }
+    if (extent && (fwrite(extent, 1, (size_t)(end - extent), file) != (size_t)(end - extent))) return 1;
     return 0;
 }
 
-
-static int LZ4G_passThrough(FILE* finput, FILE* foutput, unsigned char U32store[MAGICNUMBER_SIZE],   unsigned long long* ret, char** errstring, int* nerrbytes)
+int LZ4G_sparseWriteEnd(FILE* file, unsigned long long storedSkips)
 {
-    void* buffer = malloc(64 KB);
-    size_t read = 1, sizeCheck;
-    unsigned long long total = MAGICNUMBER_SIZE;
-
-    sizeCheck = fwrite(U32store, 1, MAGICNUMBER_SIZE, foutput);
-    if (sizeCheck != MAGICNUMBER_SIZE) LZ4G_RETURN_ERROR(50, "Pass-through error at start");
+    static const char lastZero = 0;
+    if (storedSkips == 0) return 0;
+    if (LZ4G_sparseSeek(file, storedSkips - 1)) return 1;
+    return (fwrite(&lastZero, 1, 1, file) != 1);
+}
 
-    while (read)
+/* LZ4G_fwriteSparse() :
+ * writes decoded data into foutput, through LZ4G_sparseWrite() when sparseMode is enabled,
+ * *storedSkips accumulating pending skips, to be completed by LZ4G_fwriteSparseEnd() */
+static int LZ4G_fwriteSparse(int sparseMode, FILE* foutput, const void* buffer, size_t bufferSize, unsigned long long* storedSkips, char** errstring, int* nerrbytes)
+{
+    if (!sparseMode)
     {
-        read = fread(buffer, 1, 64 KB, finput);
-        total += read;
-        sizeCheck = fwrite(buffer, 1, read, foutput);
-        if (sizeCheck != read) LZ4G_RETURN_ERROR(50, "Pass-through error");
+        size_t const sizeCheck = fwrite(buffer, 1, bufferSize, foutput);
+        if (sizeCheck != bufferSize) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded block");
+        return 0;
     }
+    if (LZ4G_sparseWrite(foutput, buffer, bufferSize, storedSkips)) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded block (sparse file)");
+    return 0;
+}
 
-    free(buffer);
-    *ret = total;
+/* LZ4G_fwriteSparseEnd() :
+ * completes pending skips by writing the last zero byte, so that the file gets its final size */
+static int LZ4G_fwriteSparseEnd(int sparseMode, FILE* foutput, unsigned long long storedSkips, char** errstring, int* nerrbytes)
+{
+    if (sparseMode && LZ4G_sparseWriteEnd(foutput, storedSkips)) LZ4G_RETURN_ERROR(69, "Write error : cannot write last zero (sparse file)");
     return 0;
 }
 
 
+/***************************************
+*   I/O functions
+***************************************/
 
-#define ENDOFSTREAM ((unsigned long long)-1)
-static int LZ4G_selectDecoder( FILE* finput,  FILE* foutput, unsigned long long* ret, char** errstring, int* nerrbytes)
+/* Streams are read and written through LZ4G_readFunction / LZ4G_writeFunction,
+ * FILE* being one implementation among others */
+typedef struct {
+    LZ4G_readFunction  read;
+    void* readOpaque;
+    LZ4G_writeFunction write;
+    void* writeOpaque;
+    FILE* holeInput;   /* input read by read(), whose holes can be skipped with LZ4G_skipHole(); NULL otherwise */
+} LZ4G_io_t;
+
+static size_t LZ4G_fileRead(void* opaque, void* buffer, size_t size)
 {
-    unsigned char U32store[MAGICNUMBER_SIZE];
-    unsigned magicNumber, size;
-    int errorNb;
-    size_t nbReadBytes;
-    static unsigned nbCalls = 0;
+    FILE* const finput = (FILE*)opaque;
+    size_t const readSize = fread(buffer, 1, size, finput);
+    if ((readSize == 0) && ferror(finput)) return LZ4G_READ_ERROR;
+    return readSize;
+}
 
-    /* init */
-    nbCalls++;
+static size_t LZ4G_fileWrite(void* opaque, const void* buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, (FILE*)opaque);
+}
 
-    /* Check Archive Header */
-    nbReadBytes = fread(U32store, 1, MAGICNUMBER_SIZE, finput);
-    if (nbReadBytes==0) {
-      *ret = ENDOFSTREAM;                  /* EOF */
-      return 0;
-    }
-    if (nbReadBytes != MAGICNUMBER_SIZE) LZ4G_RETURN_ERROR(40, "Unrecognized header : Magic Number unreadable");
-    magicNumber = LZ4G_readLE32(U32store);   /* Little Endian format */
-    if (LZ4G_isSkippableMagicNumber(magicNumber)) magicNumber = LZ4G_SKIPPABLE0;  /* fold skippable magic numbers */
+static void LZ4G_fileIo(LZ4G_io_t* io, FILE* finput, FILE* foutput)
+{
+    io->read = LZ4G_fileRead;
+    io->readOpaque = finput;
+    io->write = LZ4G_fileWrite;
+    io->writeOpaque = foutput;
+    io->holeInput = NULL;
+}
 
-    switch(magicNumber)
+/* LZ4G_readFull() :
+ * reads size bytes, unless end of input is reached first (as fread() does).
+ * result : nb of bytes read, or LZ4G_READ_ERROR */
+static size_t LZ4G_readFull(const LZ4G_io_t* io, void* buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
     {
-    case LZ4G_MAGICNUMBER:
-        return LZ4G_DEFAULT_DECOMPRESSOR(finput, foutput, ret, errstring, nerrbytes);
-    case LEGACY_MAGICNUMBER:
-        /*DISPLAYLEVEL(4, "Detected : Legacy format \n");*/
-        return LZ4G_decodeLegacyStream(finput, foutput, ret, errstring, nerrbytes);
-    case LZ4G_SKIPPABLE0:
-        /*DISPLAYLEVEL(4, "Skipping detected skippable area \n");*/
-        nbReadBytes = fread(U32store, 1, 4, finput);
-        if (nbReadBytes != 4) LZ4G_RETURN_ERROR(42, "Stream error : skippable size unreadable");
-        size = LZ4G_readLE32(U32store);     /* Little Endian format */
-        errorNb = fseek(finput, size, SEEK_CUR);
-        if (errorNb != 0) LZ4G_RETURN_ERROR(43, "Stream error : cannot skip skippable area");
-        return LZ4G_selectDecoder(finput, foutput, ret, errstring, nerrbytes);
-    EXTENDED_FORMAT;
-    default:
-        if (nbCalls == 1)   /* just started */
-        {
-          if (g_overwrite) {
-            return LZ4G_passThrough(finput, foutput, U32store, ret, errstring, nerrbytes);
-          }
-          LZ4G_RETURN_ERROR(44,"Unrecognized header : file cannot be decoded: Wrong magic number at the beginning of 1st stream.");
-        }
-        /*DISPLAYLEVEL(2, "Stream followed by unrecognized data\n");*/
-        *ret = ENDOFSTREAM;
-        return 0;
+        size_t const readSize = io->read(io->readOpaque, (char*)buffer + total, size - total);
+        if (readSize == LZ4G_READ_ERROR) return LZ4G_READ_ERROR;
+        if (readSize == 0) break;
+        total += readSize;
     }
+    return total;
 }
 
+/* LZ4G_getFileSize() :
+ * nb of bytes remaining to read from finput, when it is a regular file; 0 otherwise (stdin, pipe, device) */
+static unsigned long long LZ4G_getFileSize(FILE* finput)
+{
+    long long pos;
+    int r;
+#if defined(_MSC_VER)
+    struct _stat64 statbuf;
+    r = _fstat64(_fileno(finput), &statbuf);
+    pos = _ftelli64(finput);
+#else
+    struct stat statbuf;
+    r = fstat(fileno(finput), &statbuf);
+    pos = (long long)ftello(finput);
+#endif
+    if (r || !S_ISREG(statbuf.st_mode) || (pos < 0) || (pos > (long long)statbuf.st_size)) return 0;
+    return (unsigned long long)statbuf.st_size - (unsigned long long)pos;
+}
 
+#if LZ4G_FDAPI
+/* LZ4G_holeAt() :
+ * 1 if the size bytes at position pos of fd all lie within a hole of a sparse regular file, 0 otherwise.
+ * *dataEnd caches the end of the last data extent found (start with 0), so that dense files cost no more system calls;
+ * it is set to (unsigned long long)-1 when holes can't be located. The file offset of fd is preserved. */
+static int LZ4G_holeAt(int fd, unsigned long long pos, size_t size, unsigned long long* dataEnd)
+{
+#if LZ4G_SEEKHOLE
+    off_t current, data;
+    int hole = 0;
+
+    if (pos + size <= *dataEnd) return 0;
+    current = lseek(fd, 0, SEEK_CUR);
+    if (current < 0) { *dataEnd = (unsigned long long)-1; return 0; }
+    data = lseek(fd, (off_t)pos, SEEK_DATA);
+    if (data < 0)
+    {
+        struct stat statbuf;
+        if ((errno == ENXIO) && !fstat(fd, &statbuf))
+            hole = (pos + size <= (unsigned long long)statbuf.st_size);   /* no data left : hole up to end of file */
+        else
+            *dataEnd = (unsigned long long)-1;   /* not supported */
+    }
+    else if ((unsigned long long)data >= pos + size) hole = 1;
+    else
+    {
+        off_t const holeStart = lseek(fd, data, SEEK_HOLE);
+        *dataEnd = (holeStart < 0) ? (unsigned long long)-1 : (unsigned long long)holeStart;
+    }
+    lseek(fd, current, SEEK_SET);
+    return hole;
+#else
+    (void)fd; (void)pos; (void)size;
+    *dataEnd = (unsigned long long)-1;
+    return 0;
+#endif
+}
+#endif
 
+int LZ4G_skipHole(FILE* finput, size_t size, unsigned long long* dataEnd)
+{
+#if LZ4G_SEEKHOLE
+    off_t pos;
+    if (*dataEnd == (unsigned long long)-1) return 0;
+    pos = ftello(finput);
+    if (pos < 0) { *dataEnd = (unsigned long long)-1; return 0; }   /* pipe, device */
+    if (!LZ4G_holeAt(fileno(finput), (unsigned long long)pos, size, dataEnd)) return 0;
+    return fseeko(finput, pos + (off_t)size, SEEK_SET) == 0;
+#else
+    (void)finput; (void)size;
+    *dataEnd = (unsigned long long)-1;
+    return 0;
+#endif
+}
+
+/* LZ4G_preallocate() :
+ * reserves disk space for size bytes from the current position of foutput, when it is a regular file,
+ * so that a frame of known size is written into contiguous extents.
+ * Best effort : on failure, data is simply written as usual. */
+static void LZ4G_preallocate(FILE* foutput, unsigned long long size)
+{
+#if LZ4G_FALLOCATE
+    struct stat statbuf;
+    int const fd = fileno(foutput);
+    off_t const pos = ftello(foutput);
+    if ((size == 0) || (pos < 0) || fstat(fd, &statbuf) || !S_ISREG(statbuf.st_mode)) return;
+    (void)posix_fallocate(fd, pos, (off_t)size);
+#else
+    (void)foutput; (void)size;
+#endif
+}
+
+
+/***************************************
+*   Seekable frames
+***************************************/
+
+/* Block index of a seekable frame, written right after it :
+ *   skippable frame header : LZ4G_SEEKTABLE_MAGIC, size of what follows (LE32)
+ *   per block : compressed size, size prefix and block checksum included (LE32), decoded size (LE32)
+ *   footer : nb of blocks (LE32), frame header size (1 byte), flags (1 byte, bit 0 : content checksum), LZ4G_SEEKFOOTER_MAGIC (LE32)
+ * The footer ends the file, so that the index, then the frame, are located from the end.
+ * Table functions accept NULL (frame is not seekable), and then do nothing. */
+
+/* LZ4G_seekTableReserve() : result : 0 on success, 1 on allocation failure */
+static int LZ4G_seekTableReserve(LZ4G_seekTable_t* table, size_t size)
+{
+    unsigned char* buffer;
+    size_t capacity = table->capacity ? table->capacity : 4 KB;
+    if (size <= table->capacity) return 0;
+    while (capacity < size) capacity *= 2;
+    buffer = (unsigned char*)realloc(table->buffer, capacity);
+    if (buffer == NULL) return 1;
+    table->buffer = buffer;
+    table->capacity = capacity;
+    return 0;
+}
+
+/* LZ4G_seekTableStart() : result : 0 on success, 1 on allocation failure */
+static int LZ4G_seekTableStart(LZ4G_seekTable_t* table)
+{
+    if (table == NULL) return 0;
+    table->size = 8;
+    return LZ4G_seekTableReserve(table, table->size + LZ4G_SEEKFOOTER_SIZE);
+}
+
+/* LZ4G_seekTableAdd() : indexes the next block; result : 0 on success, 1 on allocation failure */
+static int LZ4G_seekTableAdd(LZ4G_seekTable_t* table, size_t cSize, size_t dSize)
+{
+    if (table == NULL) return 0;
+    if (LZ4G_seekTableReserve(table, table->size + LZ4G_SEEKENTRY_SIZE + LZ4G_SEEKFOOTER_SIZE)) return 1;
+    LZ4G_writeLE32(table->buffer + table->size, (unsigned)cSize);
+    LZ4G_writeLE32(table->buffer + table->size + 4, (unsigned)dSize);
+    table->size += LZ4G_SEEKENTRY_SIZE;
+    return 0;
+}
+
+/* LZ4G_seekTableFinish() : completes the skippable frame within table->buffer; result : its size (0 if table is NULL) */
+static size_t LZ4G_seekTableFinish(LZ4G_seekTable_t* table, size_t headerSize, int checksum)
+{
+    unsigned char* footer;
+    if (table == NULL) return 0;
+    footer = table->buffer + table->size;
+    LZ4G_writeLE32(footer, (unsigned)((table->size - 8) / LZ4G_SEEKENTRY_SIZE));
+    footer[4] = (unsigned char)headerSize;
+    footer[5] = (unsigned char)(checksum != 0);
+    LZ4G_writeLE32(footer + 6, LZ4G_SEEKFOOTER_MAGIC);
+    table->size += LZ4G_SEEKFOOTER_SIZE;
+    LZ4G_writeLE32(table->buffer, LZ4G_SEEKTABLE_MAGIC);
+    LZ4G_writeLE32(table->buffer + 4, (unsigned)(table->size - 8));
+    return table->size;
+}
+
+typedef struct {
+    unsigned long long* cPos;   /* position of each block within the file; nbBlocks+1 entries, the last one ending the blocks */
+    unsigned long long* dPos;   /* decoded position of each block; nbBlocks+1 entries, the last one being the content size */
+    size_t nbBlocks;
+    size_t maxCSize;            /* largest block, size prefix included */
+    size_t maxDSize;            /* largest decoded block */
+    unsigned dictID;            /* dictionary ID of the frame header, 0 if none */
+    int blockChecksum;          /* blocks end with their checksum, as flagged by the frame header */
+} LZ4G_seekIndex_t;
+
+static void LZ4G_seekIndexFree(LZ4G_seekIndex_t* index)
+{
+    free(index->cPos);
+    free(index->dPos);
+    memset(index, 0, sizeof(*index));
+}
+
+/* LZ4G_seekIndexLoad() :
+ * reads the block index ending finput, and checks it against the frame header it refers to :
+ * an independent-block frame, whose block size bounds every entry (so that sizes also fit in an int).
+ * result : 0 on success, 1 if finput does not end with a valid block index, 2 on allocation failure, 3 on read error.
+ * LZ4G_seekIndexFree() must be called in all cases */
+static int LZ4G_seekIndexLoad(LZ4G_seekIndex_t* index, FILE* finput)
+{
+    unsigned char footer[LZ4G_SEEKFOOTER_SIZE];
+    unsigned char header[LZ4G_MAXHEADERFRAME_SIZE];
+    unsigned char entry[LZ4G_SEEKENTRY_SIZE];
+    unsigned long long tableSize, blocksSize = 0;
+    long long end, tableStart, blocksStart;
+    size_t n, headerSize, blockMax, cSizeMax;
+    unsigned FLG, BD;
+
+    memset(index, 0, sizeof(*index));
+    if (fseeko(finput, 0, SEEK_END)) return 3;
+    end = (long long)ftello(finput);
+    if (end < 8 + LZ4G_SEEKFOOTER_SIZE) return 1;
+    if (fseeko(finput, end - LZ4G_SEEKFOOTER_SIZE, SEEK_SET) || (fread(footer, 1, sizeof(footer), finput) != sizeof(footer))) return 3;
+    if (LZ4G_readLE32(footer + 6) != LZ4G_SEEKFOOTER_MAGIC) return 1;
+    index->nbBlocks = LZ4G_readLE32(footer);
+    headerSize = footer[4];
+    tableSize = 8 + (unsigned long long)index->nbBlocks * LZ4G_SEEKENTRY_SIZE + LZ4G_SEEKFOOTER_SIZE;
+    if (tableSize > (unsigned long long)end) return 1;
+    tableStart = end - (long long)tableSize;
+    if (fseeko(finput, tableStart, SEEK_SET) || (fread(header, 1, 8, finput) != 8)) return 3;
+    if ((LZ4G_readLE32(header) != LZ4G_SEEKTABLE_MAGIC) || (LZ4G_readLE32(header + 4) != tableSize - 8)) return 1;
+
+    /* Entries : sizes for now, bounded by the largest block size; positions below */
+    cSizeMax = 4 + (size_t)LZ4G_GetBlockSize_FromBlockId(maxBlockSizeID) + 4;   /* size prefix, raw block, block checksum */
+    index->cPos = (unsigned long long*)malloc((index->nbBlocks + 1) * sizeof(unsigned long long));
+    index->dPos = (unsigned long long*)malloc((index->nbBlocks + 1) * sizeof(unsigned long long));
+    if (!index->cPos || !index->dPos) return 2;
+    for (n=0; n<index->nbBlocks; n++)
+    {
+        if (fread(entry, 1, sizeof(entry), finput) != sizeof(entry)) return 3;
+        index->cPos[n+1] = LZ4G_readLE32(entry);
+        index->dPos[n+1] = LZ4G_readLE32(entry + 4);
+        if (index->cPos[n+1] > cSizeMax) return 1;
+        blocksSize += index->cPos[n+1];
+    }
+
+    /* Frame header : blocks end before the end mark and the content checksum */
+    blocksStart = tableStart - 4 - ((footer[5] & 1) ? 4 : 0) - (long long)blocksSize;
+    if ((blocksStart < (long long)headerSize) || (headerSize < 7) || (headerSize > LZ4G_MAXHEADERFRAME_SIZE)) return 1;   /* magic number included */
+    if (fseeko(finput, blocksStart - (long long)headerSize, SEEK_SET) || (fread(header, 1, headerSize, finput) != headerSize)) return 3;
+    FLG = header[4];
+    BD = header[5];
+    if (LZ4G_readLE32(header) != LZ4G_MAGICNUMBER) return 1;
+    if (((FLG >> 6) & _2BITS) != 1) return 1;                                             /* version */
+    if (!((FLG >> 5) & _1BIT)) return 1;                                                  /* independent blocks */
+    if (((FLG >> 2) & _1BIT) != (footer[5] & 1U)) return 1;                               /* content checksum */
+    if (headerSize != 7U + ((FLG & 0x08) ? 8U : 0U) + ((FLG & _1BIT) ? 4U : 0U)) return 1; /* content size, dictID */
+    if (header[headerSize-1] != ((XXH32(header + 4, headerSize - 5, 0) >> 8) & 0xFF)) return 1;   /* header checksum */
+    if (((BD >> 4) & _3BITS) < (unsigned)minBlockSizeID) return 1;                        /* block size */
+    LZ4G_getFrameDictID(header, headerSize, &index->dictID);
+    index->blockChecksum = (FLG >> 4) & _1BIT;
+    blockMax = (size_t)LZ4G_GetBlockSize_FromBlockId((BD >> 4) & _3BITS);
+
+    /* Entries : checked against the frame */
+    cSizeMax = 4 + blockMax + (index->blockChecksum ? 4 : 0);
+    index->cPos[0] = (unsigned long long)blocksStart;
+    index->dPos[0] = 0;
+    for (n=0; n<index->nbBlocks; n++)
+    {
+        size_t const cSize = (size_t)index->cPos[n+1];
+        size_t const dSize = (size_t)index->dPos[n+1];
+        if ((dSize == 0) || (dSize > blockMax)) return 1;
+        if ((cSize <= 4 + (index->blockChecksum ? 4 : 0)) || (cSize > cSizeMax)) return 1;
+        if (cSize > index->maxCSize) index->maxCSize = cSize;
+        if (dSize > index->maxDSize) index->maxDSize = dSize;
+        index->cPos[n+1] = index->cPos[n] + cSize;
+        index->dPos[n+1] = index->dPos[n] + dSize;
+    }
+    return 0;
+}
+
+/* LZ4G_seekBlockDecode() :
+ * decodes a whole block in, of cSize bytes (size prefix, and block checksum if blockChecksum, included),
+ * into dst, of dSize bytes, referencing dict if dictSize > 0. The block checksum is verified first.
+ * result : 0 on success, 1 if the block does not match its index entry, 2 if it is corrupted */
+static int LZ4G_seekBlockDecode(const unsigned char* in, size_t cSize, char* dst, size_t dSize, int blockChecksum, const void* dict, size_t dictSize)
+{
+    unsigned const prefix = LZ4G_readLE32(in);
+    size_t const dataSize = prefix & ~LZ4G_BLOCKUNCOMPRESSED_FLAG;
+    if (4 + dataSize + (blockChecksum ? 4 : 0) != cSize) return 1;
+    if (blockChecksum && (LZ4G_readLE32(in + 4 + dataSize) != XXH32(in + 4, dataSize, 0))) return 2;
+    if (prefix & LZ4G_BLOCKUNCOMPRESSED_FLAG)
+    {
+        if (dataSize != dSize) return 1;
+        memcpy(dst, in + 4, dSize);
+        return 0;
+    }
+    if (dictSize)
+    {
+        if (LZ4_decompress_safe_usingDict((const char*)in + 4, dst, (int)dataSize, (int)dSize, (const char*)dict, (int)dictSize) != (int)dSize) return 2;
+        return 0;
+    }
+    if (LZ4_decompress_safe((const char*)in + 4, dst, (int)dataSize, (int)dSize) != (int)dSize) return 2;
+    return 0;
+}
+
+/* LZ4G_seekFindBlock() : result : last block starting at or before offset */
+static size_t LZ4G_seekFindBlock(const LZ4G_seekIndex_t* index, unsigned long long offset)
+{
+    size_t low = 0, high = index->nbBlocks;
+    while (high - low > 1)
+    {
+        size_t const mid = (low + high) / 2;
+        if (index->dPos[mid] <= offset) low = mid; else high = mid;
+    }
+    return low;
+}
+
+int LZ4G_readRange(LZ4G_ctx* ctx, FILE* finput, unsigned long long offset, void* dst, size_t size, size_t* readSize,
+                   char** errstring, int* nerrbytes)
+{
+    LZ4G_seekIndex_t index;
+    size_t filled = 0;
+    size_t blockNb;
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    **errstring = '\0';
+    *readSize = 0;
+    switch (LZ4G_seekIndexLoad(&index, finput))
+    {
+    case 0: break;
+    case 1: errorNb = 90; errorMsg = "Seek error : input does not end with a block index"; goto _end;
+    case 2: errorNb = 91; errorMsg = "Allocation error : not enough memory"; goto _end;
+    default: errorNb = 92; errorMsg = "Read error : cannot read block index"; goto _end;
+    }
+    errorNb = LZ4G_checkDictID(ctx, index.dictID, errstring, nerrbytes);
+    if (errorNb) { LZ4G_seekIndexFree(&index); return errorNb; }
+    if (offset >= index.dPos[index.nbBlocks]) goto _end;   /* beyond content : nothing to read */
+    if (LZ4G_reserveBuffers(ctx, index.maxCSize, index.maxDSize)) { errorNb = 91; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+    for (blockNb = LZ4G_seekFindBlock(&index, offset); (filled < size) && (blockNb < index.nbBlocks); blockNb++)
+    {
+        size_t const cSize = (size_t)(index.cPos[blockNb+1] - index.cPos[blockNb]);
+        size_t const dSize = (size_t)(index.dPos[blockNb+1] - index.dPos[blockNb]);
+        size_t const skip = (size_t)(offset + filled - index.dPos[blockNb]);
+        size_t const copySize = (dSize - skip < size - filled) ? dSize - skip : size - filled;
+        char* const out = (char*)dst + filled;
+        char* const decoded = (copySize == dSize) ? out : (char*)ctx->outBuff;   /* whole blocks are decoded straight into dst */
+
+        if (fseeko(finput, (long long)index.cPos[blockNb], SEEK_SET) || (fread(ctx->inBuff, 1, cSize, finput) != cSize))
+            { errorNb = 92; errorMsg = "Read error : cannot read block"; goto _end; }
+        switch (LZ4G_seekBlockDecode((const unsigned char*)ctx->inBuff, cSize, decoded, dSize, index.blockChecksum, ctx->dict, ctx->dictSize))
+        {
+        case 0: break;
+        case 1: errorNb = 93; errorMsg = "Decompression error : block does not match index"; goto _end;
+        default: errorNb = 93; errorMsg = "Decompression error : corrupted block"; goto _end;
+        }
+        if (decoded != out) memcpy(out, decoded + skip, copySize);
+        filled += copySize;
+    }
+
+_end:
+    LZ4G_seekIndexFree(&index);
+    *readSize = filled;
+    if (errorNb) LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    return 0;
+}
+
+
+/***************************************
+*   Random-access reader
+***************************************/
+/* Decoded blocks are kept in a LRU list, bounded by the total size of blocks.
+ * The cache mutex protects the list; blocks are decoded outside of it, so that threads decode in parallel.
+ * Compressed blocks are read from a mapping of the whole file, or else through finput, one thread at a time. */
+#if LZ4G_MULTITHREAD
+#  define LZ4G_LOCK(mutex)   pthread_mutex_lock(mutex)
+#  define LZ4G_UNLOCK(mutex) pthread_mutex_unlock(mutex)
+#else
+#  define LZ4G_LOCK(mutex)
+#  define LZ4G_UNLOCK(mutex)
+#endif
+
+typedef struct LZ4G_cacheEntry_s {
+    struct LZ4G_cacheEntry_s* prev;   /* more recently used */
+    struct LZ4G_cacheEntry_s* next;   /* less recently used */
+    size_t blockNb;
+    /* decoded block follows */
+} LZ4G_cacheEntry_t;
+
+#define LZ4G_CACHEENTRY_DATA(entry) ((char*)((entry) + 1))
+
+struct LZ4G_reader_s
+{
+    LZ4G_seekIndex_t index;
+    FILE* finput;
+    const unsigned char* map;       /* file mapping; NULL when blocks are read through finput */
+    size_t mapSize;
+    unsigned char* inBuff;          /* compressed block, when read through finput */
+    LZ4G_cacheEntry_t** entries;    /* per block : its cache entry, or NULL */
+    LZ4G_cacheEntry_t* mru;
+    LZ4G_cacheEntry_t* lru;
+    size_t cacheSize;
+    size_t cacheUsed;
+    void*  dict;                    /* private copy of the dictionary (last 64 KB) */
+    size_t dictSize;
+#if LZ4G_MULTITHREAD
+    pthread_mutex_t cacheMutex;
+    pthread_mutex_t fileMutex;
+#endif
+};
+
+static size_t LZ4G_readerBlockSize(const LZ4G_reader* reader, size_t blockNb)
+{
+    return (size_t)(reader->index.dPos[blockNb+1] - reader->index.dPos[blockNb]);
+}
+
+static void LZ4G_cacheUnlink(LZ4G_reader* reader, LZ4G_cacheEntry_t* entry)
+{
+    if (entry->prev) entry->prev->next = entry->next; else reader->mru = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else reader->lru = entry->prev;
+}
+
+static void LZ4G_cachePushFront(LZ4G_reader* reader, LZ4G_cacheEntry_t* entry)
+{
+    entry->prev = NULL;
+    entry->next = reader->mru;
+    if (reader->mru) reader->mru->prev = entry; else reader->lru = entry;
+    reader->mru = entry;
+}
+
+/* LZ4G_cacheInsert() :
+ * entry becomes most recently used, evicting least recently used blocks beyond cacheSize.
+ * entry is freed instead when it does not fit, or when another thread has cached the same block meanwhile.
+ * Call with cacheMutex held */
+static void LZ4G_cacheInsert(LZ4G_reader* reader, LZ4G_cacheEntry_t* entry)
+{
+    size_t const size = LZ4G_readerBlockSize(reader, entry->blockNb);
+    if (reader->entries[entry->blockNb] || (size > reader->cacheSize)) { free(entry); return; }
+    reader->entries[entry->blockNb] = entry;
+    reader->cacheUsed += size;
+    LZ4G_cachePushFront(reader, entry);
+    while (reader->cacheUsed > reader->cacheSize)
+    {
+        LZ4G_cacheEntry_t* const evicted = reader->lru;
+        LZ4G_cacheUnlink(reader, evicted);
+        reader->entries[evicted->blockNb] = NULL;
+        reader->cacheUsed -= LZ4G_readerBlockSize(reader, evicted->blockNb);
+        free(evicted);
+    }
+}
+
+/* LZ4G_readerDecode() : decodes block blockNb into dst; result : as LZ4G_seekBlockDecode(), or 3 on read error */
+static int LZ4G_readerDecode(LZ4G_reader* reader, size_t blockNb, char* dst)
+{
+    unsigned long long const cPos = reader->index.cPos[blockNb];
+    size_t const cSize = (size_t)(reader->index.cPos[blockNb+1] - cPos);
+    size_t const dSize = LZ4G_readerBlockSize(reader, blockNb);
+    int result;
+
+    if (reader->map) return LZ4G_seekBlockDecode(reader->map + cPos, cSize, dst, dSize, reader->index.blockChecksum, reader->dict, reader->dictSize);
+    LZ4G_LOCK(&reader->fileMutex);
+    if (fseeko(reader->finput, (long long)cPos, SEEK_SET) || (fread(reader->inBuff, 1, cSize, reader->finput) != cSize))
+        result = 3;
+    else
+        result = LZ4G_seekBlockDecode(reader->inBuff, cSize, dst, dSize, reader->index.blockChecksum, reader->dict, reader->dictSize);
+    LZ4G_UNLOCK(&reader->fileMutex);
+    return result;
+}
+
+int LZ4G_createReader(LZ4G_reader** readerPtr, FILE* finput, size_t cacheSize, char** errstring, int* nerrbytes)
+{
+    LZ4G_reader* const reader = (LZ4G_reader*)calloc(1, sizeof(LZ4G_reader));
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    **errstring = '\0';
+    *readerPtr = NULL;
+    if (reader == NULL) LZ4G_RETURN_ERROR(91, "Allocation error : not enough memory");
+#if LZ4G_MULTITHREAD
+    pthread_mutex_init(&reader->cacheMutex, NULL);
+    pthread_mutex_init(&reader->fileMutex, NULL);
+#endif
+    reader->finput = finput;
+    reader->cacheSize = cacheSize;
+    switch (LZ4G_seekIndexLoad(&reader->index, finput))
+    {
+    case 0: break;
+    case 1: errorNb = 90; errorMsg = "Seek error : input does not end with a block index"; goto _end;
+    case 2: errorNb = 91; errorMsg = "Allocation error : not enough memory"; goto _end;
+    default: errorNb = 92; errorMsg = "Read error : cannot read block index"; goto _end;
+    }
+    reader->entries = (LZ4G_cacheEntry_t**)calloc(reader->index.nbBlocks + 1, sizeof(LZ4G_cacheEntry_t*));
+    if (reader->entries == NULL) { errorNb = 91; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+#if LZ4G_FDAPI
+    /* Blocks are read from a mapping when possible : threads then read concurrently, without copy */
+    if (reader->index.cPos[reader->index.nbBlocks] <= (size_t)-1)
+    {
+        size_t const mapSize = (size_t)reader->index.cPos[reader->index.nbBlocks];   /* up to the end of blocks */
+        void* const base = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fileno(finput), 0);
+        if (base != MAP_FAILED)
+        {
+            posix_madvise(base, mapSize, POSIX_MADV_RANDOM);
+            reader->map = (const unsigned char*)base;
+            reader->mapSize = mapSize;
+        }
+    }
+#endif
+    if (reader->map == NULL)
+    {
+        reader->inBuff = (unsigned char*)malloc(reader->index.maxCSize + 1);
+        if (reader->inBuff == NULL) { errorNb = 91; errorMsg = "Allocation error : not enough memory"; goto _end; }
+    }
+
+_end:
+    if (errorNb)
+    {
+        LZ4G_freeReader(reader);
+        LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    }
+    *readerPtr = reader;
+    return 0;
+}
+
+void LZ4G_freeReader(LZ4G_reader* reader)
+{
+    if (reader == NULL) return;
+    while (reader->mru)
+    {
+        LZ4G_cacheEntry_t* const entry = reader->mru;
+        reader->mru = entry->next;
+        free(entry);
+    }
+#if LZ4G_FDAPI
+    if (reader->map) munmap((void*)reader->map, reader->mapSize);
+#endif
+#if LZ4G_MULTITHREAD
+    pthread_mutex_destroy(&reader->cacheMutex);
+    pthread_mutex_destroy(&reader->fileMutex);
+#endif
+    LZ4G_seekIndexFree(&reader->index);
+    free(reader->entries);
+    free(reader->inBuff);
+    free(reader->dict);
+    free(reader);
+}
+
+int LZ4G_readerLoadDictionary(LZ4G_reader* reader, const void* dict, size_t dictSize)
+{
+    free(reader->dict);
+    reader->dict = NULL;
+    reader->dictSize = 0;
+    if ((dict == NULL) || (dictSize == 0)) return 0;
+    if (dictSize > LZ4G_DICT_MAXSIZE) { dict = (const char*)dict + (dictSize - LZ4G_DICT_MAXSIZE); dictSize = LZ4G_DICT_MAXSIZE; }
+    reader->dict = malloc(dictSize);
+    if (reader->dict == NULL) return -1;
+    memcpy(reader->dict, dict, dictSize);
+    reader->dictSize = dictSize;
+    return 0;
+}
+
+unsigned long long LZ4G_readerContentSize(const LZ4G_reader* reader)
+{
+    return reader->index.dPos[reader->index.nbBlocks];
+}
+
+int LZ4G_readerRead(LZ4G_reader* reader, unsigned long long offset, void* dst, size_t size, size_t* readSize,
+                    char** errstring, int* nerrbytes)
+{
+    size_t const nbBlocks = reader->index.nbBlocks;
+    size_t filled = 0;
+    size_t blockNb;
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    **errstring = '\0';
+    *readSize = 0;
+    if (reader->index.dictID && !reader->dictSize) LZ4G_RETURN_ERROR_DOTS(64, "Dictionary error : frame requires dictionary %u", reader->index.dictID);
+    if (offset >= reader->index.dPos[nbBlocks]) return 0;   /* beyond content : nothing to read */
+
+    for (blockNb = LZ4G_seekFindBlock(&reader->index, offset); (filled < size) && (blockNb < nbBlocks); blockNb++)
+    {
+        size_t const dSize = LZ4G_readerBlockSize(reader, blockNb);
+        size_t const skip = (size_t)(offset + filled - reader->index.dPos[blockNb]);
+        size_t const copySize = (dSize - skip < size - filled) ? dSize - skip : size - filled;
+        char* const out = (char*)dst + filled;
+        LZ4G_cacheEntry_t* entry;
+
+        /* Cached block */
+        LZ4G_LOCK(&reader->cacheMutex);
+        entry = reader->entries[blockNb];
+        if (entry)
+        {
+            LZ4G_cacheUnlink(reader, entry);
+            LZ4G_cachePushFront(reader, entry);
+            memcpy(out, LZ4G_CACHEENTRY_DATA(entry) + skip, copySize);
+        }
+        LZ4G_UNLOCK(&reader->cacheMutex);
+        if (entry) { filled += copySize; continue; }
+
+        /* Decode it into a new entry, then cache it */
+        entry = (LZ4G_cacheEntry_t*)malloc(sizeof(LZ4G_cacheEntry_t) + dSize);
+        if (entry == NULL) { errorNb = 91; errorMsg = "Allocation error : not enough memory"; break; }
+        entry->blockNb = blockNb;
+        switch (LZ4G_readerDecode(reader, blockNb, LZ4G_CACHEENTRY_DATA(entry)))
+        {
+        case 0: break;
+        case 1: errorNb = 93; errorMsg = "Decompression error : block does not match index"; break;
+        case 2: errorNb = 93; errorMsg = "Decompression error : corrupted block"; break;
+        default: errorNb = 92; errorMsg = "Read error : cannot read block"; break;
+        }
+        if (errorNb) { free(entry); break; }
+        memcpy(out, LZ4G_CACHEENTRY_DATA(entry) + skip, copySize);
+        filled += copySize;
+        LZ4G_LOCK(&reader->cacheMutex);
+        LZ4G_cacheInsert(reader, entry);
+        LZ4G_UNLOCK(&reader->cacheMutex);
+    }
+
+    *readSize = filled;
+    if (errorNb) LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    return 0;
+}
+
+
+/***************************************
+*   Multi-threading
+***************************************/
+#if LZ4G_MULTITHREAD
+
+/* Block jobs are filled in order by the calling thread, processed by worker threads,
+ * and consumed back in order by the calling thread, from a ring of 2*nbThreads slots */
+
+typedef struct {
+    char*  inBuff;
+    char*  outBuff;
+    size_t inSize;
+    size_t outSize;
+    int    uncompressed;   /* decoder : stored block, result is within inBuff */
+    int    error;          /* decoder : corrupted block (1), or block checksum mismatch (2) */
+    int    zeroed;         /* compressor : inBuff holds a block of zeroes, from a hole of a sparse input */
+    const char* preBuilt;  /* compressor : compressed block (outSize bytes) to copy instead of compressing inBuff */
+    int    done;
+} LZ4G_blockJob_t;
+
+struct LZ4G_mtCtx_s;
+typedef void (*LZ4G_jobFunction_t)(LZ4G_blockJob_t* job, void* state, const struct LZ4G_mtCtx_s* mt);
+
+typedef struct {
+    struct LZ4G_mtCtx_s* mt;
+    void* state;
+} LZ4G_worker_t;
+
+typedef struct LZ4G_mtCtx_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t  jobReady;       /* calling thread -> workers */
+    pthread_cond_t  jobDone;        /* workers -> calling thread */
+    LZ4G_jobFunction_t jobFunction;
+    LZ4G_blockJob_t* jobs;
+    unsigned nbJobs;
+    unsigned long long nbFilled;    /* jobs published by the calling thread */
+    unsigned long long nbStarted;   /* jobs claimed by workers */
+    unsigned long long nbConsumed;  /* jobs consumed by the calling thread (only accessed by it) */
+    size_t blockSize;
+    unsigned compressionLevel;
+    int blockChecksum;              /* blocks end with their checksum, computed or verified by workers */
+    const char* dict;               /* decoder : dictionary referenced by each block, if dictSize > 0 */
+    size_t dictSize;
+    const void* dictStream;         /* compressor : stream loaded with the dictionary, copied before each block, or NULL */
+    int nbThreads;
+    int nbRunning;
+    int quit;
+    LZ4G_worker_t workers[LZ4G_NBTHREADS_MAX];
+    pthread_t threads[LZ4G_NBTHREADS_MAX];
+} LZ4G_mtCtx_t;
+
+static void* LZ4G_worker(void* arg)
+{
+    LZ4G_worker_t* const worker = (LZ4G_worker_t*)arg;
+    LZ4G_mtCtx_t* const mt = worker->mt;
+
+    for (;;)
+    {
+        LZ4G_blockJob_t* job;
+
+        pthread_mutex_lock(&mt->mutex);
+        while ((mt->nbStarted == mt->nbFilled) && !mt->quit) pthread_cond_wait(&mt->jobReady, &mt->mutex);
+        if (mt->nbStarted == mt->nbFilled) { pthread_mutex_unlock(&mt->mutex); break; }   /* quit, and nothing left to do */
+        job = mt->jobs + (mt->nbStarted % mt->nbJobs);
+        mt->nbStarted++;
+        pthread_mutex_unlock(&mt->mutex);
+
+        mt->jobFunction(job, worker->state, mt);
+
+        pthread_mutex_lock(&mt->mutex);
+        job->done = 1;
+        pthread_cond_signal(&mt->jobDone);
+        pthread_mutex_unlock(&mt->mutex);
+    }
+    return NULL;
+}
+
+static void LZ4G_mtFree(LZ4G_mtCtx_t* mt)
+{
+    int i;
+
+    /* Stop workers (pending jobs are completed first) */
+    pthread_mutex_lock(&mt->mutex);
+    mt->quit = 1;
+    pthread_cond_broadcast(&mt->jobReady);
+    pthread_mutex_unlock(&mt->mutex);
+    for (i=0; i<mt->nbRunning; i++) pthread_join(mt->threads[i], NULL);
+
+    /* Free */
+    for (i=0; i<mt->nbThreads; i++) free(mt->workers[i].state);
+    if (mt->jobs)
+        for (i=0; i<(int)mt->nbJobs; i++) { free(mt->jobs[i].inBuff); free(mt->jobs[i].outBuff); }
+    free(mt->jobs);
+    pthread_cond_destroy(&mt->jobDone);
+    pthread_cond_destroy(&mt->jobReady);
+    pthread_mutex_destroy(&mt->mutex);
+}
+
+/* LZ4G_mtCreate() :
+ * result : 0 on success, 1 on allocation failure, 2 if threads cannot be started.
+ * LZ4G_mtFree() must be called in all cases */
+static int LZ4G_mtCreate(LZ4G_mtCtx_t* mt, int nbThreads, size_t inBuffSize, size_t outBuffSize, size_t stateSize, LZ4G_jobFunction_t jobFunction)
+{
+    int i;
+
+    memset(mt, 0, sizeof(*mt));
+    pthread_mutex_init(&mt->mutex, NULL);
+    pthread_cond_init(&mt->jobReady, NULL);
+    pthread_cond_init(&mt->jobDone, NULL);
+    mt->jobFunction = jobFunction;
+    mt->nbThreads = nbThreads;
+    mt->nbJobs = 2 * (unsigned)nbThreads;
+
+    /* Allocate Memory */
+    mt->jobs = (LZ4G_blockJob_t*)calloc(mt->nbJobs, sizeof(LZ4G_blockJob_t));
+    if (!mt->jobs) return 1;
+    for (i=0; i<(int)mt->nbJobs; i++)
+    {
+        mt->jobs[i].inBuff  = (char*)malloc(inBuffSize);
+        mt->jobs[i].outBuff = outBuffSize ? (char*)malloc(outBuffSize) : NULL;
+        if (!mt->jobs[i].inBuff || (outBuffSize && !mt->jobs[i].outBuff)) return 1;
+    }
+    for (i=0; i<nbThreads; i++)
+    {
+        mt->workers[i].mt = mt;
+        mt->workers[i].state = stateSize ? calloc(1, stateSize) : NULL;   /* zeroed : HC streams start with a full reset */
+        if (stateSize && !mt->workers[i].state) return 1;
+    }
+
+    /* Start workers */
+    for (mt->nbRunning=0; mt->nbRunning<nbThreads; mt->nbRunning++)
+        if (pthread_create(mt->threads + mt->nbRunning, NULL, LZ4G_worker, mt->workers + mt->nbRunning)) return 2;
+
+    return 0;
+}
+
+/* LZ4G_mtNextFree() : slot to fill, or NULL if all slots are in flight */
+static LZ4G_blockJob_t* LZ4G_mtNextFree(LZ4G_mtCtx_t* mt)
+{
+    if (mt->nbFilled - mt->nbConsumed >= mt->nbJobs) return NULL;
+    return mt->jobs + (mt->nbFilled % mt->nbJobs);
+}
+
+/* LZ4G_mtPush() : publishes the slot given by LZ4G_mtNextFree() to workers */
+static void LZ4G_mtPush(LZ4G_mtCtx_t* mt)
+{
+    mt->jobs[mt->nbFilled % mt->nbJobs].done = 0;
+    pthread_mutex_lock(&mt->mutex);
+    mt->nbFilled++;
+    pthread_cond_signal(&mt->jobReady);
+    pthread_mutex_unlock(&mt->mutex);
+}
+
+/* LZ4G_mtWaitOldest() : waits for the oldest published job; release it by incrementing nbConsumed */
+static LZ4G_blockJob_t* LZ4G_mtWaitOldest(LZ4G_mtCtx_t* mt)
+{
+    LZ4G_blockJob_t* const job = mt->jobs + (mt->nbConsumed % mt->nbJobs);
+    pthread_mutex_lock(&mt->mutex);
+    while (!job->done) pthread_cond_wait(&mt->jobDone, &mt->mutex);
+    pthread_mutex_unlock(&mt->mutex);
+    return job;
+}
+
+
+/* LZ4G_compressBlock() :
+ * mirrors LZ4F_compressBlock(), using the same block compressors as LZ4F_selectCompression() in independent mode,
+ * so that blocks compressed in parallel are byte-identical to those produced by LZ4F_compressUpdate().
+ * With a dictionary, state is a stream, starting each block from a copy of dictStream, as LZ4F_initStream() does */
+static size_t LZ4G_compressBlock(void* dst, const void* src, size_t srcSize, void* state, unsigned level, const void* dictStream, int blockChecksum)
+{
+    unsigned char* const cSizePtr = (unsigned char*)dst;
+    unsigned cSize;
+    if (dictStream && (level < LZ4G_MINHCLEVEL))
+    {
+        memcpy(state, dictStream, sizeof(LZ4_stream_t));
+        cSize = (unsigned)LZ4_compress_limitedOutput_continue((LZ4_stream_t*)state, (const char*)src, (char*)(cSizePtr+4), (int)srcSize, (int)srcSize-1);
+    }
+    else if (dictStream)
+    {
+        memcpy(state, dictStream, sizeof(LZ4_streamHC_t));
+        cSize = (unsigned)LZ4_compressHC_limitedOutput_continue((LZ4_streamHC_t*)state, (const char*)src, (char*)(cSizePtr+4), (int)srcSize, (int)srcSize-1);
+    }
+    else if (level < LZ4G_MINHCLEVEL)
+        cSize = (unsigned)LZ4_compress_limitedOutput_withState(state, (const char*)src, (char*)(cSizePtr+4), (int)srcSize, (int)srcSize-1);
+    else
+    {
+        LZ4_resetStreamHC_fast((LZ4_streamHC_t*)state, (int)level);
+        cSize = (unsigned)LZ4_compressHC_limitedOutput_continue((LZ4_streamHC_t*)state, (const char*)src, (char*)(cSizePtr+4), (int)srcSize, (int)srcSize-1);
+    }
+    LZ4G_writeLE32(cSizePtr, cSize);
+    if (cSize == 0)   /* compression failed : store block uncompressed */
+    {
+        cSize = (unsigned)srcSize;
+        LZ4G_writeLE32(cSizePtr, cSize + LZ4G_BLOCKUNCOMPRESSED_FLAG);
+        memcpy(cSizePtr+4, src, srcSize);
+    }
+    if (blockChecksum)
+    {
+        LZ4G_writeLE32(cSizePtr+4+cSize, XXH32(cSizePtr+4, cSize, 0));
+        return cSize + 8;
+    }
+    return cSize + 4;
+}
+
+static void LZ4G_compressJob(LZ4G_blockJob_t* job, void* state, const LZ4G_mtCtx_t* mt)
+{
+    if (job->preBuilt) { memcpy(job->outBuff, job->preBuilt, job->outSize); return; }
+    job->outSize = LZ4G_compressBlock(job->outBuff, job->inBuff, job->inSize, state, mt->compressionLevel, mt->dictStream, mt->blockChecksum);
+}
+
+/* LZ4G_decompressJob() :
+ * with block checksums, job->inSize includes the checksum, which is verified before decoding */
+static void LZ4G_decompressJob(LZ4G_blockJob_t* job, void* state, const LZ4G_mtCtx_t* mt)
+{
+    int decodedSize;
+    (void)state;
+    if (mt->blockChecksum)
+    {
+        job->inSize -= 4;
+        if (LZ4G_readLE32(job->inBuff + job->inSize) != XXH32(job->inBuff, job->inSize, 0)) { job->error = 2; job->outSize = 0; return; }
+    }
+    if (job->uncompressed) { job->outSize = job->inSize; return; }
+    if (mt->dictSize)
+        decodedSize = LZ4_decompress_safe_usingDict(job->inBuff, job->outBuff, (int)job->inSize, (int)mt->blockSize, mt->dict, (int)mt->dictSize);
+    else
+        decodedSize = LZ4_decompress_safe(job->inBuff, job->outBuff, (int)job->inSize, (int)mt->blockSize);
+    job->error = (decodedSize < 0);
+    job->outSize = job->error ? 0 : (size_t)decodedSize;
+}
+
+
+/* LZ4G_compressIo_MT() :
+ * Blocks are read by the calling thread, compressed (and their checksum computed) by nbThreads workers,
+ * and written back in order by the calling thread, which also maintains the frame checksum.
+ * Blocks within holes of io->holeInput are not read : once a block of zeroes has been compressed,
+ * workers copy it for the next ones. Blocks are indexed into seekTable when not NULL.
+ * Each block references dict, if dictSize > 0. Only valid for independent blocks. */
+static int LZ4G_compressIo_MT(const LZ4G_io_t* io, LZ4F_compressionContext_t ctx, const LZ4F_preferences_t* prefs, int nbThreads,
+                              const void* dict, size_t dictSize, LZ4G_seekTable_t* seekTable, char** errstring, int* nerrbytes)
+{
+    const size_t blockSize = (size_t)LZ4G_GetBlockSize_FromBlockId(prefs->frameInfo.blockSizeID);
+    const int checksum = (prefs->frameInfo.contentChecksumFlag == contentChecksumEnabled);
+    const size_t stateSize = (prefs->compressionLevel < LZ4G_MINHCLEVEL) ? sizeof(LZ4_stream_t) : sizeof(LZ4_streamHC_t);   /* also fits streams */
+    unsigned char header[LZ4G_MAXHEADERFRAME_SIZE];
+    LZ4G_mtCtx_t mt;
+    XXH32_state_t xxh;
+    unsigned long long filesize = 0;
+    unsigned long long dataEnd = 0;
+    char* zeroBlock = NULL;   /* compressed block of zeroes */
+    size_t zeroBlockSize = 0;
+    void* dictStream = NULL;
+    size_t sizeCheck, headerSize, frameHeaderSize;
+    int eof = 0;
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    /* Init */
+    XXH32_reset(&xxh, 0);
+    switch (LZ4G_mtCreate(&mt, nbThreads, blockSize, LZ4_COMPRESSBOUND(blockSize) + 8, stateSize, LZ4G_compressJob))   /* +8 : block size, block checksum */
+    {
+    case 0: break;
+    case 1: errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end;
+    default: errorNb = 30; errorMsg = "Thread creation failed"; goto _end;
+    }
+    mt.compressionLevel = prefs->compressionLevel;
+    mt.blockChecksum = (prefs->frameInfo.blockChecksumFlag == blockChecksumEnabled);
+    if (dictSize)
+    {   /* dictionary is loaded once, then copied by workers */
+        dictStream = malloc(stateSize);
+        if (dictStream == NULL) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+        if (prefs->compressionLevel < LZ4G_MINHCLEVEL)
+        {
+            LZ4_resetStream((LZ4_stream_t*)dictStream);
+            LZ4_loadDict((LZ4_stream_t*)dictStream, (const char*)dict, (int)dictSize);
+        }
+        else
+        {
+            LZ4_resetStreamHC((LZ4_streamHC_t*)dictStream, prefs->compressionLevel);
+            LZ4_loadDictHC((LZ4_streamHC_t*)dictStream, (const char*)dict, (int)dictSize);
+        }
+        mt.dictStream = dictStream;
+    }
+
+    /* Write Archive Header */
+    headerSize = LZ4F_compressBegin_usingDict(ctx, header, sizeof(header), dict, dictSize, prefs);
+    if (LZ4F_isError(headerSize)) { errorNb = 32; errorMsg = LZ4F_getErrorName(headerSize); goto _end; }
+    sizeCheck = io->write(io->writeOpaque, header, headerSize);
+    if (sizeCheck!=headerSize) { errorNb = 33; errorMsg = "Write error : cannot write header"; goto _end; }
+    frameHeaderSize = headerSize;
+    if (LZ4G_seekTableStart(seekTable)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+    /* Main Loop : fill free slots first, then write back the oldest block */
+    while (!eof || (mt.nbConsumed < mt.nbFilled))
+    {
+        LZ4G_blockJob_t* job = eof ? NULL : LZ4G_mtNextFree(&mt);
+        if (job)
+        {
+            size_t readSize = blockSize;
+            if (io->holeInput && LZ4G_skipHole(io->holeInput, blockSize, &dataEnd))
+            {
+                if (!job->zeroed) { memset(job->inBuff, 0, blockSize); job->zeroed = 1; }
+            }
+            else
+            {
+                job->zeroed = 0;
+                readSize = LZ4G_readFull(io, job->inBuff, blockSize);
+                if (readSize == LZ4G_READ_ERROR) { errorNb = 38; errorMsg = "Read error : cannot read input"; goto _end; }
+                if (readSize == 0) { eof = 1; continue; }
+            }
+            filesize += readSize;
+            job->inSize = readSize;
+            job->preBuilt = job->zeroed ? zeroBlock : NULL;
+            job->outSize = zeroBlockSize;
+            LZ4G_mtPush(&mt);
+            continue;
+        }
+
+        job = LZ4G_mtWaitOldest(&mt);
+        if (checksum) XXH32_update(&xxh, job->inBuff, job->inSize);
+        if (job->zeroed && (zeroBlock == NULL))
+        {
+            zeroBlock = (char*)malloc(job->outSize);   /* on failure, blocks of zeroes remain compressed */
+            if (zeroBlock) { memcpy(zeroBlock, job->outBuff, job->outSize); zeroBlockSize = job->outSize; }
+        }
+        sizeCheck = io->write(io->writeOpaque, job->outBuff, job->outSize);
+        if (sizeCheck!=job->outSize) { errorNb = 35; errorMsg = "Write error : cannot write compressed block"; goto _end; }
+        if (LZ4G_seekTableAdd(seekTable, job->outSize, job->inSize)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+        mt.nbConsumed++;
+    }
+
+    /* End of Stream mark */
+    LZ4G_writeLE32(header, 0);
+    headerSize = 4;
+    if (checksum) { LZ4G_writeLE32(header+4, XXH32_digest(&xxh)); headerSize += 4; }
+    if ((prefs->frameInfo.contentSize) && (prefs->frameInfo.contentSize != filesize))
+        { errorNb = 36; errorMsg = "Frame content size does not match input size"; goto _end; }
+    sizeCheck = io->write(io->writeOpaque, header, headerSize);
+    if (sizeCheck!=headerSize) { errorNb = 37; errorMsg = "Write error : cannot write end of stream"; goto _end; }
+
+    /* Block index */
+    headerSize = LZ4G_seekTableFinish(seekTable, frameHeaderSize, checksum);
+    if (headerSize && (io->write(io->writeOpaque, seekTable->buffer, headerSize) != headerSize))
+        { errorNb = 39; errorMsg = "Write error : cannot write block index"; goto _end; }
+
+_end:
+    LZ4G_mtFree(&mt);
+    free(zeroBlock);
+    free(dictStream);
+    if (errorNb) LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    return 0;
+}
+
+
+/* LZ4G_decodeLZ4S_MT() :
+ * Blocks are read by the calling thread, using their size prefix, verified against their checksum and decoded by nbThreads workers,
+ * and written back in order by the calling thread, which also verifies the frame checksum.
+ * A corrupted block is reported before it is written, without reading the rest of the frame.
+ * Blocks reference dict, if dictSize > 0. Only valid for independent blocks. The frame header must already be consumed from finput.
+ * Contrary to the serial decoder, reading stops exactly at the end of the frame. */
+static int LZ4G_decodeLZ4S_MT(FILE* finput, FILE* foutput, const LZ4F_frameInfo_t* frameInfo, const void* dict, size_t dictSize, int nbThreads, int sparseMode, unsigned long long* ret, char** errstring, int* nerrbytes)
+{
+    const size_t blockSize = (size_t)LZ4G_GetBlockSize_FromBlockId(frameInfo->blockSizeID);
+    const int checksum = (frameInfo->contentChecksumFlag == contentChecksumEnabled);
+    LZ4G_mtCtx_t mt;
+    XXH32_state_t xxh;
+    unsigned long long filesize = 0;
+    unsigned long long storedSkips = 0;
+    unsigned char U32store[4];
+    size_t sizeCheck;
+    int endMark = 0;
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    /* Init */
+    XXH32_reset(&xxh, 0);
+    switch (LZ4G_mtCreate(&mt, nbThreads, blockSize + 4, blockSize, 0, LZ4G_decompressJob))   /* +4 : block checksum */
+    {
+    case 0: break;
+    case 1: errorNb = 61; errorMsg = "Allocation error : not enough memory"; goto _end;
+    default: errorNb = 60; errorMsg = "Thread creation failed"; goto _end;
+    }
+    mt.blockSize = blockSize;
+    mt.blockChecksum = (frameInfo->blockChecksumFlag == blockChecksumEnabled);
+    mt.dict = (const char*)dict;
+    mt.dictSize = dictSize;
+
+    /* Main Loop : read ahead as many blocks as slots allow, then write back the oldest one */
+    while (!endMark || (mt.nbConsumed < mt.nbFilled))
+    {
+        LZ4G_blockJob_t* job = endMark ? NULL : LZ4G_mtNextFree(&mt);
+        if (job)
+        {
+            unsigned cSize;
+            sizeCheck = fread(U32store, 1, 4, finput);
+            if (sizeCheck != 4) { errorNb = 63; errorMsg = "Read error : cannot access block size"; goto _end; }
+            cSize = LZ4G_readLE32(U32store);
+            if (cSize == 0) { endMark = 1; continue; }
+            job->uncompressed = ((cSize & LZ4G_BLOCKUNCOMPRESSED_FLAG) != 0);
+            cSize &= ~LZ4G_BLOCKUNCOMPRESSED_FLAG;
+            if (cSize > blockSize) { errorNb = 63; errorMsg = "Corrupted block size"; goto _end; }
+            if (mt.blockChecksum) cSize += 4;   /* read along with the block */
+            sizeCheck = fread(job->inBuff, 1, cSize, finput);
+            if (sizeCheck != cSize) { errorNb = 63; errorMsg = "Read error : cannot access compressed block"; goto _end; }
+            job->inSize = cSize;
+            job->error = 0;
+            LZ4G_mtPush(&mt);
+            continue;
+        }
+
+        job = LZ4G_mtWaitOldest(&mt);
+        if (job->error == 2) { errorNb = 66; errorMsg = "Decompression error : block checksum invalid"; goto _end; }
+        if (job->error) { errorNb = 66; errorMsg = "Decompression error : corrupted block"; goto _end; }
+        {
+            const char* const decoded = job->uncompressed ? job->inBuff : job->outBuff;
+            if (checksum) XXH32_update(&xxh, decoded, job->outSize);
+            filesize += job->outSize;
+            errorNb = LZ4G_fwriteSparse(sparseMode, foutput, decoded, job->outSize, &storedSkips, errstring, nerrbytes);
+            if (errorNb) { LZ4G_mtFree(&mt); return errorNb; }
+        }
+        mt.nbConsumed++;
+    }
+    if ((frameInfo->contentSize) && (frameInfo->contentSize != filesize)) { errorNb = 66; errorMsg = "Decompression error : frame content size mismatch"; goto _end; }
+
+    /* Frame checksum */
+    if (checksum)
+    {
+        sizeCheck = fread(U32store, 1, 4, finput);
+        if (sizeCheck != 4) { errorNb = 63; errorMsg = "Read error : cannot access frame checksum"; goto _end; }
+        if (LZ4G_readLE32(U32store) != XXH32_digest(&xxh)) { errorNb = 66; errorMsg = "Decompression error : checksum invalid"; goto _end; }
+    }
+
+_end:
+    LZ4G_mtFree(&mt);
+    if (errorNb) LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    errorNb = LZ4G_fwriteSparseEnd(sparseMode, foutput, storedSkips, errstring, nerrbytes);
+    if (errorNb) return errorNb;
+    *ret = filesize;
+    return 0;
+}
+
+/* Asynchronous I/O pipeline :
+ * a reader thread reads input blocks ahead, and a writer thread writes compressed blocks behind,
+ * while the calling thread compresses, so that I/O overlaps compression, even with linked blocks.
+ * Each ring of LZ4G_PIPE_SLOTS buffers is a bounded queue between 2 threads. */
+
+#define LZ4G_PIPE_SLOTS 3
+#define LZ4G_PIPE_END ((size_t)-1)   /* output slot size marking the end of the stream */
+
+typedef struct {
+    char*  buff[LZ4G_PIPE_SLOTS];
+    size_t size[LZ4G_PIPE_SLOTS];
+    unsigned long long nbPushed;   /* slots filled by the producer */
+    unsigned long long nbPopped;   /* slots released by the consumer */
+} LZ4G_ring_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  changed;       /* a ring moved, or reading must stop */
+    const LZ4G_io_t* io;
+    size_t blockSize;
+    LZ4G_ring_t in;                /* reader thread -> calling thread */
+    LZ4G_ring_t out;               /* calling thread -> writer thread */
+    int readError;
+    int writeError;
+    int stop;                      /* calling thread -> reader thread */
+} LZ4G_pipe_t;
+
+static void* LZ4G_pipeReader(void* arg)
+{
+    LZ4G_pipe_t* const pipe = (LZ4G_pipe_t*)arg;
+    for (;;)
+    {
+        unsigned slot;
+        size_t readSize;
+
+        pthread_mutex_lock(&pipe->mutex);
+        while ((pipe->in.nbPushed - pipe->in.nbPopped >= LZ4G_PIPE_SLOTS) && !pipe->stop) pthread_cond_wait(&pipe->changed, &pipe->mutex);
+        if (pipe->stop) { pthread_mutex_unlock(&pipe->mutex); break; }
+        slot = (unsigned)(pipe->in.nbPushed % LZ4G_PIPE_SLOTS);
+        pthread_mutex_unlock(&pipe->mutex);
+
+        readSize = LZ4G_readFull(pipe->io, pipe->in.buff[slot], pipe->blockSize);
+
+        pthread_mutex_lock(&pipe->mutex);
+        if (readSize == LZ4G_READ_ERROR) { pipe->readError = 1; readSize = 0; }
+        pipe->in.size[slot] = readSize;
+        pipe->in.nbPushed++;
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->mutex);
+        if (readSize == 0) break;   /* end of input : last slot is empty */
+    }
+    return NULL;
+}
+
+static void* LZ4G_pipeWriter(void* arg)
+{
+    LZ4G_pipe_t* const pipe = (LZ4G_pipe_t*)arg;
+    int failed = 0;
+    for (;;)
+    {
+        unsigned slot;
+        size_t size;
+
+        pthread_mutex_lock(&pipe->mutex);
+        while (pipe->out.nbPushed == pipe->out.nbPopped) pthread_cond_wait(&pipe->changed, &pipe->mutex);
+        slot = (unsigned)(pipe->out.nbPopped % LZ4G_PIPE_SLOTS);
+        size = pipe->out.size[slot];
+        pthread_mutex_unlock(&pipe->mutex);
+        if (size == LZ4G_PIPE_END) break;
+
+        if (!failed) failed = (pipe->io->write(pipe->io->writeOpaque, pipe->out.buff[slot], size) != size);   /* after a failure, slots are just released */
+
+        pthread_mutex_lock(&pipe->mutex);
+        pipe->writeError = failed;
+        pipe->out.nbPopped++;
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->mutex);
+    }
+    return NULL;
+}
+
+/* LZ4G_pipeNextOut() : waits for a free output slot */
+static char* LZ4G_pipeNextOut(LZ4G_pipe_t* pipe)
+{
+    pthread_mutex_lock(&pipe->mutex);
+    while (pipe->out.nbPushed - pipe->out.nbPopped >= LZ4G_PIPE_SLOTS) pthread_cond_wait(&pipe->changed, &pipe->mutex);
+    pthread_mutex_unlock(&pipe->mutex);
+    return pipe->out.buff[pipe->out.nbPushed % LZ4G_PIPE_SLOTS];
+}
+
+/* LZ4G_pipePushOut() : hands the slot given by LZ4G_pipeNextOut() over to the writer thread */
+static void LZ4G_pipePushOut(LZ4G_pipe_t* pipe, size_t size)
+{
+    pthread_mutex_lock(&pipe->mutex);
+    pipe->out.size[pipe->out.nbPushed % LZ4G_PIPE_SLOTS] = size;
+    pipe->out.nbPushed++;
+    pthread_cond_broadcast(&pipe->changed);
+    pthread_mutex_unlock(&pipe->mutex);
+}
+
+/* LZ4G_compressIo_async() :
+ * same frame as the serial loop of LZ4G_compressIo(), with I/O in the pipeline threads.
+ * inBuff provides LZ4G_PIPE_SLOTS blocks, outBuff LZ4G_PIPE_SLOTS slots of outSlotSize bytes.
+ * readFunction and writeFunction are each called from a single thread, which is not the calling one.
+ * Blocks are indexed into seekTable when not NULL. Blocks reference cdict, when not NULL. */
+static int LZ4G_compressIo_async(const LZ4G_io_t* io, LZ4F_compressionContext_t ctx, const LZ4F_preferences_t* prefs, const LZ4F_CDict* cdict,
+                                 char* inBuff, char* outBuff, size_t outSlotSize, LZ4G_seekTable_t* seekTable, char** errstring, int* nerrbytes)
+{
+    LZ4G_pipe_t pipe;
+    pthread_t reader, writer;
+    int readerRunning = 0, writerRunning = 0;
+    size_t outSize, frameHeaderSize, tableSize, pos;
+    char* out;
+    unsigned i;
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    /* Init */
+    memset(&pipe, 0, sizeof(pipe));
+    pthread_mutex_init(&pipe.mutex, NULL);
+    pthread_cond_init(&pipe.changed, NULL);
+    pipe.io = io;
+    pipe.blockSize = (size_t)LZ4G_GetBlockSize_FromBlockId(prefs->frameInfo.blockSizeID);
+    for (i=0; i<LZ4G_PIPE_SLOTS; i++)
+    {
+        pipe.in.buff[i] = inBuff + i*pipe.blockSize;
+        pipe.out.buff[i] = outBuff + i*outSlotSize;
+    }
+    readerRunning = !pthread_create(&reader, NULL, LZ4G_pipeReader, &pipe);
+    writerRunning = readerRunning && !pthread_create(&writer, NULL, LZ4G_pipeWriter, &pipe);
+    if (!writerRunning) { errorNb = 30; errorMsg = "Thread creation failed"; goto _end; }
+
+    /* Write Archive Header */
+    out = LZ4G_pipeNextOut(&pipe);
+    outSize = LZ4F_compressBegin_usingCDict(ctx, out, outSlotSize, cdict, prefs);
+    if (LZ4F_isError(outSize)) { errorNb = 32; errorMsg = LZ4F_getErrorName(outSize); goto _end; }
+    LZ4G_pipePushOut(&pipe, outSize);
+    frameHeaderSize = outSize;
+    if (LZ4G_seekTableStart(seekTable)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+    /* Main Loop */
+    for (;;)
+    {
+        unsigned const slot = (unsigned)(pipe.in.nbPopped % LZ4G_PIPE_SLOTS);
+        size_t readSize;
+
+        /* Wait for next input block */
+        pthread_mutex_lock(&pipe.mutex);
+        while ((pipe.in.nbPushed == pipe.in.nbPopped) && !pipe.writeError) pthread_cond_wait(&pipe.changed, &pipe.mutex);
+        readSize = pipe.writeError ? 0 : pipe.in.size[slot];
+        pthread_mutex_unlock(&pipe.mutex);
+        if (readSize == 0) break;   /* end of input, or output failure (reported at _end) */
+
+        /* Compress Block; LZ4F keeps its own copy of the dictionary, so the input slot can be recycled */
+        out = LZ4G_pipeNextOut(&pipe);
+        outSize = LZ4F_compressUpdate(ctx, out, outSlotSize, pipe.in.buff[slot], readSize, NULL);
+        if (LZ4F_isError(outSize)) { errorNb = 34; errorMsg = LZ4F_getErrorName(outSize); goto _end; }
+        LZ4G_pipePushOut(&pipe, outSize);
+        if (LZ4G_seekTableAdd(seekTable, outSize, readSize)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+        pthread_mutex_lock(&pipe.mutex);
+        pipe.in.nbPopped++;
+        pthread_cond_broadcast(&pipe.changed);
+        pthread_mutex_unlock(&pipe.mutex);
+    }
+    if (pipe.readError) { errorNb = 38; errorMsg = "Read error : cannot read input"; goto _end; }
+
+    /* End of Stream mark */
+    out = LZ4G_pipeNextOut(&pipe);
+    outSize = LZ4F_compressEnd(ctx, out, outSlotSize, NULL);
+    if (LZ4F_isError(outSize)) { errorNb = 36; errorMsg = LZ4F_getErrorName(outSize); goto _end; }
+    LZ4G_pipePushOut(&pipe, outSize);
+
+    /* Block index, by slot-sized pieces */
+    tableSize = LZ4G_seekTableFinish(seekTable, frameHeaderSize, prefs->frameInfo.contentChecksumFlag == contentChecksumEnabled);
+    for (pos = 0; pos < tableSize; pos += outSize)
+    {
+        outSize = (tableSize - pos < outSlotSize) ? tableSize - pos : outSlotSize;
+        out = LZ4G_pipeNextOut(&pipe);
+        memcpy(out, seekTable->buffer + pos, outSize);
+        LZ4G_pipePushOut(&pipe, outSize);
+    }
+
+_end:
+    /* Stop threads : the writer drains pending slots, the reader stops after its current read */
+    if (writerRunning)
+    {
+        LZ4G_pipeNextOut(&pipe);
+        LZ4G_pipePushOut(&pipe, LZ4G_PIPE_END);
+        pthread_join(writer, NULL);
+    }
+    if (readerRunning)
+    {
+        pthread_mutex_lock(&pipe.mutex);
+        pipe.stop = 1;
+        pthread_cond_broadcast(&pipe.changed);
+        pthread_mutex_unlock(&pipe.mutex);
+        pthread_join(reader, NULL);
+    }
+    pthread_cond_destroy(&pipe.changed);
+    pthread_mutex_destroy(&pipe.mutex);
+    if (!errorNb && pipe.writeError) { errorNb = 35; errorMsg = "Write error : cannot write compressed block"; }
+    if (errorNb) LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    return 0;
+}
+
+#endif   /* LZ4G_MULTITHREAD */
+
+
+static int LZ4G_decodeLZ4S(LZ4G_ctx* ctx, FILE* finput, FILE* foutput,  unsigned long long* ret, char** errstring, int* nerrbytes)
+{
+    unsigned long long filesize = 0;
+    void* inBuff;
+    void* outBuff;
+    unsigned char header[LZ4G_MAXHEADERFRAME_SIZE];
+    size_t headerSize;
+    const size_t inBuffSize = 256 KB;
+    size_t outBuffSize = 256 KB;
+    size_t outPos = 0;
+    LZ4F_errorCode_t errorCode;
+    LZ4F_frameInfo_t frameInfo;
+    unsigned long long storedSkips = 0;
+    int result;
+
+    /* init */
+    if (ctx->dctx == NULL)
+    {
+        errorCode = LZ4F_createDecompressionContext(&ctx->dctx, LZ4F_VERSION);
+        if (LZ4F_isError(errorCode)) { ctx->dctx = NULL; LZ4G_RETURN_ERROR_DOTS(60, "Can't create context : %s", LZ4F_getErrorName(errorCode)); }
+    }
+    LZ4F_resetDecompressionContext(ctx->dctx);   /* previous stream may have stopped within a frame */
+
+    /* Decode frame header, regenerating the magic number already consumed from finput */
+    LZ4G_writeLE32(header, LZ4G_MAGICNUMBER);
+    if (fread(header+4, 1, 1, finput) != 1) LZ4G_RETURN_ERROR(62, "Header error : frame header unreadable");
+    headerSize = 7 + (((header[4] >> 3) & _1BIT) ? 8 : 0) + ((header[4] & _1BIT) ? 4 : 0);   /* content size & dictionary ID flags */
+    if (fread(header+5, 1, headerSize-5, finput) != headerSize-5) LZ4G_RETURN_ERROR(62, "Header error : frame header unreadable");
+    errorCode = LZ4F_getFrameInfo(ctx->dctx, &frameInfo, header, &headerSize);
+    if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(62, "Header error : %s", LZ4F_getErrorName(errorCode));
+    result = LZ4G_checkDictID(ctx, frameInfo.dictID, errstring, nerrbytes);
+    if (result) return result;
+
+    /* Known content size : output space is reserved upfront (unless holes are wanted),
+     * and a frame up to LZ4G_SINGLESHOT_MAX is decoded in place into a single buffer, written at once */
+    if (frameInfo.contentSize)
+    {
+        if (!ctx->params.sparseFileSupport) LZ4G_preallocate(foutput, frameInfo.contentSize);
+        if ((frameInfo.contentSize > outBuffSize) && (frameInfo.contentSize <= LZ4G_SINGLESHOT_MAX)) outBuffSize = (size_t)frameInfo.contentSize;
+    }
+
+#if LZ4G_MULTITHREAD
+    /* Independent blocks can be decoded in parallel */
+    if ((ctx->params.nbThreads > 1) && (frameInfo.blockMode == blockIndependent))
+        return LZ4G_decodeLZ4S_MT(finput, foutput, &frameInfo, ctx->dict, ctx->dictSize, ctx->params.nbThreads, ctx->params.sparseFileSupport, ret, errstring, nerrbytes);
+#endif
+
+    /* Allocate Memory */
+    if (LZ4G_reserveBuffers(ctx, inBuffSize, outBuffSize)) LZ4G_RETURN_ERROR(61, "Allocation error : not enough memory");
+    inBuff = ctx->inBuff;
+    outBuff = ctx->outBuff;
+
+    /* Main Loop */
+    for (;;)
+    {
+        size_t readSize;
+        size_t pos = 0;
+
+        /* Read input */
+        readSize = fread(inBuff, 1, inBuffSize, finput);
+        if (!readSize) break;   /* empty file or stream */
+
+        while (pos < readSize)
+        {
+            /* Decode Input (at least partially), appending to outBuff */
+            size_t remaining = readSize - pos;
+            size_t decodedBytes = outBuffSize - outPos;
+            errorCode = LZ4F_decompress_usingDict(ctx->dctx, (char*)outBuff+outPos, &decodedBytes, (char*)inBuff+pos, &remaining, ctx->dict, ctx->dictSize, NULL);
+            if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(66, "Decompression error : %s", LZ4F_getErrorName(errorCode));
+            pos += remaining;
+            outPos += decodedBytes;
+            filesize += decodedBytes;
+
+            if (outPos == outBuffSize)
+            {
+                /* Write full buffer */
+                result = LZ4G_fwriteSparse(ctx->params.sparseFileSupport, foutput, outBuff, outPos, &storedSkips, errstring, nerrbytes);
+                if (result) return result;
+                outPos = 0;
+            }
+        }
+
+    }
+
+    /* Write last part */
+    result = LZ4G_fwriteSparse(ctx->params.sparseFileSupport, foutput, outBuff, outPos, &storedSkips, errstring, nerrbytes);
+    if (result) return result;
+    result = LZ4G_fwriteSparseEnd(ctx->params.sparseFileSupport, foutput, storedSkips, errstring, nerrbytes);
+    if (result) return result;
+
+    *ret = filesize;
+    return 0;
+}
+
+
+static int LZ4G_passThrough(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, unsigned char U32store[MAGICNUMBER_SIZE],   unsigned long long* ret, char** errstring, int* nerrbytes)
+{
+    void* buffer;
+    size_t read = 1, sizeCheck;
+    unsigned long long total = MAGICNUMBER_SIZE;
+
+    if (LZ4G_reserveBuffers(ctx, 64 KB, 0)) LZ4G_RETURN_ERROR(50, "Allocation error : not enough memory");
+    buffer = ctx->inBuff;
+
+    sizeCheck = fwrite(U32store, 1, MAGICNUMBER_SIZE, foutput);
+    if (sizeCheck != MAGICNUMBER_SIZE) LZ4G_RETURN_ERROR(50, "Pass-through error at start");
+
+    while (read)
+    {
+        read = fread(buffer, 1, 64 KB, finput);
+        total += read;
+        sizeCheck = fwrite(buffer, 1, read, foutput);
+        if (sizeCheck != read) LZ4G_RETURN_ERROR(50, "Pass-through error");
+    }
+
+    *ret = total;
+    return 0;
+}
+
+
+
+#define ENDOFSTREAM ((unsigned long long)-1)
+static int LZ4G_selectDecoder(LZ4G_ctx* ctx, FILE* finput,  FILE* foutput, unsigned long long* ret, char** errstring, int* nerrbytes)
+{
+    unsigned char U32store[MAGICNUMBER_SIZE];
+    unsigned magicNumber, size;
+    int errorNb;
+    size_t nbReadBytes;
+
+    /* init */
+    ctx->nbFrames++;
+
+    /* Check Archive Header */
+    nbReadBytes = fread(U32store, 1, MAGICNUMBER_SIZE, finput);
+    if (nbReadBytes==0) {
+      *ret = ENDOFSTREAM;                  /* EOF */
+      return 0;
+    }
+    if (nbReadBytes != MAGICNUMBER_SIZE) LZ4G_RETURN_ERROR(40, "Unrecognized header : Magic Number unreadable");
+    magicNumber = LZ4G_readLE32(U32store);   /* Little Endian format */
+    if (LZ4G_isSkippableMagicNumber(magicNumber)) magicNumber = LZ4G_SKIPPABLE0;  /* fold skippable magic numbers */
+
+    switch(magicNumber)
+    {
+    case LZ4G_MAGICNUMBER:
+        return LZ4G_DEFAULT_DECOMPRESSOR(ctx, finput, foutput, ret, errstring, nerrbytes);
+    case LEGACY_MAGICNUMBER:
+        /*DISPLAYLEVEL(4, "Detected : Legacy format \n");*/
+        return LZ4G_decodeLegacyStream(ctx, finput, foutput, ret, errstring, nerrbytes);
+    case LZ4G_SKIPPABLE0:
+        /*DISPLAYLEVEL(4, "Skipping detected skippable area \n");*/
+        nbReadBytes = fread(U32store, 1, 4, finput);
+        if (nbReadBytes != 4) LZ4G_RETURN_ERROR(42, "Stream error : skippable size unreadable");
+        size = LZ4G_readLE32(U32store);     /* Little Endian format */
+        errorNb = fseek(finput, size, SEEK_CUR);
+        if (errorNb != 0) LZ4G_RETURN_ERROR(43, "Stream error : cannot skip skippable area");
+        return LZ4G_selectDecoder(ctx, finput, foutput, ret, errstring, nerrbytes);
+    EXTENDED_FORMAT;
+    default:
+        if (ctx->nbFrames == 1)   /* just started */
+        {
+          if (ctx->params.overwrite) {
+            return LZ4G_passThrough(ctx, finput, foutput, U32store, ret, errstring, nerrbytes);
+          }
+          LZ4G_RETURN_ERROR(44,"Unrecognized header : file cannot be decoded: Wrong magic number at the beginning of 1st stream.");
+        }
+        /*DISPLAYLEVEL(2, "Stream followed by unrecognized data\n");*/
+        *ret = ENDOFSTREAM;
+        return 0;
+    }
+}
+
+
+
+
+
+/**************************************
+ * LZ4G: Super simple API usable by Golang/other libraries for framed lz4 compression.
+ *
+ * both LZ4G_compressFramedFileStream() and LZ4G_decompressFramedFileStream()
+ * return 0 on no error. Otherwise they return > 0 and write error
+ * message to to *errstring, which must be 1024 or more bytes, allocated
+ * by the caller. *nerrbytes must point to an integer which holds
+ * the remaining capacity of *errstring. Hence *nerrbytes must
+ * be 1024 or greater on entry.
+ * ************************************/
+
+/* LZ4G_initCctx() : creates ctx->cctx on first use, otherwise abandons any frame left in progress */
+static int LZ4G_initCctx(LZ4G_ctx* ctx, char** errstring, int* nerrbytes)
+{
+    if (ctx->cctx == NULL)
+    {
+        LZ4F_errorCode_t const errorCode = LZ4F_createCompressionContext(&ctx->cctx, LZ4F_VERSION);
+        if (LZ4F_isError(errorCode)) { ctx->cctx = NULL; LZ4G_RETURN_ERROR_DOTS(30, "Allocation error : can't create LZ4F context : '%s'", LZ4F_getErrorName(errorCode)); }
+    }
+    LZ4F_resetCompressionContext(ctx->cctx);
+    return 0;
+}
+
+/* LZ4G_initPrefs() : frame preferences from ctx parameters; contentSize is only written when enabled and known (!=0) */
+static void LZ4G_initPrefs(const LZ4G_ctx* ctx, LZ4F_preferences_t* prefs, int compressionLevel, unsigned long long contentSize)
+{
+    memset(prefs, 0, sizeof(*prefs));
+    prefs->autoFlush = 1;
+    prefs->compressionLevel = compressionLevel;
+    prefs->frameInfo.blockMode = (blockMode_t)ctx->params.blockIndependence;
+    prefs->frameInfo.blockSizeID = (blockSizeID_t)ctx->params.blockSizeID;
+    prefs->frameInfo.contentChecksumFlag = (contentChecksum_t)ctx->params.streamChecksum;
+    prefs->frameInfo.blockChecksumFlag = (blockChecksum_t)ctx->params.blockChecksum;
+    if (ctx->params.contentSize) prefs->frameInfo.contentSize = contentSize;
+    prefs->frameInfo.dictID = ctx->dictID;
+}
+
+/* LZ4G_compressIo() : common compression loop, whatever the input and output.
+ * contentSize is the size of input when known, 0 otherwise.
+ * Blocks within holes of io->holeInput are not read; with independent blocks,
+ * the first block of zeroes is compressed, and then re-used for the next ones */
+static int LZ4G_compressIo(LZ4G_ctx* ctx, const LZ4G_io_t* io, int compressionLevel, unsigned long long contentSize, char** errstring, int* nerrbytes)
+{
+    char* in_buff;
+    char* out_buff;
+    char* zeroBlock;
+    int blockSize;
+    size_t sizeCheck, headerSize, readSize, outBuffSize, frameHeaderSize;
+    size_t zeroBlockSize = 0;
+    unsigned long long dataEnd = 0;
+    int inZero = 0;   /* in_buff holds a block of zeroes */
+    LZ4F_preferences_t prefs;
+    LZ4G_seekTable_t* const seekTable = (ctx->params.seekable && ctx->params.blockIndependence) ? &ctx->seekTable : NULL;
+
+
+    /* Init */
+    { int const errorNb = LZ4G_initCctx(ctx, errstring, nerrbytes); if (errorNb) return errorNb; }
+    blockSize = LZ4G_GetBlockSize_FromBlockId (ctx->params.blockSizeID);
+    LZ4G_initPrefs(ctx, &prefs, compressionLevel, contentSize);
+
+#if LZ4G_MULTITHREAD
+    /* Independent blocks can be compressed in parallel, producing the same frame */
+    if ((ctx->params.nbThreads > 1) && ctx->params.blockIndependence)
+        return LZ4G_compressIo_MT(io, ctx->cctx, &prefs, ctx->params.nbThreads, ctx->dict, ctx->dictSize, seekTable, errstring, nerrbytes);
+#endif
+
+    /* Allocate Memory */
+    outBuffSize = LZ4F_compressBound(blockSize, &prefs);
+
+#if LZ4G_MULTITHREAD
+    /* Overlap reading and writing with compression */
+    if (ctx->params.asyncIO)
+    {
+        if (LZ4G_reserveBuffers(ctx, LZ4G_PIPE_SLOTS * (size_t)blockSize, LZ4G_PIPE_SLOTS * outBuffSize)) LZ4G_RETURN_ERROR(31, "Allocation error : not enough memory");
+        return LZ4G_compressIo_async(io, ctx->cctx, &prefs, ctx->cdict, (char*)ctx->inBuff, (char*)ctx->outBuff, outBuffSize, seekTable, errstring, nerrbytes);
+    }
+#endif
+
+    if (LZ4G_reserveBuffers(ctx, blockSize, outBuffSize + ((io->holeInput && ctx->params.blockIndependence) ? outBuffSize : 0)))
+        LZ4G_RETURN_ERROR(31, "Allocation error : not enough memory");
+    in_buff  = (char*)ctx->inBuff;
+    out_buff = (char*)ctx->outBuff;
+    zeroBlock = out_buff + outBuffSize;
+
+    /* Write Archive Header */
+    headerSize = LZ4F_compressBegin_usingCDict(ctx->cctx, out_buff, outBuffSize, ctx->cdict, &prefs);
+    if (LZ4F_isError(headerSize)) LZ4G_RETURN_ERROR_DOTS(32, "File header generation failed : '%s'", LZ4F_getErrorName(headerSize));
+    sizeCheck = io->write(io->writeOpaque, out_buff, headerSize);
+    if (sizeCheck!=headerSize) LZ4G_RETURN_ERROR(33, "Write error : cannot write header");
+    frameHeaderSize = headerSize;
+    if (LZ4G_seekTableStart(seekTable)) LZ4G_RETURN_ERROR(31, "Allocation error : not enough memory");
+
+    /* Main Loop */
+    for (;;)
+    {
+        size_t outSize;
+
+        /* Read Block */
+        if (io->holeInput && LZ4G_skipHole(io->holeInput, (size_t)blockSize, &dataEnd))
+        {
+            if (!inZero) { memset(in_buff, 0, blockSize); inZero = 1; }
+            readSize = blockSize;
+        }
+        else
+        {
+            inZero = 0;
+            readSize = LZ4G_readFull(io, in_buff, (size_t)blockSize);
+            if (readSize == LZ4G_READ_ERROR) LZ4G_RETURN_ERROR(38, "Read error : cannot read input");
+            if (readSize == 0) break;
+        }
+
+        /* Compress Block */
+        if (inZero && zeroBlockSize)
+            outSize = LZ4F_insertBlock(ctx->cctx, out_buff, outBuffSize, in_buff, readSize, zeroBlock, zeroBlockSize);
+        else
+            outSize = LZ4F_compressUpdate(ctx->cctx, out_buff, outBuffSize, in_buff, readSize, NULL);
+        if (LZ4F_isError(outSize)) LZ4G_RETURN_ERROR_DOTS(34, "Compression failed : '%s'", LZ4F_getErrorName(outSize));
+        if (inZero && !zeroBlockSize && ctx->params.blockIndependence) { memcpy(zeroBlock, out_buff, outSize); zeroBlockSize = outSize; }
+        if (LZ4G_seekTableAdd(seekTable, outSize, readSize)) LZ4G_RETURN_ERROR(31, "Allocation error : not enough memory");
+
+        /* Write Block */
+        sizeCheck = io->write(io->writeOpaque, out_buff, outSize);
+        if (sizeCheck!=outSize) LZ4G_RETURN_ERROR(35, "Write error : cannot write compressed block");
+    }
+
+    /* End of Stream mark */
+    headerSize = LZ4F_compressEnd(ctx->cctx, out_buff, outBuffSize, NULL);
+    if (LZ4F_isError(headerSize)) LZ4G_RETURN_ERROR_DOTS(36, "End of file generation failed : '%s'", LZ4F_getErrorName(headerSize));
+
+    sizeCheck = io->write(io->writeOpaque, out_buff, headerSize);
+    if (sizeCheck!=headerSize) LZ4G_RETURN_ERROR(37, "Write error : cannot write end of stream");
+
+    /* Block index */
+    headerSize = LZ4G_seekTableFinish(seekTable, frameHeaderSize, ctx->params.streamChecksum);
+    if (headerSize && (io->write(io->writeOpaque, seekTable->buffer, headerSize) != headerSize))
+        LZ4G_RETURN_ERROR(39, "Write error : cannot write block index");
+
+    return 0;
+}
+
+int LZ4G_compressFramedFileStream_withCtx(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, int compressionLevel, char** errstring, int* nerrbytes)
+{
+    LZ4G_io_t io;
+    LZ4G_fileIo(&io, finput, foutput);
+    io.holeInput = finput;
+    return LZ4G_compressIo(ctx, &io, compressionLevel, ctx->params.contentSize ? LZ4G_getFileSize(finput) : 0, errstring, nerrbytes);
+}
+
+int LZ4G_compressStream_withCtx(LZ4G_ctx* ctx, LZ4G_readFunction readFunction, void* readOpaque,
+                                LZ4G_writeFunction writeFunction, void* writeOpaque,
+                                int compressionLevel, char** errstring, int* nerrbytes)
+{
+    LZ4G_io_t io;
+    io.read = readFunction;
+    io.readOpaque = readOpaque;
+    io.write = writeFunction;
+    io.writeOpaque = writeOpaque;
+    io.holeInput = NULL;
+    return LZ4G_compressIo(ctx, &io, compressionLevel, 0, errstring, nerrbytes);   /* content size unknown */
+}
+
+
+int LZ4G_compressFramedFileStream(FILE* finput, FILE* foutput, int compressionLevel, char** errstring, int* nerrbytes)
+{
+    LZ4G_ctx* const ctx = LZ4G_poolAcquire();
+    int result;
+
+    if (ctx == NULL) LZ4G_RETURN_ERROR(30, "Allocation error : can't create LZ4G context");
+    result = LZ4G_compressFramedFileStream_withCtx(ctx, finput, foutput, compressionLevel, errstring, nerrbytes);
+    LZ4G_poolRelease(ctx);
+    if (result) return result;
+
+    /* Close */
+    fclose(finput);
+    fclose(foutput);
+    return 0;
+}
+
+
+
+/* ********************************************************************* */
+/* ********************** LZ4 file-stream Decompression **************** */
+/* ********************************************************************* */
+
+int LZ4G_decompressFramedFileStream_withCtx(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, char** errstring, int* nerrbytes)
+{
+    unsigned long long filesize = 0, decodedSize=0;
+    int decRes = 0;
+
+    **errstring = '\0';
+
+    /* Init */
+    ctx->nbFrames = 0;
+
+    /* sparse file */
+    if (ctx->params.sparseFileSupport && foutput) { SET_SPARSE_FILE_MODE(foutput); }
+
+    /* Loop over multiple streams */
+    do
+    {
+      decRes = LZ4G_selectDecoder(ctx, finput, foutput, &decodedSize, errstring, nerrbytes);
+      if (decRes != 0) {
+        return decRes;
+      }
+      if (decodedSize != ENDOFSTREAM)
+        filesize += decodedSize;
+    } while (decodedSize != ENDOFSTREAM);
+
+    /*  Error status = OK */
+    return 0;
+}
+
+
+int LZ4G_decompressFramedFileStream(FILE* finput, FILE* foutput, char** errstring, int* nerrbytes)
+{
+    LZ4G_ctx* const ctx = LZ4G_poolAcquire();
+    int result;
+
+    if (ctx == NULL) LZ4G_RETURN_ERROR(60, "Allocation error : can't create LZ4G context");
+    result = LZ4G_decompressFramedFileStream_withCtx(ctx, finput, foutput, errstring, nerrbytes);
+    LZ4G_poolRelease(ctx);
+    if (result) return result;
+
+    /* Close */
+    fclose(finput);
+    fclose(foutput);
+    return 0;
+}
+
+
+
+/* ********************************************************************* */
+/* ********************** Buffer API *********************************** */
+/* ********************************************************************* */
+
+/* LZ4G_bufferPrefs() :
+ * as LZ4F_compressFrame() does, block size is reduced to fit small sources,
+ * and a single block is always independent. Content size is always written. */
+static void LZ4G_bufferPrefs(const LZ4G_ctx* ctx, LZ4F_preferences_t* prefs, int compressionLevel, size_t srcSize)
+{
+    int bsid = ctx->params.blockSizeID;
+    LZ4G_initPrefs(ctx, prefs, compressionLevel, 0);
+    prefs->frameInfo.contentSize = srcSize;
+    while ((bsid > minBlockSizeID) && ((size_t)LZ4G_GetBlockSize_FromBlockId(bsid-1) >= srcSize)) bsid--;
+    prefs->frameInfo.blockSizeID = (blockSizeID_t)bsid;
+    if (srcSize <= (size_t)LZ4G_GetBlockSize_FromBlockId(bsid)) prefs->frameInfo.blockMode = blockIndependent;
+}
+
+size_t LZ4G_compressFrameBound(const LZ4G_ctx* ctx, size_t srcSize)
+{
+    LZ4F_preferences_t prefs;
+    LZ4G_bufferPrefs(ctx, &prefs, 0, srcSize);
+    return LZ4F_compressFrameBound(srcSize, &prefs);
+}
+
+int LZ4G_compressFrameToBuffer(LZ4G_ctx* ctx, void* dst, size_t dstCapacity, size_t* dstSize,
+                               const void* src, size_t srcSize, int compressionLevel,
+                               char** errstring, int* nerrbytes)
+{
+    char* const dstStart = (char*)dst;
+    char* dstPtr = dstStart;
+    char* const dstEnd = dstStart + dstCapacity;
+    LZ4F_preferences_t prefs;
+    LZ4F_compressOptions_t options;
+    size_t result;
+
+    /* Init */
+    *dstSize = 0;
+    { int const errorNb = LZ4G_initCctx(ctx, errstring, nerrbytes); if (errorNb) return errorNb; }
+    LZ4G_bufferPrefs(ctx, &prefs, compressionLevel, srcSize);
+    if (dstCapacity < LZ4F_compressFrameBound(srcSize, &prefs)) LZ4G_RETURN_ERROR(80, "Destination buffer too small : see LZ4G_compressFrameBound()");
+    memset(&options, 0, sizeof(options));
+    options.stableSrc = 1;   /* src remains available : linked blocks are not copied */
+
+    /* Header, blocks, end mark, straight into dst */
+    result = LZ4F_compressBegin_usingCDict(ctx->cctx, dstPtr, dstEnd-dstPtr, ctx->cdict, &prefs);
+    if (LZ4F_isError(result)) LZ4G_RETURN_ERROR_DOTS(81, "Frame header generation failed : '%s'", LZ4F_getErrorName(result));
+    dstPtr += result;
+    result = LZ4F_compressUpdate(ctx->cctx, dstPtr, dstEnd-dstPtr, src, srcSize, &options);
+    if (LZ4F_isError(result)) LZ4G_RETURN_ERROR_DOTS(82, "Compression failed : '%s'", LZ4F_getErrorName(result));
+    dstPtr += result;
+    result = LZ4F_compressEnd(ctx->cctx, dstPtr, dstEnd-dstPtr, &options);
+    if (LZ4F_isError(result)) LZ4G_RETURN_ERROR_DOTS(83, "End of frame generation failed : '%s'", LZ4F_getErrorName(result));
+    dstPtr += result;
+
+    *dstSize = (size_t)(dstPtr - dstStart);
+    return 0;
+}
+
+int LZ4G_getFrameContentSize(const void* src, size_t srcSize, unsigned long long* contentSize)
+{
+    const unsigned char* const srcPtr = (const unsigned char*)src;
+    unsigned long long size = 0;
+    int i;
+
+    if ((srcSize < 15) || (LZ4G_readLE32(srcPtr) != LZ4G_MAGICNUMBER)) return 1;
+    if (!((srcPtr[4] >> 3) & _1BIT)) return 1;   /* content size flag */
+    for (i=7; i>=0; i--) size = (size << 8) + srcPtr[6+i];
+    *contentSize = size;
+    return 0;
+}
+
+int LZ4G_getFrameDictID(const void* src, size_t srcSize, unsigned* dictID)
+{
+    const unsigned char* const srcPtr = (const unsigned char*)src;
+    size_t headerSize;
+
+    if ((srcSize < 7) || (LZ4G_readLE32(srcPtr) != LZ4G_MAGICNUMBER)) return 1;
+    if (!(srcPtr[4] & _1BIT)) return 1;   /* dictionary ID flag */
+    headerSize = ((srcPtr[4] >> 3) & _1BIT) ? 19 : 11;   /* content size flag */
+    if (srcSize < headerSize) return 1;
+    *dictID = LZ4G_readLE32(srcPtr + headerSize - 5);
+    return 0;
+}
 
+int LZ4G_decompressFrameToBuffer(LZ4G_ctx* ctx, void* dst, size_t dstCapacity, size_t* dstSize,
+                                 const void* src, size_t srcSize,
+                                 char** errstring, int* nerrbytes)
+{
+    const char* srcPtr = (const char*)src;
+    const char* const srcEnd = srcPtr + srcSize;
+    char* dstPtr = (char*)dst;
+    char* const dstEnd = dstPtr + dstCapacity;
+    unsigned long long contentSize;
+    unsigned dictID = 0;
+    size_t hint = 1;
 
-/**************************************
- * LZ4G: Super simple API usable by Golang/other libraries for framed lz4 compression.
- *
- * both LZ4G_compressFramedFileStream() and LZ4G_decompressFramedFileStream()
- * return 0 on no error. Otherwise they return > 0 and write error
- * message to to *errstring, which must be 1024 or more bytes, allocated
- * by the caller. *nerrbytes must point to an integer which holds
- * the remaining capacity of *errstring. Hence *nerrbytes must
- * be 1024 or greater on entry.
- * ************************************/
+    /* Init */
+    **errstring = '\0';
+    *dstSize = 0;
+    if ((LZ4G_getFrameContentSize(src, srcSize, &contentSize) == 0) && (contentSize > dstCapacity))
+        LZ4G_RETURN_ERROR_DOTS(84, "Destination buffer too small : frame content size is %llu", contentSize);
+    LZ4G_getFrameDictID(src, srcSize, &dictID);
+    { int const errorNb = LZ4G_checkDictID(ctx, dictID, errstring, nerrbytes); if (errorNb) return errorNb; }
+    if (ctx->dctx == NULL)
+    {
+        LZ4F_errorCode_t const errorCode = LZ4F_createDecompressionContext(&ctx->dctx, LZ4F_VERSION);
+        if (LZ4F_isError(errorCode)) { ctx->dctx = NULL; LZ4G_RETURN_ERROR_DOTS(60, "Can't create context : %s", LZ4F_getErrorName(errorCode)); }
+    }
+    LZ4F_resetDecompressionContext(ctx->dctx);
+
+    /* Decode a single frame, straight into dst */
+    while (hint)
+    {
+        size_t consumed = (size_t)(srcEnd - srcPtr);
+        size_t decoded = (size_t)(dstEnd - dstPtr);
+        hint = LZ4F_decompress_usingDict(ctx->dctx, dstPtr, &decoded, srcPtr, &consumed, ctx->dict, ctx->dictSize, NULL);
+        if (LZ4F_isError(hint)) LZ4G_RETURN_ERROR_DOTS(85, "Decompression error : %s", LZ4F_getErrorName(hint));
+        srcPtr += consumed;
+        dstPtr += decoded;
+        if (hint && !consumed && !decoded)
+        {
+            if (srcPtr == srcEnd) LZ4G_RETURN_ERROR(86, "Source error : unfinished frame");
+            LZ4G_RETURN_ERROR(84, "Destination buffer too small");
+        }
+    }
+    if (srcPtr != srcEnd) LZ4G_RETURN_ERROR(87, "Source error : unexpected data after frame");
+
+    *dstSize = (size_t)(dstPtr - (char*)dst);
+    return 0;
+}
+
+
+
+/* ********************************************************************* */
+/* ********************** Window decoder ******************************* */
+/* ********************************************************************* */
 
-int LZ4G_compressFramedFileStream(FILE* finput, FILE* foutput, int compressionLevel, char** errstring, int* nerrbytes) 
+/* Decodes input available as a memory window : either a whole mapped file,
+ * or a buffer refilled through a read function.
+ * Decoded data is written by batches through a write function. */
+
+#define LZ4G_OUTBATCH (1 MB)   /* output is written by batches of about this size */
+#define LZ4G_WINDOWSIZE (256 KB)
+
+typedef struct {
+    const unsigned char* src;    /* unconsumed input */
+    size_t srcSize;
+    unsigned long long consumed;
+    const LZ4G_io_t* io;         /* NULL : src is the whole input */
+    int eof;
+} LZ4G_window_t;
+
+/* LZ4G_windowFill() :
+ * tries to get at least needed bytes into the window, reading more input if necessary.
+ * Less is available at end of input. result : 0 on success, 1 on read or allocation error */
+static int LZ4G_windowFill(LZ4G_ctx* ctx, LZ4G_window_t* w, size_t needed)
 {
-    unsigned long long filesize = 0;
-    unsigned long long compressedfilesize = 0;
-    char* in_buff;
-    char* out_buff;
-    clock_t start, end;
-    int blockSize;
-    size_t sizeCheck, headerSize, readSize, outBuffSize;
-    LZ4F_compressionContext_t ctx;
-    LZ4F_errorCode_t errorCode;
-    LZ4F_preferences_t prefs;
+    unsigned char* buffer = (unsigned char*)ctx->inBuff;
+    if ((w->io == NULL) || (w->srcSize >= needed)) return 0;
+
+    if (ctx->inBuffSize < needed)
+    {   /* grow buffer, preserving unconsumed input */
+        unsigned char* const newBuffer = (unsigned char*)malloc(needed);
+        if (newBuffer == NULL) return 1;
+        memcpy(newBuffer, w->src, w->srcSize);
+        free(ctx->inBuff);
+        ctx->inBuff = buffer = newBuffer;
+        ctx->inBuffSize = needed;
+    }
+    else if (w->src != buffer)
+        memmove(buffer, w->src, w->srcSize);
+    w->src = buffer;
+
+    while ((w->srcSize < needed) && !w->eof)
+    {
+        size_t const readSize = w->io->read(w->io->readOpaque, buffer + w->srcSize, ctx->inBuffSize - w->srcSize);
+        if (readSize == LZ4G_READ_ERROR) return 1;
+        if (readSize == 0) w->eof = 1;
+        w->srcSize += readSize;
+    }
+    return 0;
+}
 
+static void LZ4G_windowSkip(LZ4G_window_t* w, size_t size)
+{
+    w->src += size;
+    w->srcSize -= size;
+    w->consumed += size;
+}
 
-    /* Init */
-    start = clock();
-    memset(&prefs, 0, sizeof(prefs));
-    /*if ((g_displayLevel==2) && (compressionLevel>=3)) g_displayLevel=3;*/
-    errorCode = LZ4F_createCompressionContext(&ctx, LZ4F_VERSION);
-    if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(30, "Allocation error : can't create LZ4F context : '%s'", LZ4F_getErrorName(errorCode));
-    blockSize = LZ4G_GetBlockSize_FromBlockId (g_blockSizeId);
+/* LZ4G_windowFlush() : writes decoded data accumulated into ctx->outBuff */
+static int LZ4G_windowFlush(LZ4G_ctx* ctx, const LZ4G_io_t* out, size_t* filled, char** errstring, int* nerrbytes)
+{
+    if (*filled == 0) return 0;
+    if (out->write(out->writeOpaque, ctx->outBuff, *filled) != *filled) LZ4G_RETURN_ERROR(68, "Write error : cannot write decoded block");
+    *filled = 0;
+    return 0;
+}
 
-    /* Set compression parameters */
-    prefs.autoFlush = 1;
-    prefs.compressionLevel = compressionLevel;
-    prefs.frameInfo.blockMode = (blockMode_t)g_blockIndependence;
-    prefs.frameInfo.blockSizeID = (blockSizeID_t)g_blockSizeId;
-    prefs.frameInfo.contentChecksumFlag = (contentChecksum_t)g_streamChecksum;
-    if (g_contentSizeFlag)
+static int LZ4G_windowDecodeFrame(LZ4G_ctx* ctx, LZ4G_window_t* w, const LZ4G_io_t* out, size_t* filled, char** errstring, int* nerrbytes)
+{
+    unsigned dictID = 0;
+    size_t hint = 1;
+
+    LZ4F_resetDecompressionContext(ctx->dctx);
+    if (LZ4G_windowFill(ctx, w, LZ4G_MAXHEADERFRAME_SIZE)) LZ4G_RETURN_ERROR(63, "Read error : cannot read input");
+    LZ4G_getFrameDictID(w->src, w->srcSize, &dictID);
+    { int const errorNb = LZ4G_checkDictID(ctx, dictID, errstring, nerrbytes); if (errorNb) return errorNb; }
+    while (hint)
     {
-      unsigned long long fileSize = 0; /*LZ4G_GetFileSize(input_filename);*/
-      prefs.frameInfo.contentSize = fileSize;   /* == 0 if input == stdin */
+        size_t srcSize = w->srcSize;
+        size_t decodedBytes = ctx->outBuffSize - *filled;
+        hint = LZ4F_decompress_usingDict(ctx->dctx, (char*)ctx->outBuff + *filled, &decodedBytes, w->src, &srcSize, ctx->dict, ctx->dictSize, NULL);
+        if (LZ4F_isError(hint)) LZ4G_RETURN_ERROR_DOTS(66, "Decompression error : %s", LZ4F_getErrorName(hint));
+        LZ4G_windowSkip(w, srcSize);
+        *filled += decodedBytes;
+        if (*filled >= LZ4G_OUTBATCH)
+        {
+            int const errorNb = LZ4G_windowFlush(ctx, out, filled, errstring, nerrbytes);
+            if (errorNb) return errorNb;
+        }
+        if (hint && !srcSize && !decodedBytes)
+        {   /* all input consumed */
+            if (LZ4G_windowFill(ctx, w, 1)) LZ4G_RETURN_ERROR(63, "Read error : cannot read input");
+            if (w->srcSize == 0) LZ4G_RETURN_ERROR(63, "Read error : unfinished frame");
+        }
     }
+    return 0;
+}
 
-    /* Allocate Memory */
-    in_buff  = (char*)malloc(blockSize);
-    outBuffSize = LZ4F_compressBound(blockSize, &prefs);
-    out_buff = (char*)malloc(outBuffSize);
-    if (!in_buff || !out_buff) LZ4G_RETURN_ERROR(31, "Allocation error : not enough memory");
+/* LZ4G_windowDecodeLegacy() : decodes legacy blocks following the magic number, up to the next frame */
+static int LZ4G_windowDecodeLegacy(LZ4G_ctx* ctx, LZ4G_window_t* w, const LZ4G_io_t* out, size_t* filled, char** errstring, int* nerrbytes)
+{
+    for (;;)
+    {
+        unsigned blockSize;
+        int decodeSize;
 
-    /* Write Archive Header */
-    headerSize = LZ4F_compressBegin(ctx, out_buff, outBuffSize, &prefs);
-    if (LZ4F_isError(headerSize)) LZ4G_RETURN_ERROR_DOTS(32, "File header generation failed : '%s'", LZ4F_getErrorName(headerSize));
-    sizeCheck = fwrite(out_buff, 1, headerSize, foutput);
-    if (sizeCheck!=headerSize) LZ4G_RETURN_ERROR(33, "Write error : cannot write header");
-    compressedfilesize += headerSize;
+        if (LZ4G_windowFill(ctx, w, 4)) LZ4G_RETURN_ERROR(52, "Read error : cannot access block size");
+        if (w->srcSize < 4) break;   /* end of input */
+        blockSize = LZ4G_readLE32(w->src);
+        if (blockSize > LZ4_COMPRESSBOUND(LEGACY_BLOCKSIZE)) break;   /* maybe new stream */
+        if (LZ4G_windowFill(ctx, w, 4 + (size_t)blockSize) || (w->srcSize < 4 + (size_t)blockSize))
+            LZ4G_RETURN_ERROR(52, "Read error : cannot access compressed block !");
+        if (ctx->outBuffSize - *filled < LEGACY_BLOCKSIZE)
+        {
+            int const errorNb = LZ4G_windowFlush(ctx, out, filled, errstring, nerrbytes);
+            if (errorNb) return errorNb;
+        }
+        decodeSize = LZ4_decompress_safe((const char*)w->src + 4, (char*)ctx->outBuff + *filled, (int)blockSize, LEGACY_BLOCKSIZE);
+        if (decodeSize < 0) LZ4G_RETURN_ERROR(53, "Decoding Failed ! Corrupted input detected !");
+        *filled += (size_t)decodeSize;
+        LZ4G_windowSkip(w, 4 + (size_t)blockSize);
+    }
+    return 0;
+}
 
-    /* read first block */
-    readSize = fread(in_buff, (size_t)1, (size_t)blockSize, finput);
-    filesize += readSize;
+/* LZ4G_windowDecode() : loops over multiple streams, as LZ4G_selectDecoder() does */
+static int LZ4G_windowDecode(LZ4G_ctx* ctx, LZ4G_window_t* w, const LZ4G_io_t* out, char** errstring, int* nerrbytes)
+{
+    size_t filled = 0;
+    int errorNb;
 
-    /* Main Loop */
-    while (readSize>0)
+    /* Init */
+    if (ctx->dctx == NULL)
     {
-        size_t outSize;
+        LZ4F_errorCode_t const errorCode = LZ4F_createDecompressionContext(&ctx->dctx, LZ4F_VERSION);
+        if (LZ4F_isError(errorCode)) { ctx->dctx = NULL; LZ4G_RETURN_ERROR_DOTS(60, "Can't create context : %s", LZ4F_getErrorName(errorCode)); }
+    }
+    if (LZ4G_reserveBuffers(ctx, w->io ? LZ4G_WINDOWSIZE : 0, LZ4G_OUTBATCH + LEGACY_BLOCKSIZE)) LZ4G_RETURN_ERROR(61, "Allocation error : not enough memory");
+    if (w->io) w->src = (const unsigned char*)ctx->inBuff;
+    ctx->nbFrames = 0;
 
-        /* Compress Block */
-        outSize = LZ4F_compressUpdate(ctx, out_buff, outBuffSize, in_buff, readSize, NULL);
-        if (LZ4F_isError(outSize)) LZ4G_RETURN_ERROR_DOTS(34, "Compression failed : '%s'", LZ4F_getErrorName(outSize));
-        compressedfilesize += outSize;
+    for (;;)
+    {
+        unsigned magicNumber;
 
-        /* Write Block */
-        sizeCheck = fwrite(out_buff, 1, outSize, foutput);
-        if (sizeCheck!=outSize) LZ4G_RETURN_ERROR(35, "Write error : cannot write compressed block");
+        if (LZ4G_windowFill(ctx, w, MAGICNUMBER_SIZE)) LZ4G_RETURN_ERROR(40, "Read error : cannot read input");
+        if (w->srcSize == 0) break;   /* EOF */
+        ctx->nbFrames++;
+        if (w->srcSize < MAGICNUMBER_SIZE) LZ4G_RETURN_ERROR(40, "Unrecognized header : Magic Number unreadable");
+        magicNumber = LZ4G_readLE32(w->src);
+        if (LZ4G_isSkippableMagicNumber(magicNumber)) magicNumber = LZ4G_SKIPPABLE0;  /* fold skippable magic numbers */
 
-        /* Read next block */
-        readSize = fread(in_buff, (size_t)1, (size_t)blockSize, finput);
-        filesize += readSize;
+        switch(magicNumber)
+        {
+        case LZ4G_MAGICNUMBER:
+            errorNb = LZ4G_windowDecodeFrame(ctx, w, out, &filled, errstring, nerrbytes);
+            if (errorNb) return errorNb;
+            break;
+        case LEGACY_MAGICNUMBER:
+            LZ4G_windowSkip(w, MAGICNUMBER_SIZE);
+            errorNb = LZ4G_windowDecodeLegacy(ctx, w, out, &filled, errstring, nerrbytes);
+            if (errorNb) return errorNb;
+            break;
+        case LZ4G_SKIPPABLE0:
+            {
+                unsigned long long size;
+                if (LZ4G_windowFill(ctx, w, 8) || (w->srcSize < 8)) LZ4G_RETURN_ERROR(42, "Stream error : skippable size unreadable");
+                size = LZ4G_readLE32(w->src + 4);
+                LZ4G_windowSkip(w, 8);
+                while (size > 0)
+                {
+                    size_t const skipSize = (size < w->srcSize) ? (size_t)size : w->srcSize;
+                    LZ4G_windowSkip(w, skipSize);
+                    size -= skipSize;
+                    if (size == 0) break;
+                    if (LZ4G_windowFill(ctx, w, 1) || (w->srcSize == 0)) LZ4G_RETURN_ERROR(43, "Stream error : cannot skip skippable area");
+                }
+                break;
+            }
+        default:
+            if (ctx->nbFrames > 1) goto _end;   /* stream followed by unrecognized data */
+            if (!ctx->params.overwrite) LZ4G_RETURN_ERROR(44,"Unrecognized header : file cannot be decoded: Wrong magic number at the beginning of 1st stream.");
+            /* pass-through */
+            while (w->srcSize)
+            {
+                if (out->write(out->writeOpaque, w->src, w->srcSize) != w->srcSize) LZ4G_RETURN_ERROR(50, "Pass-through error");
+                LZ4G_windowSkip(w, w->srcSize);
+                if (LZ4G_windowFill(ctx, w, 1)) LZ4G_RETURN_ERROR(50, "Pass-through error : cannot read input");
+            }
+            break;
+        }
     }
 
-    /* End of Stream mark */
-    headerSize = LZ4F_compressEnd(ctx, out_buff, outBuffSize, NULL);
-    if (LZ4F_isError(headerSize)) LZ4G_RETURN_ERROR_DOTS(36, "End of file generation failed : '%s'", LZ4F_getErrorName(headerSize));
+_end:
+    return LZ4G_windowFlush(ctx, out, &filled, errstring, nerrbytes);
+}
 
-    sizeCheck = fwrite(out_buff, 1, headerSize, foutput);
-    if (sizeCheck!=headerSize) LZ4G_RETURN_ERROR(37, "Write error : cannot write end of stream");
-    compressedfilesize += headerSize;
 
-    /* Close & Free */
-    free(in_buff);
-    free(out_buff);
-    fclose(finput);
-    fclose(foutput);
-    errorCode = LZ4F_freeCompressionContext(ctx);
-    if (LZ4F_isError(errorCode)) LZ4G_RETURN_ERROR_DOTS(38, "Error : can't free LZ4F context resource : '%s'", LZ4F_getErrorName(errorCode));
+int LZ4G_decompressStream_withCtx(LZ4G_ctx* ctx, LZ4G_readFunction readFunction, void* readOpaque,
+                                  LZ4G_writeFunction writeFunction, void* writeOpaque,
+                                  char** errstring, int* nerrbytes)
+{
+    LZ4G_io_t io;
+    LZ4G_window_t window;
 
-    /* Final Status */
-    end = clock();
-    return 0;
+    **errstring = '\0';
+    io.read = readFunction;
+    io.readOpaque = readOpaque;
+    io.write = writeFunction;
+    io.writeOpaque = writeOpaque;
+    io.holeInput = NULL;
+    memset(&window, 0, sizeof(window));
+    window.io = &io;
+    return LZ4G_windowDecode(ctx, &window, &io, errstring, nerrbytes);
 }
 
 
 
 /* ********************************************************************* */
-/* ********************** LZ4 file-stream Decompression **************** */
+/* ********************** File descriptor API ************************** */
 /* ********************************************************************* */
+#if LZ4G_FDAPI
+
+typedef struct {
+    const unsigned char* base;   /* whole file mapping, NULL if nothing to map */
+    size_t mapSize;
+    size_t start;                /* input position when called */
+} LZ4G_fdMap_t;
+
+typedef struct {
+    int fd;
+    off_t offset;       /* next write position; -1 if fd is not seekable : write() is used */
+    int sparseMode;
+    int pendingZero;    /* last segment was skipped : file size still to be extended */
+    off_t fileSize;     /* size of output before writing : zeroes skipped below it must clear existing data */
+#if LZ4G_URING
+    struct LZ4G_uring_s* uring;   /* writes are queued through io_uring; NULL : pwrite() */
+    int fdFlags;                  /* file status flags to restore after O_DIRECT, -1 if unchanged */
+#endif
+} LZ4G_fdWriter_t;
+
+#if LZ4G_URING
+
+/* io_uring write engine :
+ * output is copied into LZ4G_URING_DEPTH buffers, registered once per context when the kernel allows it,
+ * and written asynchronously at its file offset, so that many writes are in flight at once.
+ * Buffers are aligned, so that O_DIRECT can be used on aligned positions. */
+
+#define LZ4G_URING_DEPTH   8
+#define LZ4G_URING_BUFSIZE (1 MB)
+#define LZ4G_DIRECT_ALIGN  4096
+
+struct LZ4G_uring_s {
+    int    ringFd;
+    void*  sqRing;
+    size_t sqRingSize;
+    void*  cqRing;              /* == sqRing with IORING_FEAT_SINGLE_MMAP */
+    size_t cqRingSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned  sqMask;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned  cqMask;
+    struct io_uring_cqe* cqes;
+    int    registered;          /* buffers are registered : IORING_OP_WRITE_FIXED */
+    char*  buffers;             /* LZ4G_URING_DEPTH * LZ4G_URING_BUFSIZE */
+    /* current stream */
+    int    fd;
+    size_t size[LZ4G_URING_DEPTH];    /* bytes queued from each buffer; 0 : buffer is free */
+    off_t  offset[LZ4G_URING_DEPTH];
+    unsigned current;           /* buffer being filled */
+    size_t filled;
+    unsigned nbInFlight;
+    int    error;
+};
+
+#define LZ4G_URING_PTR(type, base, offset) ((type*)(void*)((char*)(base) + (offset)))
+
+static void LZ4G_uringFree(struct LZ4G_uring_s* u)
+{
+    if (u == NULL) return;
+    if (u->sqes) munmap(u->sqes, u->sqesSize);
+    if (u->cqRing && (u->cqRing != u->sqRing)) munmap(u->cqRing, u->cqRingSize);
+    if (u->sqRing) munmap(u->sqRing, u->sqRingSize);
+    if (u->ringFd >= 0) close(u->ringFd);   /* also unregisters buffers */
+    free(u->buffers);
+    free(u);
+}
 
-int LZ4G_decompressFramedFileStream(FILE* finput, FILE* foutput, char** errstring, int* nerrbytes)
+/* LZ4G_uringCreate() : result : NULL if io_uring is unavailable */
+static struct LZ4G_uring_s* LZ4G_uringCreate(void)
 {
-    unsigned long long filesize = 0, decodedSize=0;
-    clock_t start, end;
-    int decRes = 0;
+    struct LZ4G_uring_s* const u = (struct LZ4G_uring_s*)calloc(1, sizeof(*u));
+    struct io_uring_params p;
+    struct iovec iov[LZ4G_URING_DEPTH];
+    void* ptr;
+    unsigned i;
+
+    if (u == NULL) return NULL;
+    memset(&p, 0, sizeof(p));
+    u->ringFd = (int)syscall(__NR_io_uring_setup, LZ4G_URING_DEPTH, &p);
+    if (u->ringFd < 0) goto _fail;
+
+    /* Map rings */
+    u->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (u->cqRingSize > u->sqRingSize) u->sqRingSize = u->cqRingSize;
+        u->cqRingSize = u->sqRingSize;
+    }
+    ptr = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, u->ringFd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) goto _fail;
+    u->sqRing = ptr;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) u->cqRing = u->sqRing;
+    else
+    {
+        ptr = mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, u->ringFd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) goto _fail;
+        u->cqRing = ptr;
+    }
+    u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED, u->ringFd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) goto _fail;
+    u->sqes = (struct io_uring_sqe*)ptr;
+    u->sqTail  = LZ4G_URING_PTR(unsigned, u->sqRing, p.sq_off.tail);
+    u->sqArray = LZ4G_URING_PTR(unsigned, u->sqRing, p.sq_off.array);
+    u->sqMask  = *LZ4G_URING_PTR(unsigned, u->sqRing, p.sq_off.ring_mask);
+    u->cqHead  = LZ4G_URING_PTR(unsigned, u->cqRing, p.cq_off.head);
+    u->cqTail  = LZ4G_URING_PTR(unsigned, u->cqRing, p.cq_off.tail);
+    u->cqMask  = *LZ4G_URING_PTR(unsigned, u->cqRing, p.cq_off.ring_mask);
+    u->cqes    = LZ4G_URING_PTR(struct io_uring_cqe, u->cqRing, p.cq_off.cqes);
+
+    /* Buffers; registration can be refused (RLIMIT_MEMLOCK), plain writes (Linux 5.6+) are used then */
+    if (posix_memalign(&ptr, LZ4G_DIRECT_ALIGN, LZ4G_URING_DEPTH * LZ4G_URING_BUFSIZE)) goto _fail;
+    u->buffers = (char*)ptr;
+    for (i=0; i<LZ4G_URING_DEPTH; i++)
+    {
+        iov[i].iov_base = u->buffers + i * LZ4G_URING_BUFSIZE;
+        iov[i].iov_len = LZ4G_URING_BUFSIZE;
+    }
+    u->registered = (syscall(__NR_io_uring_register, u->ringFd, IORING_REGISTER_BUFFERS, iov, LZ4G_URING_DEPTH) == 0);
+    if (!u->registered && !(p.features & IORING_FEAT_RW_CUR_POS)) goto _fail;   /* kernel older than IORING_OP_WRITE */
+    return u;
 
-    **errstring = '\0';
-    *nerrbytes = 0;
+_fail:
+    LZ4G_uringFree(u);
+    return NULL;
+}
 
-    /* Init */
-    start = clock();
+/* LZ4G_uringPwrite() : writes size bytes synchronously, for writes the ring did not take or completed short.
+ * result : 0 on success, 1 on write error (also reported into u->error) */
+static int LZ4G_uringPwrite(struct LZ4G_uring_s* u, const char* ptr, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t const written = pwrite(u->fd, ptr, size, offset);
+        if ((written < 0) && (errno == EINTR)) continue;
+        if (written <= 0) { u->error = 1; return 1; }
+        ptr += written; size -= (size_t)written; offset += written;
+    }
+    return 0;
+}
 
-    /* sparse file */
-    if (g_sparseFileSupport && foutput) { SET_SPARSE_FILE_MODE(foutput); }
+/* LZ4G_uringSubmit() : queues the write of the first size bytes of current buffer, and moves to next buffer.
+ * A write the kernel does not accept is withdrawn from the ring, and done with pwrite() instead :
+ * only accepted writes are counted in flight, so that LZ4G_uringDrain() never waits for anything else.
+ * result : 0 on success, 1 on error */
+static int LZ4G_uringSubmit(struct LZ4G_uring_s* u, off_t offset, size_t size)
+{
+    unsigned const idx = u->current;
+    unsigned const tail = *u->sqTail;
+    struct io_uring_sqe* const sqe = u->sqes + (tail & u->sqMask);
+    char* const buffer = u->buffers + idx * LZ4G_URING_BUFSIZE;
+    long r;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = u->registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = u->fd;
+    sqe->off = (unsigned long long)offset;
+    sqe->addr = (unsigned long long)(size_t)buffer;
+    sqe->len = (unsigned)size;
+    sqe->buf_index = (unsigned short)idx;
+    sqe->user_data = idx;
+    u->sqArray[tail & u->sqMask] = tail & u->sqMask;
+    __atomic_store_n(u->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    do r = syscall(__NR_io_uring_enter, u->ringFd, 1, 0, 0, NULL, 0);
+    while ((r < 0) && (errno == EINTR));
+
+    u->current = (idx + 1) % LZ4G_URING_DEPTH;
+    u->filled = 0;
+    if (r == 1)
+    {
+        u->size[idx] = size;
+        u->offset[idx] = offset;
+        u->nbInFlight++;
+        return u->error;
+    }
+    /* not consumed (no SQPOLL : the kernel only reads the ring within io_uring_enter()) */
+    __atomic_store_n(u->sqTail, tail, __ATOMIC_RELEASE);
+    LZ4G_uringPwrite(u, buffer, size, offset);
+    return u->error;
+}
 
-    /* Loop over multiple streams */
-    do
+/* LZ4G_uringReap() :
+ * collects completed writes, waiting for at least one if wait is set and writes are in flight;
+ * short writes are completed with pwrite().
+ * result : 0 on success, 1 if completions cannot be waited for. Write errors are reported into u->error */
+static int LZ4G_uringReap(struct LZ4G_uring_s* u, int wait)
+{
+    unsigned head = *u->cqHead;
+
+    if (wait && u->nbInFlight && (head == __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE)))
     {
-      decRes = LZ4G_selectDecoder(finput, foutput, &decodedSize, errstring, nerrbytes);
-      if (decRes != 0) {
-        return decRes;
-      }
-      if (decodedSize != ENDOFSTREAM)
-        filesize += decodedSize;
-    } while (decodedSize != ENDOFSTREAM);
+        long r;
+        do r = syscall(__NR_io_uring_enter, u->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        while ((r < 0) && (errno == EINTR));
+        if (r < 0) return 1;
+    }
+    while (head != __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE))
+    {
+        const struct io_uring_cqe* const cqe = u->cqes + (head & u->cqMask);
+        unsigned const idx = (unsigned)cqe->user_data;
+        if (cqe->res < 0) u->error = 1;
+        else if ((size_t)cqe->res < u->size[idx])
+            LZ4G_uringPwrite(u, u->buffers + idx * LZ4G_URING_BUFSIZE + cqe->res, u->size[idx] - (size_t)cqe->res, u->offset[idx] + cqe->res);
+        u->size[idx] = 0;
+        u->nbInFlight--;
+        head++;
+    }
+    __atomic_store_n(u->cqHead, head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* LZ4G_uringDrain() : waits for all queued writes; result : 0 on success, 1 on write error */
+static int LZ4G_uringDrain(struct LZ4G_uring_s* u)
+{
+    while (u->nbInFlight)
+        if (LZ4G_uringReap(u, 1)) return 1;
+    return u->error;
+}
 
-    /* Final Status */
-    end = clock();
+/* LZ4G_fdUringWrite() : copies data into buffers, queuing each full buffer; result : 0 on success, 1 on write error */
+static int LZ4G_fdUringWrite(LZ4G_fdWriter_t* w, const void* buffer, size_t size)
+{
+    struct LZ4G_uring_s* const u = w->uring;
+    const char* ptr = (const char*)buffer;
 
-    /* Close */
-    fclose(finput);
-    fclose(foutput);
+    while (size > 0)
+    {
+        size_t const toCopy = (size < LZ4G_URING_BUFSIZE - u->filled) ? size : LZ4G_URING_BUFSIZE - u->filled;
+        while (u->size[u->current])   /* buffer still in flight */
+            if (LZ4G_uringReap(u, 1)) return 1;
+        if (u->error) return 1;
+        memcpy(u->buffers + u->current * LZ4G_URING_BUFSIZE + u->filled, ptr, toCopy);
+        u->filled += toCopy;
+        ptr += toCopy;
+        size -= toCopy;
+        if (u->filled == LZ4G_URING_BUFSIZE)
+        {
+            if (LZ4G_uringSubmit(u, w->offset, LZ4G_URING_BUFSIZE)) return 1;
+            w->offset += LZ4G_URING_BUFSIZE;
+        }
+    }
+    return 0;
+}
 
-    /*  Error status = OK */
+#endif   /* LZ4G_URING */
+
+/* LZ4G_fdMapInput() :
+ * maps a regular file from its current position to its end.
+ * result : 0 on success, 1 if fd cannot be mapped (pipe, terminal, ...) */
+static int LZ4G_fdMapInput(int fd, LZ4G_fdMap_t* map)
+{
+    struct stat st;
+    off_t start;
+    void* base;
+
+    memset(map, 0, sizeof(*map));
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) return 1;
+    start = lseek(fd, 0, SEEK_CUR);
+    if ((start < 0) || (start > st.st_size)) return 1;
+    if ((unsigned long long)st.st_size > (size_t)-1) return 1;
+    map->mapSize = (size_t)st.st_size;
+    map->start = (size_t)start;
+    if (map->mapSize == map->start) { map->mapSize = 0; map->start = 0; return 0; }   /* empty input */
+    base = mmap(NULL, map->mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) return 1;
+    posix_madvise(base, map->mapSize, POSIX_MADV_SEQUENTIAL);
+    map->base = (const unsigned char*)base;
+    return 0;
+}
+
+/* LZ4G_fdUnmapInput() : releases the mapping, and leaves fd positioned after consumed input */
+static void LZ4G_fdUnmapInput(int fd, LZ4G_fdMap_t* map, size_t endPos)
+{
+    if (map->base == NULL) return;
+    munmap((void*)map->base, map->mapSize);
+    lseek(fd, (off_t)endPos, SEEK_SET);
+    map->base = NULL;
+}
+
+/* LZ4G_fdInitWriter() :
+ * a regular output file, outside of sparse mode, is written through the io_uring engine of ctx when available;
+ * direct selects O_DIRECT for it, when output starts on an aligned position.
+ * LZ4G_fdCloseWriter() must be called once done, whatever the result */
+static void LZ4G_fdInitWriter(LZ4G_ctx* ctx, LZ4G_fdWriter_t* w, int fd, int sparseMode, int direct)
+{
+    w->fd = fd;
+    w->offset = lseek(fd, 0, SEEK_CUR);
+    w->sparseMode = sparseMode && (w->offset >= 0);
+    w->pendingZero = 0;
+    w->fileSize = 0;
+    if (w->sparseMode)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0) w->fileSize = st.st_size;
+    }
+#if LZ4G_URING
+    w->uring = NULL;
+    w->fdFlags = -1;
+    {
+        struct stat st;
+        if (w->sparseMode || (w->offset < 0) || fstat(fd, &st) || !S_ISREG(st.st_mode)) return;
+    }
+    {
+        int const flags = fcntl(fd, F_GETFL);
+        if ((flags < 0) || (flags & O_APPEND)) return;   /* appends would land in completion order */
+        if (ctx->uring == NULL) ctx->uring = LZ4G_uringCreate();
+        if (ctx->uring == NULL) return;   /* io_uring unavailable : pwrite() */
+        w->uring = ctx->uring;
+        w->uring->fd = fd;
+        w->uring->filled = 0;
+        w->uring->error = 0;
+        if (direct && !(flags & O_DIRECT) && ((w->offset % LZ4G_DIRECT_ALIGN) == 0)
+          && (fcntl(fd, F_SETFL, flags | O_DIRECT) == 0))
+            w->fdFlags = flags;
+    }
+#else
+    (void)ctx; (void)direct;
+#endif
+}
+
+/* LZ4G_fdWriteAll() : result : 0 on success, 1 on write error */
+static int LZ4G_fdWriteAll(LZ4G_fdWriter_t* w, const void* buffer, size_t size)
+{
+    const char* ptr = (const char*)buffer;
+    while (size > 0)
+    {
+        ssize_t const written = (w->offset >= 0) ? pwrite(w->fd, ptr, size, w->offset) : write(w->fd, ptr, size);
+        if (written < 0) { if (errno == EINTR) continue; return 1; }
+        if (written == 0) return 1;
+        ptr += written;
+        size -= (size_t)written;
+        if (w->offset >= 0) w->offset += written;
+    }
+    return 0;
+}
+
+/* LZ4G_fdSkip() :
+ * skips size bytes of zeroes in sparse mode.
+ * Where output overwrites existing data, a hole is punched instead when the file system supports it,
+ * and zeroes are written otherwise. result : 0 on success, 1 on write error */
+static int LZ4G_fdSkip(LZ4G_fdWriter_t* w, const char* zeros, size_t size)
+{
+    if (w->offset < w->fileSize)
+    {
+        size_t const existing = ((unsigned long long)(w->fileSize - w->offset) < size) ? (size_t)(w->fileSize - w->offset) : size;
+#if LZ4G_FALLOCATE && defined(FALLOC_FL_PUNCH_HOLE)
+        if (fallocate(w->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, w->offset, (off_t)existing) == 0)
+            w->offset += (off_t)existing;
+        else
+#endif
+        if (LZ4G_fdWriteAll(w, zeros, existing)) return 1;
+        size -= existing;
+    }
+    w->offset += (off_t)size;
+    return 0;
+}
+
+/* LZ4G_fdWrite() :
+ * LZ4G_writeFunction writing one batch into a LZ4G_fdWriter_t.
+ * In sparse mode, leading zeroes of each 32 KB segment are skipped instead of written, leaving holes,
+ * to be completed by LZ4G_fdWriteEnd(); consecutive non-zero parts are written by a single pwrite() */
+static size_t LZ4G_fdWrite(void* opaque, const void* buffer, size_t size)
+{
+    LZ4G_fdWriter_t* const w = (LZ4G_fdWriter_t*)opaque;
+    const char* ptr = (const char*)buffer;
+    const char* const end = ptr + size;
+    const char* extent = NULL;   /* start of data not written yet */
+
+#if LZ4G_URING
+    if (w->uring) return LZ4G_fdUringWrite(w, buffer, size) ? 0 : size;
+#endif
+    if (!w->sparseMode) return LZ4G_fdWriteAll(w, buffer, size) ? 0 : size;
+
+    while (ptr < end)
+    {
+        size_t const segSize = ((size_t)(end-ptr) < LZ4G_SPARSE_SEGMENT) ? (size_t)(end-ptr) : LZ4G_SPARSE_SEGMENT;
+        size_t const nb0 = LZ4G_zeroPrefix(ptr, segSize);
+        if (nb0)
+        {
+            if (extent && LZ4G_fdWriteAll(w, extent, (size_t)(ptr - extent))) return 0;
+            extent = NULL;
+            if (LZ4G_fdSkip(w, ptr, nb0)) return 0;
+            w->pendingZero = 1;
+        }
+        if (nb0 < segSize)
+        {
+            if (extent == NULL) extent = ptr + nb0;
+            w->pendingZero = 0;
+        }
+        ptr += segSize;
+    }
+    if (extent && LZ4G_fdWriteAll(w, extent, (size_t)(end - extent))) return 0;
+    return size;
+}
+
+/* LZ4G_fdCloseWriter() :
+ * completes queued writes (the unaligned end of output after leaving O_DIRECT), and restores fd flags.
+ * result : 0 on success, 1 on write error */
+static int LZ4G_fdCloseWriter(LZ4G_fdWriter_t* w)
+{
+#if LZ4G_URING
+    struct LZ4G_uring_s* const u = w->uring;
+    unsigned const idx = u ? u->current : 0;
+    size_t const filled = u ? u->filled : 0;
+    size_t const tail = (w->fdFlags >= 0) ? filled % LZ4G_DIRECT_ALIGN : 0;
+    int error = 0;
+
+    if (u == NULL) return 0;
+    w->uring = NULL;
+    if ((filled > tail) && !u->error)
+    {
+        error = LZ4G_uringSubmit(u, w->offset, filled - tail);
+        w->offset += (off_t)(filled - tail);
+    }
+    error |= LZ4G_uringDrain(u);
+    u->filled = 0;
+    if (w->fdFlags >= 0)
+    {
+        error |= (fcntl(w->fd, F_SETFL, w->fdFlags) != 0);
+        w->fdFlags = -1;
+    }
+    if (!error && tail) error = LZ4G_fdWriteAll(w, u->buffers + idx * LZ4G_URING_BUFSIZE + (filled - tail), tail);
+    return error;
+#else
+    (void)w;
+    return 0;
+#endif
+}
+
+/* LZ4G_fdWriteEnd() : completes output, writing the last zero byte of a trailing hole, and leaves fd positioned after output */
+static int LZ4G_fdWriteEnd(LZ4G_fdWriter_t* w, char** errstring, int* nerrbytes)
+{
+    if (LZ4G_fdCloseWriter(w)) LZ4G_RETURN_ERROR(72, "Write error : cannot complete output");
+    if (w->pendingZero)
+    {
+        static const char lastZero = 0;
+        w->offset--;
+        if (LZ4G_fdWriteAll(w, &lastZero, 1)) LZ4G_RETURN_ERROR(72, "Write error : cannot write last zero");
+        w->pendingZero = 0;
+    }
+    if ((w->offset >= 0) && (lseek(w->fd, w->offset, SEEK_SET) < 0)) LZ4G_RETURN_ERROR(72, "Seek error : cannot position output");
     return 0;
 }
 
+/* LZ4G_fdFallback() : streams which can't use the mapped path go through the FILE* API, on duplicated descriptors */
+static int LZ4G_fdFallback(LZ4G_ctx* ctx, int fdin, int fdout, int compressionLevel, int decompress, char** errstring, int* nerrbytes)
+{
+    int const fdi = dup(fdin);
+    int const fdo = dup(fdout);
+    FILE* const finput  = (fdi >= 0) ? fdopen(fdi, "rb") : NULL;
+    FILE* const foutput = (fdo >= 0) ? fdopen(fdo, "wb") : NULL;
+    int result;
+
+    if ((finput == NULL) || (foutput == NULL))
+    {
+        if (finput) fclose(finput); else if (fdi >= 0) close(fdi);
+        if (foutput) fclose(foutput); else if (fdo >= 0) close(fdo);
+        LZ4G_RETURN_ERROR(70, "Error : cannot duplicate file descriptors");
+    }
+    if (decompress)
+        result = LZ4G_decompressFramedFileStream_withCtx(ctx, finput, foutput, errstring, nerrbytes);
+    else
+        result = LZ4G_compressFramedFileStream_withCtx(ctx, finput, foutput, compressionLevel, errstring, nerrbytes);
+    fclose(finput);
+    if ((fclose(foutput) != 0) && (result == 0)) LZ4G_RETURN_ERROR(71, "Write error : cannot flush output");
+    return result;
+}
+
+
+int LZ4G_compressFd_withCtx(LZ4G_ctx* ctx, int fdin, int fdout, int compressionLevel, char** errstring, int* nerrbytes)
+{
+    LZ4G_fdMap_t map;
+    LZ4G_fdWriter_t writer;
+    LZ4F_preferences_t prefs;
+    LZ4F_compressOptions_t options;
+    LZ4G_seekTable_t* const seekTable = (ctx->params.seekable && ctx->params.blockIndependence) ? &ctx->seekTable : NULL;
+    size_t blockSize, outBuffSize, filled, pos, frameHeaderSize;
+    size_t zeroBlockSize = 0;
+    unsigned long long dataEnd = 0;
+    char* out_buff;
+    char* zeroBlock;
+    int zeroed = 0;   /* ctx->inBuff holds a block of zeroes */
+    int errorNb = 0;
+    const char* errorMsg = "";
+
+    /* Multi-threaded compression, and inputs which can't be mapped, use the FILE* path */
+    if (((ctx->params.nbThreads > 1) && ctx->params.blockIndependence) || LZ4G_fdMapInput(fdin, &map))
+        return LZ4G_fdFallback(ctx, fdin, fdout, compressionLevel, 0, errstring, nerrbytes);
+
+    /* Init */
+    errorNb = LZ4G_initCctx(ctx, errstring, nerrbytes);
+    if (errorNb) { LZ4G_fdUnmapInput(fdin, &map, map.start); return errorNb; }
+    blockSize = (size_t)LZ4G_GetBlockSize_FromBlockId(ctx->params.blockSizeID);
+    LZ4G_initPrefs(ctx, &prefs, compressionLevel, map.mapSize - map.start);
+    memset(&options, 0, sizeof(options));
+    options.stableSrc = 1;   /* mapping remains valid : linked blocks reference it directly */
+    LZ4G_fdInitWriter(ctx, &writer, fdout, 0, 0);
+    pos = map.start;
+
+    /* Output batch buffer; input is read from the mapping, without copy.
+     * With independent blocks, holes of sparse inputs are compressed from a block of zeroes instead, kept within inBuff,
+     * and the compressed block of zeroes is kept after the batch buffer, to be re-used */
+    outBuffSize = LZ4G_OUTBATCH + LZ4F_compressBound(blockSize, &prefs);
+    if (!ctx->params.blockIndependence) dataEnd = (unsigned long long)-1;
+    if (LZ4G_reserveBuffers(ctx, ctx->params.blockIndependence ? blockSize : 0, outBuffSize + (ctx->params.blockIndependence ? LZ4F_compressBound(blockSize, &prefs) : 0)))
+        { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+    out_buff = (char*)ctx->outBuff;
+    zeroBlock = out_buff + outBuffSize;
+
+    /* Write Archive Header */
+    filled = LZ4F_compressBegin_usingCDict(ctx->cctx, out_buff, outBuffSize, ctx->cdict, &prefs);
+    if (LZ4F_isError(filled)) { errorNb = 32; errorMsg = LZ4F_getErrorName(filled); goto _end; }
+    frameHeaderSize = filled;
+    if (LZ4G_seekTableStart(seekTable)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+
+    /* Main Loop : one block per call, straight from the mapping */
+    for ( ; pos < map.mapSize; pos += blockSize)
+    {
+        size_t const srcSize = (map.mapSize - pos < blockSize) ? map.mapSize - pos : blockSize;
+        size_t outSize;
+        if ((srcSize == blockSize) && LZ4G_holeAt(fdin, pos, blockSize, &dataEnd))
+        {
+            if (!zeroed) { memset(ctx->inBuff, 0, blockSize); zeroed = 1; }
+            if (zeroBlockSize)
+                outSize = LZ4F_insertBlock(ctx->cctx, out_buff + filled, outBuffSize - filled, ctx->inBuff, blockSize, zeroBlock, zeroBlockSize);
+            else
+            {
+                outSize = LZ4F_compressUpdate(ctx->cctx, out_buff + filled, outBuffSize - filled, ctx->inBuff, blockSize, &options);
+                if (!LZ4F_isError(outSize)) { memcpy(zeroBlock, out_buff + filled, outSize); zeroBlockSize = outSize; }
+            }
+        }
+        else
+            outSize = LZ4F_compressUpdate(ctx->cctx, out_buff + filled, outBuffSize - filled, map.base + pos, srcSize, &options);
+        if (LZ4F_isError(outSize)) { errorNb = 34; errorMsg = LZ4F_getErrorName(outSize); goto _end; }
+        if (LZ4G_seekTableAdd(seekTable, outSize, srcSize)) { errorNb = 31; errorMsg = "Allocation error : not enough memory"; goto _end; }
+        filled += outSize;
+        if (filled >= LZ4G_OUTBATCH)
+        {
+            if (LZ4G_fdWrite(&writer, out_buff, filled) != filled) { errorNb = 35; errorMsg = "Write error : cannot write compressed block"; goto _end; }
+            filled = 0;
+        }
+    }
+
+    /* End of Stream mark */
+    {
+        size_t const endSize = LZ4F_compressEnd(ctx->cctx, out_buff + filled, outBuffSize - filled, NULL);
+        if (LZ4F_isError(endSize)) { errorNb = 36; errorMsg = LZ4F_getErrorName(endSize); goto _end; }
+        filled += endSize;
+    }
+    if (LZ4G_fdWrite(&writer, out_buff, filled) != filled) { errorNb = 37; errorMsg = "Write error : cannot write end of stream"; goto _end; }
+
+    /* Block index */
+    filled = LZ4G_seekTableFinish(seekTable, frameHeaderSize, ctx->params.streamChecksum);
+    if (filled && (LZ4G_fdWrite(&writer, seekTable->buffer, filled) != filled))
+        { errorNb = 39; errorMsg = "Write error : cannot write block index"; goto _end; }
+
+_end:
+    LZ4G_fdUnmapInput(fdin, &map, errorNb ? map.start : map.mapSize);
+    if (errorNb)
+    {
+        LZ4G_fdCloseWriter(&writer);
+        LZ4G_RETURN_ERROR_DOTS(errorNb, "%s", errorMsg);
+    }
+    return LZ4G_fdWriteEnd(&writer, errstring, nerrbytes);
+}
+
+
+int LZ4G_decompressFd_withCtx(LZ4G_ctx* ctx, int fdin, int fdout, char** errstring, int* nerrbytes)
+{
+    LZ4G_fdMap_t map;
+    LZ4G_fdWriter_t writer;
+    LZ4G_window_t window;
+    LZ4G_io_t out;
+    int result;
+
+    **errstring = '\0';
+
+    /* Multi-threaded decompression, and inputs which can't be mapped, use the FILE* path */
+    if ((ctx->params.nbThreads > 1) || LZ4G_fdMapInput(fdin, &map))
+        return LZ4G_fdFallback(ctx, fdin, fdout, 0, 1, errstring, nerrbytes);
+
+    /* Frames are parsed straight from the mapping */
+    memset(&window, 0, sizeof(window));
+    window.src = map.base + map.start;
+    window.srcSize = map.mapSize - map.start;
+    window.eof = 1;
+    LZ4G_fdInitWriter(ctx, &writer, fdout, ctx->params.sparseFileSupport, ctx->params.directIO);
+    memset(&out, 0, sizeof(out));
+    out.write = LZ4G_fdWrite;
+    out.writeOpaque = &writer;
+
+    result = LZ4G_windowDecode(ctx, &window, &out, errstring, nerrbytes);
+    LZ4G_fdUnmapInput(fdin, &map, map.start + (size_t)window.consumed);
+    if (result) { LZ4G_fdCloseWriter(&writer); return result; }
+    return LZ4G_fdWriteEnd(&writer, errstring, nerrbytes);
+}
+
+#endif   /* LZ4G_FDAPI */
@@ -57,6 +57,169 @@ extern "C" {
 int LZ4G_compressFramedFileStream(FILE* finput, FILE* foutput, int compressionLevel, char** errstring, int* nerrbytes);
 int LZ4G_decompressFramedFileStream(FILE* finput, FILE* foutput, char** errstring, int* nerrbytes);
 
+/* LZ4G_freePool() :
+ * The two functions above draw their context and buffers from an internal thread-safe pool,
+ * so that successive streams do not allocate memory.
+ * LZ4G_freePool() releases idle pooled contexts; it is safe to call at any time. */
+void LZ4G_freePool(void);
+
+/* LZ4G_setNbThreads() :
+ * Number of threads used by LZ4G_compressFramedFileStream() for independent-block frames.
+ * The frame produced is byte-identical to the single-threaded one.
+ * Default : 1 (single-threaded). 0 means one thread per online core.
+ * Returns the number of threads actually selected (always 1 if built without LZ4G_MULTITHREAD). */
+int LZ4G_setNbThreads(int nbThreads);
+
+
+/**************************************
+ * Reentrant API
+ * ************************************/
+typedef enum { LZ4G_blockLinked=0, LZ4G_blockIndependent } LZ4G_blockMode_t;
+
+typedef struct {
+  int overwrite;           /* 1 : pass through data which is not lz4 (default) */
+  int blockSizeID;         /* 4-7 : 64 KB, 256 KB, 1 MB, 4 MB (default : 7) */
+  int blockChecksum;       /* 0 : disabled (default), 1 : each block is followed by its XXH32, verified before it is decoded */
+  int streamChecksum;      /* 1 : enabled (default) */
+  int blockIndependence;   /* 1 : LZ4G_blockIndependent (default), 0 : LZ4G_blockLinked */
+  int sparseFileSupport;   /* 0 : disabled (default) */
+  int contentSize;         /* 0 : disabled (default), 1 : size of regular file inputs is written into frame header */
+  int nbThreads;           /* 1 : single-threaded (default), 0 : one thread per online core */
+  int asyncIO;             /* 0 : disabled (default), 1 : compression reads and writes in 2 threads of their own, overlapping compression */
+  int directIO;            /* 0 : disabled (default), 1 : LZ4G_decompressFd_withCtx() writes aligned output with O_DIRECT (Linux, io_uring) */
+  int seekable;            /* 0 : disabled (default), 1 : independent-block frames are followed by their block index, for LZ4G_readRange() */
+} LZ4G_params_t;
+
+typedef struct LZ4G_ctx_s LZ4G_ctx;
+
+/* LZ4G_createCtx() :
+ * A context keeps its own parameters, LZ4F contexts and I/O buffers,
+ * which are re-used by every stream it (de)compresses.
+ * paramsPtr==NULL selects the current defaults, as set by the LZ4G_set*() functions below.
+ * Returns NULL on allocation failure or invalid parameters.
+ * A context must only be used by one thread at a time; distinct contexts can run concurrently. */
+LZ4G_ctx* LZ4G_createCtx(const LZ4G_params_t* paramsPtr);
+void      LZ4G_freeCtx(LZ4G_ctx* ctx);
+int       LZ4G_setCtxParams(LZ4G_ctx* ctx, const LZ4G_params_t* params);   /* 0 on success, -1 on invalid blockSizeID */
+void      LZ4G_getCtxParams(const LZ4G_ctx* ctx, LZ4G_params_t* params);
+
+/* Same as above, but using ctx parameters and resources.
+ * Files are not closed. A context remains usable after an error. */
+int LZ4G_compressFramedFileStream_withCtx(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, int compressionLevel, char** errstring, int* nerrbytes);
+int LZ4G_decompressFramedFileStream_withCtx(LZ4G_ctx* ctx, FILE* finput, FILE* foutput, char** errstring, int* nerrbytes);
+
+/* Buffer variants, for payloads which fit in memory :
+ * one frame is compressed from src into dst, or decompressed from src into dst.
+ * Frames record their content size (unless src is empty), so that LZ4G_getFrameContentSize() gives
+ * the exact dst size needed for decompression. dstCapacity for compression must be
+ * >= LZ4G_compressFrameBound(). Result size is written into *dstSize.
+ * Once ctx has been used, these functions do not allocate memory. */
+size_t LZ4G_compressFrameBound(const LZ4G_ctx* ctx, size_t srcSize);
+int LZ4G_compressFrameToBuffer(LZ4G_ctx* ctx, void* dst, size_t dstCapacity, size_t* dstSize,
+                               const void* src, size_t srcSize, int compressionLevel,
+                               char** errstring, int* nerrbytes);
+int LZ4G_decompressFrameToBuffer(LZ4G_ctx* ctx, void* dst, size_t dstCapacity, size_t* dstSize,
+                                 const void* src, size_t srcSize,
+                                 char** errstring, int* nerrbytes);
+/* LZ4G_getFrameContentSize() : 0 on success, 1 if src does not start with a frame header recording its content size */
+int LZ4G_getFrameContentSize(const void* src, size_t srcSize, unsigned long long* contentSize);
+
+/* Callback variants :
+ * LZ4G_readFunction fills buffer with up to size bytes, and returns the nb of bytes read,
+ * 0 at end of input, or (size_t)-1 on error. It may return less than size before end of input.
+ * LZ4G_writeFunction consumes size bytes, and returns the nb of bytes written;
+ * anything less than size is an error.
+ * Data can then stream between in-memory buffers, without system calls.
+ * Decompression reads ahead : input following the last recognized stream is consumed.
+ * Sparse output is not available, and decompression is single-threaded.
+ * With asyncIO, compression calls readFunction and writeFunction from 2 internal threads
+ * (each function always from the same thread). */
+typedef size_t (*LZ4G_readFunction)(void* opaque, void* buffer, size_t size);
+typedef size_t (*LZ4G_writeFunction)(void* opaque, const void* buffer, size_t size);
+
+int LZ4G_compressStream_withCtx(LZ4G_ctx* ctx, LZ4G_readFunction readFunction, void* readOpaque,
+                                LZ4G_writeFunction writeFunction, void* writeOpaque,
+                                int compressionLevel, char** errstring, int* nerrbytes);
+int LZ4G_decompressStream_withCtx(LZ4G_ctx* ctx, LZ4G_readFunction readFunction, void* readOpaque,
+                                  LZ4G_writeFunction writeFunction, void* writeOpaque,
+                                  char** errstring, int* nerrbytes);
+
+/* File descriptor variants (POSIX only, unless LZ4G_FDAPI is set to 0) :
+ * a regular input file is memory-mapped from its current position, so blocks are compressed,
+ * or frames parsed, straight from the page cache. Output is written by large batches,
+ * using pwrite() when fdout is seekable. On Linux, batches written into a regular file
+ * are queued through io_uring, so that many writes are in flight (pwrite() remains the fallback).
+ * Other inputs (pipes, ...) and multi-threaded contexts go through the FILE* functions above.
+ * Descriptors are not closed; they are left positioned after consumed input and written output. */
+int LZ4G_compressFd_withCtx(LZ4G_ctx* ctx, int fdin, int fdout, int compressionLevel, char** errstring, int* nerrbytes);
+int LZ4G_decompressFd_withCtx(LZ4G_ctx* ctx, int fdin, int fdout, char** errstring, int* nerrbytes);
+
+/* Sparse file writer, as used by the decoders above when sparse mode is enabled :
+ * runs of zeroes are skipped with fseek() instead of written, leaving holes.
+ * Zeroes are detected with AVX2 when the CPU supports it (selected at runtime on x86 with GCC,
+ * see LZ4_limitCpuFeatures()), or else with the widest vector unit of the build target.
+ * *storedSkips accumulates pending skips (start at 0); LZ4G_sparseWriteEnd() must be called
+ * once output is complete, so that the file gets its final size. Both return 0 on success, 1 on error. */
+int LZ4G_sparseWrite(FILE* file, const void* buffer, size_t size, unsigned long long* storedSkips);
+int LZ4G_sparseWriteEnd(FILE* file, unsigned long long storedSkips);
+
+/* Sparse file reader, as used by the compressors above :
+ * LZ4G_skipHole() returns 1 when the next size bytes of finput all lie within a hole of a sparse regular file,
+ * after skipping them without reading; the caller then compresses zeroes instead. Otherwise, returns 0, finput unchanged.
+ * *dataEnd is a cache for successive calls on the same input (start at 0) : dense files cost no system call after the first one. */
+int LZ4G_skipHole(FILE* finput, size_t size, unsigned long long* dataEnd);
+
+/* Seekable frames :
+ * with the seekable parameter, compression of independent blocks appends a skippable frame after each frame,
+ * indexing the compressed position and decoded size of its blocks. Decoders ignore it, as any skippable frame.
+ * LZ4G_readRange() decodes up to size bytes from uncompressed position offset of the last frame of finput
+ * (a regular file), into dst, reading and decoding only the blocks containing the range.
+ * The nb of bytes decoded is written into *readSize : less than size only at end of content. */
+int LZ4G_readRange(LZ4G_ctx* ctx, FILE* finput, unsigned long long offset, void* dst, size_t size, size_t* readSize,
+                   char** errstring, int* nerrbytes);
+
+/* Random-access reader :
+ * for repeated reads into the same seekable file, the block index is loaded once, and recently decoded blocks
+ * are kept in a LRU cache of up to cacheSize bytes (0 disables it). finput must remain open until LZ4G_freeReader().
+ * LZ4G_readerRead() behaves as LZ4G_readRange(), and can be called concurrently from several threads
+ * on the same reader (unless built without LZ4G_MULTITHREAD), which then share the cache. */
+typedef struct LZ4G_reader_s LZ4G_reader;
+
+int  LZ4G_createReader(LZ4G_reader** readerPtr, FILE* finput, size_t cacheSize, char** errstring, int* nerrbytes);
+void LZ4G_freeReader(LZ4G_reader* reader);
+unsigned long long LZ4G_readerContentSize(const LZ4G_reader* reader);
+int  LZ4G_readerRead(LZ4G_reader* reader, unsigned long long offset, void* dst, size_t size, size_t* readSize,
+                     char** errstring, int* nerrbytes);
+/* LZ4G_readerLoadDictionary() : dictionary of the frame, as given to LZ4G_loadDictionary() for its compression.
+ * Call it before any LZ4G_readerRead(). Returns 0 on success, -1 on allocation failure. */
+int  LZ4G_readerLoadDictionary(LZ4G_reader* reader, const void* dict, size_t dictSize);
+
+/* Dictionaries :
+ * LZ4G_loadDictionary() makes every frame compressed or decompressed with ctx reference dict,
+ * which greatly improves the compression of small payloads sharing contents with it (records, messages).
+ * ctx keeps its own copy of dict (only its last 64 KB are used), until it is replaced or removed (dict==NULL).
+ * A non-zero dictID is recorded into frame headers : decompression then fails (error 64) on frames
+ * recording another dictID, or when ctx has no dictionary. Returns 0 on success, -1 on allocation failure. */
+int LZ4G_loadDictionary(LZ4G_ctx* ctx, const void* dict, size_t dictSize, unsigned dictID);
+/* LZ4G_getFrameDictID() : 0 on success, 1 if src does not start with a frame header recording a dictionary ID */
+int LZ4G_getFrameDictID(const void* src, size_t srcSize, unsigned* dictID);
+
+
+/**************************************
+ * Defaults of the API above and of LZ4G_createCtx(NULL).
+ * These set process-wide state : call them before starting any thread.
+ * ************************************/
+int LZ4G_setOverwrite(int yes);
+int LZ4G_setBlockSizeID(int bsid);             /* returns block size, or -1 if bsid is invalid */
+int LZ4G_setBlockMode(LZ4G_blockMode_t blockMode);
+int LZ4G_setBlockChecksumMode(int xxhash);
+int LZ4G_setStreamChecksumMode(int xxhash);
+int LZ4G_setSparseFile(int enable);
+int LZ4G_setContentSize(int enable);
+int LZ4G_setAsyncIO(int enable);
+int LZ4G_setDirectIO(int enable);
+int LZ4G_setSeekable(int enable);
+
 
 #if defined (__cplusplus)
 }
@@ -240,12 +240,7 @@ FORCE_INLINE int LZ4HC_InsertAndGetWiderMatch (
                 if (LZ4_read32(matchPtr) == LZ4_read32(ip))
                 {
                     int mlt = MINMATCH + LZ4_count(ip+MINMATCH, matchPtr+MINMATCH, iHighLimit);
-                    int back = 0;
-
-                    while ((ip+back>iLowLimit)
-                           && (matchPtr+back > lowPrefixPtr)
-                           && (ip[back-1] == matchPtr[back-1]))
-                            back--;
+                    int const back = -(int)LZ4_countBack(ip, matchPtr, iLowLimit, lowPrefixPtr);
 
                     mlt -= back;
 
@@ -263,13 +258,13 @@ FORCE_INLINE int LZ4HC_InsertAndGetWiderMatch (
             if (LZ4_read32(matchPtr) == LZ4_read32(ip))
             {
                 size_t mlt;
-                int back=0;
+                int back;
                 const BYTE* vLimit = ip + (dictLimit - matchIndex);
                 if (vLimit > iHighLimit) vLimit = iHighLimit;
                 mlt = LZ4_count(ip+MINMATCH, matchPtr+MINMATCH, vLimit) + MINMATCH;
                 if ((ip+mlt == vLimit) && (vLimit < iHighLimit))
                     mlt += LZ4_count(ip+mlt, base+dictLimit, iHighLimit);
-                while ((ip+back > iLowLimit) && (matchIndex+back > lowLimit) && (ip[back-1] == matchPtr[back-1])) back--;
+                back = -(int)LZ4_countBack(ip, matchPtr, iLowLimit, dictBase + lowLimit);
                 mlt -= back;
                 if ((int)mlt > longest) { longest = (int)mlt; *matchpos = base + matchIndex + back; *startpos = ip+back; }
             }
@@ -332,7 +327,7 @@ FORCE_INLINE int LZ4HC_encodeSequence (
 }
 
 
-static int LZ4HC_compress_generic (
+FORCE_INLINE int LZ4HC_compress_kernel (
     void* ctxvoid,
     const char* source,
     char* dest,
@@ -535,6 +530,25 @@ _Search3:
     return (int) (((char*)op)-dest);
 }
 
+/* the match finder is compiled once per supported instruction set (see LZ4_DISPATCH in lz4.c) */
+#if LZ4_COMPRESS_AVX2
+LZ4_TARGET_AVX2 static int LZ4HC_compress_avx2 (void* ctxvoid, const char* source, char* dest, int inputSize,
+                                                int maxOutputSize, int compressionLevel, limitedOutput_directive limit)
+{
+    return LZ4HC_compress_kernel(ctxvoid, source, dest, inputSize, maxOutputSize, compressionLevel, limit);
+}
+#endif
+
+static int LZ4HC_compress_generic (void* ctxvoid, const char* source, char* dest, int inputSize,
+                                   int maxOutputSize, int compressionLevel, limitedOutput_directive limit)
+{
+#if LZ4_COMPRESS_AVX2
+    if ((LZ4_cpuFeatures() & LZ4_KERNEL_AVX2) == LZ4_KERNEL_AVX2)
+        return LZ4HC_compress_avx2(ctxvoid, source, dest, inputSize, maxOutputSize, compressionLevel, limit);
+#endif
+    return LZ4HC_compress_kernel(ctxvoid, source, dest, inputSize, maxOutputSize, compressionLevel, limit);
+}
+
 
 int LZ4_compressHC2(const char* source, char* dest, int inputSize, int compressionLevel)
 {
@@ -603,6 +617,30 @@ void LZ4_resetStreamHC (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel)
     ((LZ4HC_Data_Structure*)LZ4_streamHCPtr)->compressionLevel = (unsigned)compressionLevel;
 }
 
+void LZ4_resetStreamHC_fast (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel)
+{
+    LZ4HC_Data_Structure* const ctxPtr = (LZ4HC_Data_Structure*)LZ4_streamHCPtr;
+    if ((ctxPtr->base == NULL) || ((size_t)(ctxPtr->end - ctxPtr->base) > 1 GB))   /* not started, or close to index overflow */
+    {
+        LZ4_resetStreamHC(LZ4_streamHCPtr, compressionLevel);
+        return;
+    }
+    /* Tables are kept : all positions they contain are below endIndex, which becomes the lowest reachable position.
+       Chains of new positions are rewritten as they are inserted, so they never lead to stale ones */
+    {
+        U32 const endIndex = (U32)(ctxPtr->end - ctxPtr->base);
+        ctxPtr->dictLimit = endIndex;
+        ctxPtr->lowLimit = endIndex;
+        ctxPtr->nextToUpdate = endIndex;
+        ctxPtr->compressionLevel = (unsigned)compressionLevel;
+    }
+}
+
+void LZ4_setCompressionLevelHC (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel)
+{
+    ((LZ4HC_Data_Structure*)LZ4_streamHCPtr)->compressionLevel = (unsigned)compressionLevel;
+}
+
 int LZ4_loadDictHC (LZ4_streamHC_t* LZ4_streamHCPtr, const char* dictionary, int dictSize)
 {
     LZ4HC_Data_Structure* ctxPtr = (LZ4HC_Data_Structure*) LZ4_streamHCPtr;
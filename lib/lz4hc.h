@@ -135,6 +135,7 @@ to avoid size mismatch between different versions.
 */
 
 void LZ4_resetStreamHC (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel);
+void LZ4_resetStreamHC_fast (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel);
 int  LZ4_loadDictHC (LZ4_streamHC_t* LZ4_streamHCPtr, const char* dictionary, int dictSize);
 
 int LZ4_compressHC_continue (LZ4_streamHC_t* LZ4_streamHCPtr, const char* source, char* dest, int inputSize);
@@ -142,6 +143,8 @@ int LZ4_compressHC_limitedOutput_continue (LZ4_streamHC_t* LZ4_streamHCPtr, cons
 
 int LZ4_saveDictHC (LZ4_streamHC_t* LZ4_streamHCPtr, char* safeBuffer, int maxDictSize);
 
+void LZ4_setCompressionLevelHC (LZ4_streamHC_t* LZ4_streamHCPtr, int compressionLevel);
+
 /*
 These functions compress data in successive blocks of any size, using previous blocks as dictionary.
 One key assumption is that each previous block will remain read-accessible while compressing next block.
@@ -156,6 +159,15 @@ Previous memory blocks (including initial dictionary when present) must remain a
 If, for any reason, previous data block can't be preserved in memory during next compression block,
 you must save it to a safer memory space,
 using LZ4_saveDictHC().
+
+LZ4_resetStreamHC_fast() starts a new independent stream, like LZ4_resetStreamHC(),
+but keeps the tables of a stream already started, and only makes their content unreachable.
+The stream must already have been initialized, by LZ4_resetStreamHC() or LZ4_createStreamHC().
+LZ4_resetStreamHC() is cheap, but the next block then clears 256 KB of tables ; after LZ4_resetStreamHC_fast(), it does not.
+This makes re-using a stream for many small inputs nearly free.
+
+LZ4_setCompressionLevelHC() changes the compression level of next blocks, keeping stream history.
+It allows a stream loaded with a dictionary once to be copied (memcpy) for each new compression, at any level.
 */
 
 
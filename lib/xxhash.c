@@ -254,6 +254,41 @@ FORCE_INLINE U64 XXH_readLE64(const void* ptr, XXH_endianess endian)
 }
 
 
+/****************************
+*  Stripe rounds
+*****************************/
+/*
+ * XXH_NO_VECTORIZE :
+ * compilers see the 4 accumulators as a vector, and auto-vectorize the rounds.
+ * On x86, this is much slower : SSE2 has no 32-bits multiply (it gets emulated with pmuludq),
+ * and pmulld (SSE4.1) or vpmullq (AVX-512) latency sits on the dependency chain of each accumulator.
+ * An empty asm statement hides the accumulator from the vectorizer, so rounds remain scalar.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#  define XXH_NO_VECTORIZE(acc)   __asm__("" : "+r" (acc))
+#else
+#  define XXH_NO_VECTORIZE(acc)
+#endif
+
+FORCE_INLINE U32 XXH32_round(U32 acc, U32 input)
+{
+    acc += input * PRIME32_2;
+    acc  = XXH_rotl32(acc, 13);
+    acc *= PRIME32_1;
+    XXH_NO_VECTORIZE(acc);
+    return acc;
+}
+
+FORCE_INLINE U64 XXH64_round(U64 acc, U64 input)
+{
+    acc += input * PRIME64_2;
+    acc  = XXH_rotl64(acc, 31);
+    acc *= PRIME64_1;
+    XXH_NO_VECTORIZE(acc);
+    return acc;
+}
+
+
 /****************************
 *  Simple Hash Functions
 *****************************/
@@ -282,21 +317,13 @@ FORCE_INLINE U32 XXH32_endian_align(const void* input, size_t len, U32 seed, XXH
 
         do
         {
-            v1 += XXH_get32bits(p) * PRIME32_2;
-            v1 = XXH_rotl32(v1, 13);
-            v1 *= PRIME32_1;
+            v1 = XXH32_round(v1, XXH_get32bits(p));
             p+=4;
-            v2 += XXH_get32bits(p) * PRIME32_2;
-            v2 = XXH_rotl32(v2, 13);
-            v2 *= PRIME32_1;
+            v2 = XXH32_round(v2, XXH_get32bits(p));
             p+=4;
-            v3 += XXH_get32bits(p) * PRIME32_2;
-            v3 = XXH_rotl32(v3, 13);
-            v3 *= PRIME32_1;
+            v3 = XXH32_round(v3, XXH_get32bits(p));
             p+=4;
-            v4 += XXH_get32bits(p) * PRIME32_2;
-            v4 = XXH_rotl32(v4, 13);
-            v4 *= PRIME32_1;
+            v4 = XXH32_round(v4, XXH_get32bits(p));
             p+=4;
         }
         while (p<=limit);
@@ -387,22 +414,14 @@ FORCE_INLINE U64 XXH64_endian_align(const void* input, size_t len, U64 seed, XXH
 
         do
         {
-            v1 += XXH_get64bits(p) * PRIME64_2;
+            v1 = XXH64_round(v1, XXH_get64bits(p));
             p+=8;
-            v1 = XXH_rotl64(v1, 31);
-            v1 *= PRIME64_1;
-            v2 += XXH_get64bits(p) * PRIME64_2;
+            v2 = XXH64_round(v2, XXH_get64bits(p));
             p+=8;
-            v2 = XXH_rotl64(v2, 31);
-            v2 *= PRIME64_1;
-            v3 += XXH_get64bits(p) * PRIME64_2;
+            v3 = XXH64_round(v3, XXH_get64bits(p));
             p+=8;
-            v3 = XXH_rotl64(v3, 31);
-            v3 *= PRIME64_1;
-            v4 += XXH_get64bits(p) * PRIME64_2;
+            v4 = XXH64_round(v4, XXH_get64bits(p));
             p+=8;
-            v4 = XXH_rotl64(v4, 31);
-            v4 *= PRIME64_1;
         }
         while (p<=limit);
 
@@ -608,21 +627,13 @@ FORCE_INLINE XXH_errorcode XXH32_update_endian (XXH32_state_t* state_in, const v
         XXH_memcpy((BYTE*)(state->mem32) + state->memsize, input, 16-state->memsize);
         {
             const U32* p32 = state->mem32;
-            state->v1 += XXH_readLE32(p32, endian) * PRIME32_2;
-            state->v1 = XXH_rotl32(state->v1, 13);
-            state->v1 *= PRIME32_1;
+            state->v1 = XXH32_round(state->v1, XXH_readLE32(p32, endian));
             p32++;
-            state->v2 += XXH_readLE32(p32, endian) * PRIME32_2;
-            state->v2 = XXH_rotl32(state->v2, 13);
-            state->v2 *= PRIME32_1;
+            state->v2 = XXH32_round(state->v2, XXH_readLE32(p32, endian));
             p32++;
-            state->v3 += XXH_readLE32(p32, endian) * PRIME32_2;
-            state->v3 = XXH_rotl32(state->v3, 13);
-            state->v3 *= PRIME32_1;
+            state->v3 = XXH32_round(state->v3, XXH_readLE32(p32, endian));
             p32++;
-            state->v4 += XXH_readLE32(p32, endian) * PRIME32_2;
-            state->v4 = XXH_rotl32(state->v4, 13);
-            state->v4 *= PRIME32_1;
+            state->v4 = XXH32_round(state->v4, XXH_readLE32(p32, endian));
             p32++;
         }
         p += 16-state->memsize;
@@ -639,21 +650,13 @@ FORCE_INLINE XXH_errorcode XXH32_update_endian (XXH32_state_t* state_in, const v
 
         do
         {
-            v1 += XXH_readLE32(p, endian) * PRIME32_2;
-            v1 = XXH_rotl32(v1, 13);
-            v1 *= PRIME32_1;
+            v1 = XXH32_round(v1, XXH_readLE32(p, endian));
             p+=4;
-            v2 += XXH_readLE32(p, endian) * PRIME32_2;
-            v2 = XXH_rotl32(v2, 13);
-            v2 *= PRIME32_1;
+            v2 = XXH32_round(v2, XXH_readLE32(p, endian));
             p+=4;
-            v3 += XXH_readLE32(p, endian) * PRIME32_2;
-            v3 = XXH_rotl32(v3, 13);
-            v3 *= PRIME32_1;
+            v3 = XXH32_round(v3, XXH_readLE32(p, endian));
             p+=4;
-            v4 += XXH_readLE32(p, endian) * PRIME32_2;
-            v4 = XXH_rotl32(v4, 13);
-            v4 *= PRIME32_1;
+            v4 = XXH32_round(v4, XXH_readLE32(p, endian));
             p+=4;
         }
         while (p<=limit);
@@ -762,21 +765,13 @@ FORCE_INLINE XXH_errorcode XXH64_update_endian (XXH64_state_t* state_in, const v
         XXH_memcpy(((BYTE*)state->mem64) + state->memsize, input, 32-state->memsize);
         {
             const U64* p64 = state->mem64;
-            state->v1 += XXH_readLE64(p64, endian) * PRIME64_2;
-            state->v1 = XXH_rotl64(state->v1, 31);
-            state->v1 *= PRIME64_1;
+            state->v1 = XXH64_round(state->v1, XXH_readLE64(p64, endian));
             p64++;
-            state->v2 += XXH_readLE64(p64, endian) * PRIME64_2;
-            state->v2 = XXH_rotl64(state->v2, 31);
-            state->v2 *= PRIME64_1;
+            state->v2 = XXH64_round(state->v2, XXH_readLE64(p64, endian));
             p64++;
-            state->v3 += XXH_readLE64(p64, endian) * PRIME64_2;
-            state->v3 = XXH_rotl64(state->v3, 31);
-            state->v3 *= PRIME64_1;
+            state->v3 = XXH64_round(state->v3, XXH_readLE64(p64, endian));
             p64++;
-            state->v4 += XXH_readLE64(p64, endian) * PRIME64_2;
-            state->v4 = XXH_rotl64(state->v4, 31);
-            state->v4 *= PRIME64_1;
+            state->v4 = XXH64_round(state->v4, XXH_readLE64(p64, endian));
             p64++;
         }
         p += 32-state->memsize;
@@ -793,21 +788,13 @@ FORCE_INLINE XXH_errorcode XXH64_update_endian (XXH64_state_t* state_in, const v
 
         do
         {
-            v1 += XXH_readLE64(p, endian) * PRIME64_2;
-            v1 = XXH_rotl64(v1, 31);
-            v1 *= PRIME64_1;
+            v1 = XXH64_round(v1, XXH_readLE64(p, endian));
             p+=8;
-            v2 += XXH_readLE64(p, endian) * PRIME64_2;
-            v2 = XXH_rotl64(v2, 31);
-            v2 *= PRIME64_1;
+            v2 = XXH64_round(v2, XXH_readLE64(p, endian));
             p+=8;
-            v3 += XXH_readLE64(p, endian) * PRIME64_2;
-            v3 = XXH_rotl64(v3, 31);
-            v3 *= PRIME64_1;
+            v3 = XXH64_round(v3, XXH_readLE64(p, endian));
             p+=8;
-            v4 += XXH_readLE64(p, endian) * PRIME64_2;
-            v4 = XXH_rotl64(v4, 31);
-            v4 *= PRIME64_1;
+            v4 = XXH64_round(v4, XXH_readLE64(p, endian));
             p+=8;
         }
         while (p<=limit);
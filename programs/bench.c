@@ -46,6 +46,7 @@
 ***************************************/
 #include <stdlib.h>      /* malloc */
 #include <stdio.h>       /* fprintf, fopen, ftello64 */
+#include <string.h>      /* memcpy */
 #include <sys/types.h>   /* stat64 */
 #include <sys/stat.h>    /* stat64 */
 
@@ -138,9 +139,18 @@ struct compressionParameters
 static int chunkSize = DEFAULT_CHUNKSIZE;
 static int nbIterations = NBLOOPS;
 static int BMK_pause = 0;
+static const char* g_dict = NULL;
+static int g_dictSize = 0;
 
 void BMK_setBlocksize(int bsize) { chunkSize = bsize; }
 
+void BMK_setDictionary(const void* dict, size_t dictSize)
+{
+    if (dictSize > 64 KB) { dict = (const char*)dict + dictSize - 64 KB; dictSize = 64 KB; }
+    g_dict = (const char*)dict;
+    g_dictSize = dict ? (int)dictSize : 0;
+}
+
 void BMK_setNbIterations(int nbLoops)
 {
     nbIterations = nbLoops;
@@ -150,6 +160,43 @@ void BMK_setNbIterations(int nbLoops)
 void BMK_setPause(void) { BMK_pause = 1; }
 
 
+/*********************************************************
+*  Dictionary compressors
+**********************************************************/
+/* the dictionary is loaded once per benchmark, then each chunk starts from a copy of the loaded stream */
+static LZ4_stream_t   g_dictStream;
+static LZ4_stream_t   g_workStream;
+static LZ4_streamHC_t g_dictStreamHC;
+static LZ4_streamHC_t g_workStreamHC;
+
+static void BMK_loadDictionary(int cLevel)
+{
+    LZ4_resetStream(&g_dictStream);
+    LZ4_loadDict(&g_dictStream, g_dict, g_dictSize);
+    LZ4_resetStreamHC(&g_dictStreamHC, cLevel);
+    LZ4_loadDictHC(&g_dictStreamHC, g_dict, g_dictSize);
+}
+
+static int LZ4_compress_usingDict_local(const char* src, char* dst, int size, int clevel)
+{
+    (void)clevel;
+    memcpy(&g_workStream, &g_dictStream, sizeof(g_workStream));
+    return LZ4_compress_continue(&g_workStream, src, dst, size);
+}
+
+static int LZ4_compressHC_usingDict_local(const char* src, char* dst, int size, int clevel)
+{
+    (void)clevel;
+    memcpy(&g_workStreamHC, &g_dictStreamHC, sizeof(g_workStreamHC));
+    return LZ4_compressHC_continue(&g_workStreamHC, src, dst, size);
+}
+
+static int LZ4_decompress_fast_usingDict_local(const char* src, char* dst, int originalSize)
+{
+    return LZ4_decompress_fast_usingDict(src, dst, originalSize, g_dict, g_dictSize);
+}
+
+
 /*********************************************************
 *  Private functions
 **********************************************************/
@@ -233,6 +280,114 @@ static U64 BMK_GetFileSize(const char* infilename)
 }
 
 
+static void BMK_initCompressionParameters(struct compressionParameters* compP, int cLevel)
+{
+  int cfunctionId;
+  if (cLevel <= 3) cfunctionId = 0; else cfunctionId = 1;
+  switch (cfunctionId)
+  {
+#ifdef COMPRESSOR0
+  case 0 : compP->compressionFunction = COMPRESSOR0; break;
+#endif
+#ifdef COMPRESSOR1
+  case 1 : compP->compressionFunction = COMPRESSOR1; break;
+#endif
+  default : compP->compressionFunction = DEFAULTCOMPRESSOR;
+  }
+  compP->decompressionFunction = LZ4_decompress_fast;
+
+  if (g_dictSize)
+  {
+      BMK_loadDictionary(cLevel);
+      compP->compressionFunction = (cfunctionId==0) ? LZ4_compress_usingDict_local : LZ4_compressHC_usingDict_local;
+      compP->decompressionFunction = LZ4_decompress_fast_usingDict_local;
+  }
+}
+
+
+/* benchmark nbChunks chunks, already loaded in memory, and report results under displayName */
+static int BMK_benchChunks(const char* displayName, char* orig_buff, size_t benchedSize,
+                           struct chunkParameters* chunkP, int nbChunks, char* compressedBuffer,
+                           const struct compressionParameters* compP, int cLevel,
+                           U64* totals, U64* totalz, double* totalc, double* totald)
+{
+    int loopNb, chunkNb;
+    size_t cSize=0;
+    double fastestC = 100000000., fastestD = 100000000.;
+    double ratio=0.;
+    U32 crcOrig;
+    U32 crcCheck=0;
+
+    /* Calculating input Checksum */
+    crcOrig = XXH32(orig_buff, (unsigned int)benchedSize,0);
+
+    DISPLAY("\r%79s\r", "");
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+      int nbLoops;
+      int milliTime;
+
+      /* Compression */
+      DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, displayName, (int)benchedSize);
+      { size_t i; for (i=0; i<benchedSize; i++) compressedBuffer[i]=(char)i; }     /* warmimg up memory */
+
+      nbLoops = 0;
+      milliTime = BMK_GetMilliStart();
+      while(BMK_GetMilliStart() == milliTime);
+      milliTime = BMK_GetMilliStart();
+      while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+      {
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+            chunkP[chunkNb].compressedSize = compP->compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize, cLevel);
+        nbLoops++;
+      }
+      milliTime = BMK_GetMilliSpan(milliTime);
+
+      if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
+      cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
+      ratio = (double)cSize/(double)benchedSize*100.;
+
+      DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, displayName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
+
+      /* Decompression */
+      { size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     /* zeroing area, for CRC checking */
+
+      nbLoops = 0;
+      milliTime = BMK_GetMilliStart();
+      while(BMK_GetMilliStart() == milliTime);
+      milliTime = BMK_GetMilliStart();
+      while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+      {
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+            compP->decompressionFunction(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize);
+        nbLoops++;
+      }
+      milliTime = BMK_GetMilliSpan(milliTime);
+
+      if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
+      DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, displayName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+
+      /* CRC Checking */
+      crcCheck = XXH32(orig_buff, (unsigned int)benchedSize,0);
+      if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", displayName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
+    }
+
+    if (crcOrig==crcCheck)
+    {
+        if (ratio<100.)
+            DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", displayName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+        else
+            DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", displayName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
+    }
+    *totals += benchedSize;
+    *totalz += cSize;
+    *totalc += fastestC;
+    *totald += fastestD;
+
+    return (crcOrig!=crcCheck);
+}
+
+
 /*********************************************************
 *  Public function
 **********************************************************/
@@ -242,7 +397,6 @@ int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel)
   int fileIdx=0;
   char* orig_buff;
   struct compressionParameters compP;
-  int cfunctionId;
 
   U64 totals = 0;
   U64 totalz = 0;
@@ -251,18 +405,7 @@ int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel)
 
 
   /* Init */
-  if (cLevel <= 3) cfunctionId = 0; else cfunctionId = 1;
-  switch (cfunctionId)
-  {
-#ifdef COMPRESSOR0
-  case 0 : compP.compressionFunction = COMPRESSOR0; break;
-#endif
-#ifdef COMPRESSOR1
-  case 1 : compP.compressionFunction = COMPRESSOR1; break;
-#endif
-  default : compP.compressionFunction = DEFAULTCOMPRESSOR;
-  }
-  compP.decompressionFunction = LZ4_decompress_fast;
+  BMK_initCompressionParameters(&compP, cLevel);
 
   /* Loop for each file */
   while (fileIdx<nbFiles)
@@ -276,7 +419,6 @@ int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel)
       size_t readSize;
       char* compressedBuffer; int compressedBuffSize;
       struct chunkParameters* chunkP;
-      U32 crcOrig;
 
       /* Check file existence */
       inFileName = fileNamesTable[fileIdx++];
@@ -347,81 +489,9 @@ int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel)
         return 13;
       }
 
-      /* Calculating input Checksum */
-      crcOrig = XXH32(orig_buff, (unsigned int)benchedSize,0);
-
-
       /* Bench */
-      {
-        int loopNb, chunkNb;
-        size_t cSize=0;
-        double fastestC = 100000000., fastestD = 100000000.;
-        double ratio=0.;
-        U32 crcCheck=0;
-
-        DISPLAY("\r%79s\r", "");
-        for (loopNb = 1; loopNb <= nbIterations; loopNb++)
-        {
-          int nbLoops;
-          int milliTime;
-
-          /* Compression */
-          DISPLAY("%1i-%-14.14s : %9i ->\r", loopNb, inFileName, (int)benchedSize);
-          { size_t i; for (i=0; i<benchedSize; i++) compressedBuffer[i]=(char)i; }     /* warmimg up memory */
-
-          nbLoops = 0;
-          milliTime = BMK_GetMilliStart();
-          while(BMK_GetMilliStart() == milliTime);
-          milliTime = BMK_GetMilliStart();
-          while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
-          {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = compP.compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize, cLevel);
-            nbLoops++;
-          }
-          milliTime = BMK_GetMilliSpan(milliTime);
-
-          if ((double)milliTime < fastestC*nbLoops) fastestC = (double)milliTime/nbLoops;
-          cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-          ratio = (double)cSize/(double)benchedSize*100.;
-
-          DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000.);
-
-          /* Decompression */
-          { size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     /* zeroing area, for CRC checking */
-
-          nbLoops = 0;
-          milliTime = BMK_GetMilliStart();
-          while(BMK_GetMilliStart() == milliTime);
-          milliTime = BMK_GetMilliStart();
-          while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
-          {
-            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                chunkP[chunkNb].compressedSize = LZ4_decompress_fast(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].origSize);
-            nbLoops++;
-          }
-          milliTime = BMK_GetMilliSpan(milliTime);
-
-          if ((double)milliTime < fastestD*nbLoops) fastestD = (double)milliTime/nbLoops;
-          DISPLAY("%1i-%-14.14s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\r", loopNb, inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-
-          /* CRC Checking */
-          crcCheck = XXH32(orig_buff, (unsigned int)benchedSize,0);
-          if (crcOrig!=crcCheck) { DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOrig, (unsigned)crcCheck); break; }
-        }
-
-        if (crcOrig==crcCheck)
-        {
-            if (ratio<100.)
-                DISPLAY("%-16.16s : %9i -> %9i (%5.2f%%),%7.1f MB/s ,%7.1f MB/s\n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-            else
-                DISPLAY("%-16.16s : %9i -> %9i (%5.1f%%),%7.1f MB/s ,%7.1f MB/s \n", inFileName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / fastestC / 1000., (double)benchedSize / fastestD / 1000.);
-        }
-        totals += benchedSize;
-        totalz += cSize;
-        totalc += fastestC;
-        totald += fastestD;
-      }
+      BMK_benchChunks(inFileName, orig_buff, benchedSize, chunkP, nbChunks, compressedBuffer, &compP, cLevel,
+                      &totals, &totalz, &totalc, &totald);
 
       free(orig_buff);
       free(compressedBuffer);
@@ -437,4 +507,88 @@ int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel)
 }
 
 
+int BMK_benchSamples(const char** fileNamesTable, int nbFiles, int cLevel)
+{
+  struct compressionParameters compP;
+  struct chunkParameters* chunkP;
+  char* orig_buff;
+  char* compressedBuffer;
+  size_t totalSize = 0, compressedBuffSize = 0;
+  int nbChunks = 0;
+  int fileIdx;
+  char displayName[20];
 
+  U64 totals = 0;
+  U64 totalz = 0;
+  double totalc = 0.;
+  double totald = 0.;
+
+  /* Init */
+  BMK_initCompressionParameters(&compP, cLevel);
+  for (fileIdx=0; fileIdx<nbFiles; fileIdx++)
+  {
+      U64 fileSize = BMK_GetFileSize(fileNamesTable[fileIdx]);
+      if (fileSize > (U64)chunkSize) fileSize = chunkSize;
+      if (totalSize + fileSize > MAX_MEM/2) { DISPLAY("Too many samples; testing %i of them only...\n", fileIdx); break; }
+      totalSize += (size_t)fileSize;
+      compressedBuffSize += LZ4_compressBound((int)fileSize);
+  }
+  nbFiles = fileIdx;
+  if (totalSize==0) { DISPLAY("samples are empty\n"); return 11; }
+
+  /* Alloc */
+  chunkP = (struct chunkParameters*) malloc((size_t)nbFiles * sizeof(struct chunkParameters));
+  orig_buff = (char*)malloc(totalSize);
+  compressedBuffer = (char*)malloc(compressedBuffSize);
+  if (!chunkP || !orig_buff || !compressedBuffer)
+  {
+      DISPLAY("\nError: not enough memory!\n");
+      free(orig_buff);
+      free(compressedBuffer);
+      free(chunkP);
+      return 12;
+  }
+
+  /* Load samples : one chunk per file, truncated to block size */
+  {
+      char* in = orig_buff;
+      char* out = compressedBuffer;
+      for (fileIdx=0; fileIdx<nbFiles; fileIdx++)
+      {
+          size_t fileSize = (size_t)BMK_GetFileSize(fileNamesTable[fileIdx]);
+          size_t readSize;
+          FILE* inFile;
+          if (fileSize > (size_t)chunkSize) fileSize = chunkSize;
+          if (fileSize==0) continue;
+          inFile = fopen(fileNamesTable[fileIdx], "rb");
+          if (inFile==NULL) { DISPLAY("Pb opening %s\n", fileNamesTable[fileIdx]); free(orig_buff); free(compressedBuffer); free(chunkP); return 11; }
+          readSize = fread(in, 1, fileSize, inFile);
+          fclose(inFile);
+          if (readSize != fileSize)
+          {
+              DISPLAY("\nError: problem reading file '%s' !!    \n", fileNamesTable[fileIdx]);
+              free(orig_buff); free(compressedBuffer); free(chunkP);
+              return 13;
+          }
+          chunkP[nbChunks].id = nbChunks;
+          chunkP[nbChunks].origBuffer = in; in += fileSize;
+          chunkP[nbChunks].origSize = (int)fileSize;
+          chunkP[nbChunks].compressedBuffer = out; out += LZ4_compressBound((int)fileSize);
+          chunkP[nbChunks].compressedSize = 0;
+          nbChunks++;
+      }
+  }
+
+  /* Bench */
+  sprintf(displayName, g_dictSize ? "%i samples+D" : "%i samples", nbChunks);
+  BMK_benchChunks(displayName, orig_buff, totalSize, chunkP, nbChunks, compressedBuffer, &compP, cLevel,
+                  &totals, &totalz, &totalc, &totald);
+
+  free(orig_buff);
+  free(compressedBuffer);
+  free(chunkP);
+
+  if (BMK_pause) { DISPLAY("\npress enter...\n"); getchar(); }
+
+  return 0;
+}
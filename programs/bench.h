@@ -22,12 +22,23 @@
 */
 #pragma once
 
+#include <stddef.h>   /* size_t */
+
 
 /* Main function */
 int BMK_benchFiles(const char** fileNamesTable, int nbFiles, int cLevel);
 
+/* Benchmark a set of small samples : each file is compressed independently, as a single block,
+   and results are reported as one line for the whole set (files are truncated to block size) */
+int BMK_benchSamples(const char** fileNamesTable, int nbFiles, int cLevel);
+
 /* Set Parameters */
 void BMK_setBlocksize(int bsize);
 void BMK_setNbIterations(int nbLoops);
 void BMK_setPause(void);
 
+/* Compress each block with a dictionary (only its last 64 KB are used).
+   The buffer is not copied, and must remain valid for the duration of the benchmark.
+   Use BMK_setDictionary(NULL, 0) to go back to benchmarking without dictionary */
+void BMK_setDictionary(const void* dict, size_t dictSize);
+
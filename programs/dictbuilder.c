@@ -0,0 +1,473 @@
+/*
+    dictbuilder.c - dictionary trainer for LZ4
+    Copyright (C) Yann Collet 2015
+
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    You can contact the author at :
+    - LZ4 source repository : https://github.com/Cyan4973/lz4
+    - LZ4 public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+
+/**************************************
+*  Compiler Options
+**************************************/
+#if defined(_MSC_VER) || defined(_WIN32)
+#  define _CRT_SECURE_NO_WARNINGS
+#endif
+
+/* Unix Large Files support (>4GB) */
+#define _FILE_OFFSET_BITS 64
+#if (defined(__sun__) && (!defined(__LP64__)))   /* Sun Solaris 32-bits requires specific definitions */
+#  define _LARGEFILE_SOURCE
+#elif ! defined(__LP64__)                        /* No point defining Large file for 64 bit */
+#  define _LARGEFILE64_SOURCE
+#endif
+
+
+/**************************************
+*  Includes
+**************************************/
+#include <stdlib.h>      /* malloc, qsort */
+#include <stdio.h>       /* fprintf, fopen */
+#include <string.h>      /* memcpy, memset */
+#include <sys/types.h>   /* stat64 */
+#include <sys/stat.h>    /* stat64 */
+#include "lz4.h"
+#include "lz4hc.h"
+#include "bench.h"
+#include "dictbuilder.h"
+
+
+/**************************************
+*  Basic Types
+**************************************/
+#if defined (__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L)   /* C99 */
+# include <stdint.h>
+  typedef  uint8_t BYTE;
+  typedef uint16_t U16;
+  typedef uint32_t U32;
+  typedef uint64_t U64;
+#else
+  typedef unsigned char       BYTE;
+  typedef unsigned short      U16;
+  typedef unsigned int        U32;
+  typedef unsigned long long  U64;
+#endif
+
+
+/**************************************
+*  Compiler specifics
+**************************************/
+#if !defined(S_ISREG)
+#  define S_ISREG(x) (((x) & S_IFMT) == S_IFREG)
+#endif
+
+
+/**************************************
+*  Constants
+**************************************/
+#define KB *(1 <<10)
+#define MB *(1 <<20)
+
+#define DIB_DMER          8          /* segments are scored on 8-bytes substrings : twice LZ4's MINMATCH, so a reference to them is worth more than its own cost */
+#define DIB_HASHLOG       20
+#define DIB_HASHSIZE      (1 << DIB_HASHLOG)
+#define DIB_PIECESIZE     (16 KB)    /* a substring is counted once per piece of sample, so that repetitions inside a single large sample do not dominate */
+#define DIB_SAMPLESIZE_MAX (4 MB)    /* larger files are truncated, like a frame block */
+#define DIB_SAMPLES_MAX   (128 MB)   /* total amount of samples loaded for training */
+#define DIB_EVALSIZE      (8 MB)     /* amount of samples compressed to compare candidate segment sizes */
+
+static const size_t g_segmentSizes[] = { 32, 64, 128, 256, 512, 1024 };
+#define DIB_NB_SEGMENTSIZES (sizeof(g_segmentSizes) / sizeof(g_segmentSizes[0]))
+
+
+/**************************************
+*  Macros
+**************************************/
+#define DISPLAY(...)         fprintf(stderr, __VA_ARGS__)
+#define DISPLAYLEVEL(l, ...) if (g_displayLevel>=l) { DISPLAY(__VA_ARGS__); }
+static int g_displayLevel = 2;   /* 0 : no display  ; 1: errors  ; 2 : + result ; 3 : + progression; 4 : + information */
+
+#define MIN(a,b) ((a)<(b) ? (a) : (b))
+
+void DiB_setNotificationLevel(int level) { g_displayLevel = level; }
+
+
+/**************************************
+*  Local structures
+**************************************/
+typedef struct
+{
+    size_t pos;
+    U32    score;
+} DiB_segment_t;
+
+typedef struct
+{
+    const BYTE*   src;
+    const size_t* sizes;
+    unsigned      nbSamples;
+    size_t        totalSize;
+} DiB_samples_t;
+
+
+/**************************************
+*  Substring statistics
+**************************************/
+static U32 DiB_hashDmer(const BYTE* p)
+{
+    U64 v;
+    memcpy(&v, p, sizeof(v));
+    return (U32)((v * 0x9E3779B185EBCA87ULL) >> (64 - DIB_HASHLOG));
+}
+
+/* freq[h] : nb of sample pieces containing substrings of hash h. Substrings found in a single piece score zero. */
+static void DiB_countDmers(U32* freq, U32* lastPiece, const DiB_samples_t* samples)
+{
+    const BYTE* sStart = samples->src;
+    U32 pieceNb = 0;
+    unsigned s;
+    size_t h;
+
+    memset(freq, 0, DIB_HASHSIZE * sizeof(*freq));
+    memset(lastPiece, 0, DIB_HASHSIZE * sizeof(*lastPiece));
+    for (s=0; s<samples->nbSamples; s++)
+    {
+        size_t const sSize = samples->sizes[s];
+        size_t i;
+        for (i=0; i+DIB_DMER <= sSize; i++)
+        {
+            U32 const hash = DiB_hashDmer(sStart+i);
+            if ((i % DIB_PIECESIZE) == 0) pieceNb++;
+            if (lastPiece[hash] != pieceNb) { lastPiece[hash] = pieceNb; freq[hash]++; }
+        }
+        sStart += sSize;
+    }
+    for (h=0; h<DIB_HASHSIZE; h++) if (freq[h] < 2) freq[h] = 0;
+}
+
+
+/**************************************
+*  Segment selection
+**************************************/
+static int DiB_compareSegments(const void* a, const void* b)
+{
+    U32 const sa = ((const DiB_segment_t*)a)->score;
+    U32 const sb = ((const DiB_segment_t*)b)->score;
+    return (sa > sb) - (sa < sb);
+}
+
+/* Find the segment of size k with the highest score within [begin, end), a range inside a single sample.
+   A segment scores the sum of freq[] of its distinct substrings. inWindow[] must be all zeroes, and is left so. */
+static void DiB_bestSegment(DiB_segment_t* best, const BYTE* src, size_t begin, size_t end, size_t k,
+                            const U32* freq, U16* inWindow)
+{
+    size_t const lastDmer = k - DIB_DMER;
+    U32 score = 0;
+    size_t start, p;
+
+    for (p=begin; p<=begin+lastDmer; p++)
+    {
+        U32 const h = DiB_hashDmer(src+p);
+        if (inWindow[h]++ == 0) score += freq[h];
+    }
+    if (score > best->score) { best->score = score; best->pos = begin; }
+
+    for (start=begin+1; start+k <= end; start++)
+    {
+        U32 const hOut = DiB_hashDmer(src+start-1);
+        U32 const hIn  = DiB_hashDmer(src+start+lastDmer);
+        if (--inWindow[hOut] == 0) score -= freq[hOut];
+        if (inWindow[hIn]++ == 0) score += freq[hIn];
+        if (score > best->score) { best->score = score; best->pos = start; }
+    }
+
+    for (p=start-1; p<=start-1+lastDmer; p++) inWindow[DiB_hashDmer(src+p)] = 0;
+}
+
+/* Split samples into epochs, and select the best segment of size k from each one.
+   Once selected, a segment's substrings stop scoring, so that later epochs bring new content.
+   freq[] is modified. return : dictionary size */
+static size_t DiB_selectSegments(BYTE* dict, size_t dictCapacity, DiB_segment_t* segments,
+                                 U32* freq, U16* inWindow, const DiB_samples_t* samples, size_t k)
+{
+    size_t nbEpochs = dictCapacity / k;
+    size_t epochSize, epochNb;
+    size_t nbSegments = 0;
+    size_t dictSize = 0;
+    size_t sStart = 0;
+    unsigned s = 0;
+
+    if (nbEpochs == 0) return 0;
+    epochSize = samples->totalSize / nbEpochs;
+    if (epochSize < k) { epochSize = k; nbEpochs = samples->totalSize / k; }
+
+    for (epochNb=0; epochNb<nbEpochs; epochNb++)
+    {
+        size_t const eStart = epochNb * epochSize;
+        size_t const eEnd = (epochNb==nbEpochs-1) ? samples->totalSize : eStart + epochSize;
+        DiB_segment_t best;
+        size_t pos;
+
+        best.pos = 0; best.score = 0;
+        for (pos=eStart; pos<eEnd; )
+        {
+            size_t end;
+            while (sStart + samples->sizes[s] <= pos) sStart += samples->sizes[s++];
+            end = MIN(sStart + samples->sizes[s], eEnd);
+            if (end - pos >= k) DiB_bestSegment(&best, samples->src, pos, end, k, freq, inWindow);
+            pos = end;
+        }
+
+        if (best.score)
+        {
+            size_t p;
+            for (p=best.pos; p+DIB_DMER <= best.pos+k; p++) freq[DiB_hashDmer(samples->src+p)] = 0;
+            segments[nbSegments++] = best;
+        }
+    }
+
+    /* most useful segments last : they get the shortest offsets, and win hash collisions */
+    qsort(segments, nbSegments, sizeof(*segments), DiB_compareSegments);
+    for (s=0; s<nbSegments; s++)
+    {
+        memcpy(dict+dictSize, samples->src+segments[s].pos, k);
+        dictSize += k;
+    }
+    return dictSize;
+}
+
+
+/**************************************
+*  Evaluation
+**************************************/
+/* Compress samples independently, using dict, up to maxSize bytes of samples.
+   return : total compressed size, or 0 on error */
+static size_t DiB_compressSamples(const void* dict, size_t dictSize, const DiB_samples_t* samples,
+                                  size_t maxSize, int cLevel, size_t* srcSize)
+{
+    LZ4_stream_t* dictStream = LZ4_createStream();
+    LZ4_stream_t* workStream = LZ4_createStream();
+    LZ4_streamHC_t* dictStreamHC = (cLevel>=3) ? LZ4_createStreamHC() : NULL;
+    LZ4_streamHC_t* workStreamHC = (cLevel>=3) ? LZ4_createStreamHC() : NULL;
+    const char* src = (const char*)samples->src;
+    char* dst;
+    size_t maxSampleSize = 0;
+    size_t cSize = 0;
+    unsigned s;
+
+    for (s=0; s<samples->nbSamples; s++) if (samples->sizes[s] > maxSampleSize) maxSampleSize = samples->sizes[s];
+    dst = (char*)malloc((size_t)LZ4_compressBound((int)maxSampleSize) + 1);
+    *srcSize = 0;
+    if (!dictStream || !workStream || !dst || ((cLevel>=3) && (!dictStreamHC || !workStreamHC))) goto _end;
+    LZ4_resetStream(dictStream);
+    LZ4_loadDict(dictStream, (const char*)dict, (int)dictSize);
+    if (cLevel>=3)
+    {
+        LZ4_resetStreamHC(dictStreamHC, cLevel);
+        LZ4_loadDictHC(dictStreamHC, (const char*)dict, (int)dictSize);
+    }
+
+    for (s=0; (s<samples->nbSamples) && (*srcSize < maxSize); s++)
+    {
+        int const sSize = (int)samples->sizes[s];
+        int r;
+        if (cLevel>=3)
+        {
+            memcpy(workStreamHC, dictStreamHC, sizeof(*workStreamHC));
+            r = LZ4_compressHC_continue(workStreamHC, src, dst, sSize);
+        }
+        else
+        {
+            memcpy(workStream, dictStream, sizeof(*workStream));
+            r = LZ4_compress_continue(workStream, src, dst, sSize);
+        }
+        if (r <= 0 && sSize > 0) { cSize = 0; goto _end; }
+        cSize += (size_t)r;
+        *srcSize += (size_t)sSize;
+        src += sSize;
+    }
+
+_end:
+    LZ4_freeStream(dictStream);
+    LZ4_freeStream(workStream);
+    if (dictStreamHC) LZ4_freeStreamHC(dictStreamHC);
+    if (workStreamHC) LZ4_freeStreamHC(workStreamHC);
+    free(dst);
+    return cSize;
+}
+
+
+/**************************************
+*  Public functions
+**************************************/
+size_t DiB_trainFromBuffer(void* dictBuffer, size_t dictCapacity,
+                           const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples,
+                           int cLevel)
+{
+    U32* const freq = (U32*)malloc(DIB_HASHSIZE * sizeof(U32));
+    U32* const freqCopy = (U32*)malloc(DIB_HASHSIZE * sizeof(U32));
+    U16* const inWindow = (U16*)calloc(DIB_HASHSIZE, sizeof(U16));
+    BYTE* const candidate = (BYTE*)malloc(dictCapacity);
+    DiB_segment_t* const segments = (DiB_segment_t*)malloc((dictCapacity / g_segmentSizes[0] + 1) * sizeof(DiB_segment_t));
+    DiB_samples_t samples;
+    size_t bestCSize = (size_t)-1;
+    size_t dictSize = 0;
+    unsigned u;
+
+    samples.src = (const BYTE*)samplesBuffer;
+    samples.sizes = samplesSizes;
+    samples.nbSamples = nbSamples;
+    samples.totalSize = 0;
+    for (u=0; u<nbSamples; u++) samples.totalSize += samplesSizes[u];
+
+    if (!freq || !freqCopy || !inWindow || !candidate || !segments) goto _end;
+    if (dictCapacity > DIB_DICTSIZE_MAX) dictCapacity = DIB_DICTSIZE_MAX;
+
+    DISPLAYLEVEL(3, "Counting substrings in %u samples (%u KB) \n", nbSamples, (unsigned)(samples.totalSize >> 10));
+    DiB_countDmers(freq, freqCopy, &samples);
+
+    /* try each segment size, keep the one which compresses samples best */
+    for (u=0; u<DIB_NB_SEGMENTSIZES; u++)
+    {
+        size_t const k = g_segmentSizes[u];
+        size_t candidateSize, cSize, srcSize;
+        memcpy(freqCopy, freq, DIB_HASHSIZE * sizeof(U32));
+        candidateSize = DiB_selectSegments(candidate, dictCapacity, segments, freqCopy, inWindow, &samples, k);
+        if (candidateSize == 0) continue;
+        cSize = DiB_compressSamples(candidate, candidateSize, &samples, DIB_EVALSIZE, cLevel, &srcSize);
+        DISPLAYLEVEL(3, "segments of %3u bytes : dictionary of %6u bytes, samples compressed to %u bytes \n",
+                     (unsigned)k, (unsigned)candidateSize, (unsigned)cSize);
+        if (cSize && cSize < bestCSize)
+        {
+            bestCSize = cSize;
+            dictSize = candidateSize;
+            memcpy(dictBuffer, candidate, candidateSize);
+        }
+    }
+
+_end:
+    free(freq);
+    free(freqCopy);
+    free(inWindow);
+    free(candidate);
+    free(segments);
+    return dictSize;
+}
+
+
+static U64 DiB_getFileSize(const char* infilename)
+{
+    int r;
+#if defined(_MSC_VER)
+    struct _stat64 statbuf;
+    r = _stat64(infilename, &statbuf);
+#else
+    struct stat statbuf;
+    r = stat(infilename, &statbuf);
+#endif
+    if (r || !S_ISREG(statbuf.st_mode)) return 0;   /* No good... */
+    return (U64)statbuf.st_size;
+}
+
+
+int DiB_trainFromFiles(const char* dictFileName, size_t maxDictSize,
+                       const char** fileNamesTable, unsigned nbFiles, int cLevel)
+{
+    size_t* const samplesSizes = (size_t*)malloc(nbFiles * sizeof(size_t) + 1);
+    BYTE* samplesBuffer = NULL;
+    void* const dictBuffer = malloc(maxDictSize + 1);
+    DiB_samples_t samples;
+    size_t totalSize = 0, dictSize;
+    unsigned nbSamples = 0, u;
+    int result = 0;
+
+    if (!samplesSizes || !dictBuffer) { DISPLAYLEVEL(1, "not enough memory \n"); result = 1; goto _end; }
+
+    /* Load samples */
+    for (u=0; u<nbFiles; u++)
+    {
+        U64 fileSize = DiB_getFileSize(fileNamesTable[u]);
+        if (fileSize > DIB_SAMPLESIZE_MAX) fileSize = DIB_SAMPLESIZE_MAX;
+        if (totalSize + fileSize > DIB_SAMPLES_MAX) { DISPLAYLEVEL(2, "Warning : too many samples, only %u files loaded \n", u); nbFiles = u; break; }
+        totalSize += (size_t)fileSize;
+    }
+    samplesBuffer = (BYTE*)malloc(totalSize + 1);
+    if (!samplesBuffer) { DISPLAYLEVEL(1, "not enough memory \n"); result = 1; goto _end; }
+    totalSize = 0;
+    for (u=0; u<nbFiles; u++)
+    {
+        size_t fileSize = (size_t)DiB_getFileSize(fileNamesTable[u]);
+        size_t readSize;
+        FILE* f;
+        if (fileSize > DIB_SAMPLESIZE_MAX) fileSize = DIB_SAMPLESIZE_MAX;
+        if (fileSize == 0) continue;
+        f = fopen(fileNamesTable[u], "rb");
+        if (f==NULL) { DISPLAYLEVEL(1, "Pb opening %s \n", fileNamesTable[u]); result = 2; goto _end; }
+        readSize = fread(samplesBuffer+totalSize, 1, fileSize, f);
+        fclose(f);
+        if (readSize != fileSize) { DISPLAYLEVEL(1, "Pb reading %s \n", fileNamesTable[u]); result = 3; goto _end; }
+        samplesSizes[nbSamples++] = fileSize;
+        totalSize += fileSize;
+    }
+    if (totalSize == 0) { DISPLAYLEVEL(1, "samples are empty \n"); result = 4; goto _end; }
+
+    /* Train */
+    dictSize = DiB_trainFromBuffer(dictBuffer, maxDictSize, samplesBuffer, samplesSizes, nbSamples, cLevel);
+    if (dictSize == 0) { DISPLAYLEVEL(1, "no repetition found across samples : dictionary not created \n"); result = 5; goto _end; }
+
+    /* Save */
+    {
+        FILE* const f = fopen(dictFileName, "wb");
+        size_t writtenSize;
+        if (f==NULL) { DISPLAYLEVEL(1, "Pb opening %s \n", dictFileName); result = 6; goto _end; }
+        writtenSize = fwrite(dictBuffer, 1, dictSize, f);
+        fclose(f);
+        if (writtenSize != dictSize) { DISPLAYLEVEL(1, "Pb writing %s \n", dictFileName); result = 7; goto _end; }
+    }
+    DISPLAYLEVEL(2, "Dictionary %s : %u bytes, trained on %u samples (%u KB) \n",
+                 dictFileName, (unsigned)dictSize, nbSamples, (unsigned)(totalSize >> 10));
+
+    /* Report */
+    samples.src = samplesBuffer;
+    samples.sizes = samplesSizes;
+    samples.nbSamples = nbSamples;
+    samples.totalSize = totalSize;
+    {
+        size_t srcSize;
+        size_t const cSizeNoDict = DiB_compressSamples(NULL, 0, &samples, totalSize, cLevel, &srcSize);
+        size_t const cSizeDict = DiB_compressSamples(dictBuffer, dictSize, &samples, totalSize, cLevel, &srcSize);
+        DISPLAYLEVEL(2, "Samples compressed to %u bytes (%5.2f%%) without dictionary, %u bytes (%5.2f%%) with dictionary \n",
+                     (unsigned)cSizeNoDict, (double)cSizeNoDict / (double)totalSize * 100.,
+                     (unsigned)cSizeDict, (double)cSizeDict / (double)totalSize * 100.);
+    }
+    if (g_displayLevel >= 2)
+    {
+        BMK_setDictionary(NULL, 0);
+        BMK_benchSamples(fileNamesTable, (int)nbFiles, cLevel);
+        BMK_setDictionary(dictBuffer, dictSize);
+        BMK_benchSamples(fileNamesTable, (int)nbFiles, cLevel);
+        BMK_setDictionary(NULL, 0);
+    }
+
+_end:
+    free(samplesSizes);
+    free(samplesBuffer);
+    free(dictBuffer);
+    return result;
+}
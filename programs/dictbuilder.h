@@ -0,0 +1,49 @@
+/*
+    dictbuilder.h - dictionary trainer for LZ4 - header
+    Copyright (C) Yann Collet 2015
+
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    You can contact the author at :
+    - LZ4 source repository : https://github.com/Cyan4973/lz4
+    - LZ4 public forum : https://groups.google.com/forum/#!forum/lz4c
+*/
+#pragma once
+
+#include <stddef.h>   /* size_t */
+
+#define DIB_DICTSIZE_MAX (64 << 10)   /* LZ4 can only reference the last 64 KB of a dictionary */
+
+size_t DiB_trainFromBuffer(void* dictBuffer, size_t dictCapacity,
+                           const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples,
+                           int cLevel);
+int DiB_trainFromFiles(const char* dictFileName, size_t maxDictSize,
+                       const char** fileNamesTable, unsigned nbFiles, int cLevel);
+void DiB_setNotificationLevel(int level);
+/* DiB_trainFromBuffer
+   Build a dictionary from a set of samples, concatenated into samplesBuffer, with their sizes listed in samplesSizes.
+   The dictionary is made of the most frequent segments found across samples, most frequent last,
+   since LZ4 finds recent matches first and encodes them with shorter offsets.
+   Segment size is tuned by compressing the samples with each candidate dictionary, at level cLevel.
+   dictCapacity should be <= DIB_DICTSIZE_MAX (larger capacity is useless for LZ4).
+   return : size of the dictionary written into dictBuffer, or 0 if no repetition was found across samples.
+
+   DiB_trainFromFiles
+   Load each file as one sample, train a dictionary of up to maxDictSize bytes, and save it into dictFileName.
+   Then report compression ratio and speed on the samples, without and with the dictionary, using the bench module.
+   return : 0 on success, or a non-zero error code.
+*/
@@ -36,6 +36,18 @@
 #  define FUZ_LEGACY_TIMER 1
 #endif
 
+/* fileno() and pthread, for the lz4g tests */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L
+#endif
+
+/* lz4g file descriptor API, as built by lz4g.c (LZ4G_FDAPI) */
+#if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(_WIN32)
+#  define FUZ_FDAPI 0
+#else
+#  define FUZ_FDAPI 1
+#endif
+
 
 /**************************************
 *  Includes
@@ -44,8 +56,17 @@
 #include <stdio.h>      /* fprintf */
 #include <string.h>     /* strcmp */
 #include "lz4frame_static.h"
+#include "lz4g.h"
 #include "xxhash.h"     /* XXH64 */
 
+/* concurrent LZ4G_readerRead() tests, where lz4g is built with LZ4G_MULTITHREAD */
+#if !defined(_WIN32)
+#  define FUZ_THREADS 1
+#  include <pthread.h>   /* pthread_create, pthread_join */
+#else
+#  define FUZ_THREADS 0
+#endif
+
 /* Use ftime() if gettimeofday() is not available on your target */
 #if defined(FUZ_LEGACY_TIMER)
 #  include <sys/timeb.h>   /* timeb, ftime */
@@ -83,6 +104,12 @@ static void FUZ_writeLE32 (void* dstVoidPtr, U32 value32)
     dstPtr[3] = (BYTE)(value32 >> 24);
 }
 
+static U32 FUZ_readLE32 (const void* srcVoidPtr)
+{
+    const BYTE* srcPtr = (const BYTE*)srcVoidPtr;
+    return srcPtr[0] + (srcPtr[1]<<8) + (srcPtr[2]<<16) + ((U32)srcPtr[3]<<24);
+}
+
 
 /**************************************
 *  Constants
@@ -291,6 +318,24 @@ int basicTests(U32 seed, double compressibility)
         if (crcDest != crcOrig) goto _output_error;
         DISPLAYLEVEL(3, "Regenerated %i bytes \n", (int)decodedBufferSize);
 
+        DISPLAYLEVEL(3, "Reset within a frame : \n");
+        {
+            size_t oSize = COMPRESSIBLE_NOISE_LENGTH;
+            size_t iSize = cSize / 2;
+            errorCode = LZ4F_decompress(dCtx, decodedBuffer, &oSize, compressedBuffer, &iSize, NULL);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            errorCode = LZ4F_resetDecompressionContext(dCtx);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            oSize = COMPRESSIBLE_NOISE_LENGTH;
+            iSize = cSize;
+            errorCode = LZ4F_decompress(dCtx, decodedBuffer, &oSize, compressedBuffer, &iSize, NULL);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            if (oSize != COMPRESSIBLE_NOISE_LENGTH) goto _output_error;
+            crcDest = XXH64(decodedBuffer, COMPRESSIBLE_NOISE_LENGTH, 1);
+            if (crcDest != crcOrig) goto _output_error;
+            DISPLAYLEVEL(3, "Regenerated %i bytes \n", (int)oSize);
+        }
+
         errorCode = LZ4F_freeDecompressionContext(dCtx);
         if (LZ4F_isError(errorCode)) goto _output_error;
     }
@@ -428,6 +473,240 @@ int basicTests(U32 seed, double compressibility)
         else
             goto _output_error;
 
+        DISPLAYLEVEL(3, "header buffer size : \n");
+        memset(&prefs, 0, sizeof(prefs));
+        prefs.frameInfo.contentSize = testSize;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, 15, &prefs);   /* largest header without dictID */
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        LZ4F_resetCompressionContext(cctx);
+        prefs.frameInfo.dictID = 1;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, 18, &prefs);
+        if (errorCode != (size_t)-ERROR_dstMaxSize_tooSmall) goto _output_error;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, 19, &prefs);
+        if (errorCode != 19) goto _output_error;
+        LZ4F_resetCompressionContext(cctx);
+        DISPLAYLEVEL(3, "reset within a frame : \n");
+        prefs.frameInfo.contentSize = 0;
+        op = ostart;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, testSize, &prefs);
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, testSize, &prefs);
+        if (!LZ4F_isError(errorCode)) goto _output_error;   /* frame already started */
+        errorCode = LZ4F_resetCompressionContext(cctx);
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        errorCode = LZ4F_compressBegin(cctx, compressedBuffer, testSize, &prefs);
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        op += errorCode;
+        errorCode = LZ4F_compressUpdate(cctx, op, LZ4F_compressBound(testSize, &prefs), CNBuffer, testSize, NULL);
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        op += errorCode;
+        errorCode = LZ4F_compressEnd(cctx, op, testSize, NULL);
+        if (LZ4F_isError(errorCode)) goto _output_error;
+        DISPLAYLEVEL(3, "Compressed %i bytes into a %i bytes frame \n", (int)testSize, (int)(op-ostart));
+
+        DISPLAYLEVEL(3, "re-use a compressed block : \n");
+        {
+            const size_t blockSize = 64 KB;
+            LZ4F_decompressionContext_t dctx;
+            BYTE* blockStart;
+            size_t decodedSize = 2 * blockSize;
+            size_t srcSize;
+            prefs.frameInfo.blockSizeID = max64KB;
+            prefs.frameInfo.blockMode = blockIndependent;
+            prefs.frameInfo.contentChecksumFlag = contentChecksumEnabled;
+            prefs.frameInfo.contentSize = 2 * blockSize;
+            prefs.autoFlush = 1;
+            op = ostart;
+            errorCode = LZ4F_compressBegin(cctx, op, testSize, &prefs);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            op += errorCode;
+            blockStart = op;
+            errorCode = LZ4F_compressUpdate(cctx, op, LZ4F_compressBound(blockSize, &prefs), CNBuffer, blockSize, NULL);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            op += errorCode;
+            errorCode = LZ4F_insertBlock(cctx, op, LZ4F_compressBound(blockSize, &prefs), CNBuffer, blockSize, blockStart, (size_t)(op - blockStart));
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            op += errorCode;
+            errorCode = LZ4F_compressEnd(cctx, op, testSize, NULL);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            op += errorCode;
+            srcSize = op - ostart;
+            errorCode = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            errorCode = LZ4F_decompress(dctx, decodedBuffer, &decodedSize, ostart, &srcSize, NULL);
+            LZ4F_freeDecompressionContext(dctx);
+            if (errorCode != 0) goto _output_error;   /* frame fully decoded, checksum verified */
+            if (decodedSize != 2 * blockSize) goto _output_error;
+            if (memcmp(decodedBuffer, CNBuffer, blockSize) || memcmp((BYTE*)decodedBuffer + blockSize, CNBuffer, blockSize)) goto _output_error;
+
+            prefs.frameInfo.blockMode = blockLinked;
+            prefs.frameInfo.contentSize = 0;
+            errorCode = LZ4F_compressBegin(cctx, ostart, testSize, &prefs);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            errorCode = LZ4F_insertBlock(cctx, op, testSize, CNBuffer, blockSize, blockStart, 4);
+            if (!LZ4F_isError(errorCode)) goto _output_error;   /* linked blocks depend on previous ones */
+            errorCode = LZ4F_resetCompressionContext(cctx);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            DISPLAYLEVEL(3, "Regenerated %i bytes \n", (int)decodedSize);
+        }
+
+        DISPLAYLEVEL(3, "compress with dictionary : \n");
+        {
+            const BYTE* const dict = (const BYTE*)CNBuffer;
+            const size_t dictSize = 64 KB;
+            BYTE record[1 KB];
+            LZ4F_decompressionContext_t dctx;
+            LZ4F_CDict* cdict;
+            LZ4F_frameInfo_t fi;
+            const BYTE* ip;
+            int n;
+            memcpy(record, dict + dictSize - 4 KB, sizeof(record));   /* near dict end : LZ4_loadDict() samples dict into a small table, older positions get evicted */
+            errorCode = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+            if (LZ4F_isError(errorCode)) goto _output_error;
+            cdict = LZ4F_createCDict(dict, dictSize);
+            if (cdict == NULL) goto _output_error;
+            for (n=0; n<8; n++)
+            {
+                /* small record found within dict, then several blocks; independent & linked, fast & HC */
+                const BYTE* const src = (n&1) ? dict + dictSize : record;
+                const size_t srcSize = (n&1) ? 200 KB : sizeof(record);
+                size_t decodedSize = srcSize;
+                size_t srcSizeCheck;
+                memset(&prefs, 0, sizeof(prefs));
+                prefs.frameInfo.blockSizeID = max64KB;
+                prefs.frameInfo.blockMode = (n&2) ? blockLinked : blockIndependent;
+                prefs.frameInfo.contentChecksumFlag = contentChecksumEnabled;
+                prefs.frameInfo.dictID = 0xD1C7 + n;
+                prefs.compressionLevel = (n&4) ? 9 : 0;
+                op = ostart;
+                errorCode = LZ4F_compressBegin_usingDict(cctx, op, testSize, dict, dictSize, &prefs);
+                if (LZ4F_isError(errorCode)) goto _output_error;
+                op += errorCode;
+                errorCode = LZ4F_compressUpdate(cctx, op, LZ4F_compressBound(srcSize, &prefs), src, srcSize, NULL);
+                if (LZ4F_isError(errorCode)) goto _output_error;
+                op += errorCode;
+                errorCode = LZ4F_compressEnd(cctx, op, testSize, NULL);
+                if (LZ4F_isError(errorCode)) goto _output_error;
+                op += errorCode;
+                if (!(n&1) && ((size_t)(op - ostart) > 256)) goto _output_error;   /* record mostly found within dict */
+
+                /* pre-digested dictionary : same frame, unless src directly follows dict,
+                 * which LZ4F_compressBegin_usingDict() then continues as a prefix */
+                {
+                    BYTE* cop = op;
+                    errorCode = LZ4F_compressBegin_usingCDict(cctx, cop, testSize, cdict, &prefs);
+                    if (LZ4F_isError(errorCode)) goto _output_error;
+                    cop += errorCode;
+                    errorCode = LZ4F_compressUpdate(cctx, cop, LZ4F_compressBound(srcSize, &prefs), src, srcSize, NULL);
+                    if (LZ4F_isError(errorCode)) goto _output_error;
+                    cop += errorCode;
+                    errorCode = LZ4F_compressEnd(cctx, cop, testSize, NULL);
+                    if (LZ4F_isError(errorCode)) goto _output_error;
+                    cop += errorCode;
+                    if (n&1)
+                    {   /* decodes the same, into a frame of similar size */
+                        size_t cdictDecodedSize = srcSize;
+                        srcSizeCheck = (size_t)(cop - op);
+                        errorCode = LZ4F_decompress_usingDict(dctx, decodedBuffer, &cdictDecodedSize, op, &srcSizeCheck, dict, dictSize, NULL);
+                        if (errorCode != 0) goto _output_error;
+                        if ((cdictDecodedSize != srcSize) || memcmp(decodedBuffer, src, srcSize)) goto _output_error;
+                        if ((size_t)(cop - op) > (size_t)(op - ostart) + (size_t)(op - ostart) / 128) goto _output_error;
+                    }
+                    else if ((cop - op != op - ostart) || memcmp(op, ostart, (size_t)(op - ostart))) goto _output_error;
+                }
+
+                srcSizeCheck = 20;
+                errorCode = LZ4F_getFrameInfo(dctx, &fi, ostart, &srcSizeCheck);
+                if (LZ4F_isError(errorCode)) goto _output_error;
+                if (fi.dictID != prefs.frameInfo.dictID) goto _output_error;
+                ip = ostart + srcSizeCheck;
+                srcSizeCheck = (size_t)(op - ip);
+                errorCode = LZ4F_decompress_usingDict(dctx, decodedBuffer, &decodedSize, ip, &srcSizeCheck, dict, dictSize, NULL);
+                if (errorCode != 0) goto _output_error;   /* frame fully decoded, checksum verified */
+                if ((decodedSize != srcSize) || memcmp(decodedBuffer, src, srcSize)) goto _output_error;
+
+                /* record can't be decoded without dictionary */
+                if (n&1) continue;
+                DISPLAYLEVEL(3, "Compressed 1 KB record into a %i bytes frame \n", (int)(op-ostart));
+                decodedSize = srcSize;
+                srcSizeCheck = (size_t)(op - ostart);
+                errorCode = LZ4F_decompress(dctx, decodedBuffer, &decodedSize, ostart, &srcSizeCheck, NULL);
+                if (!LZ4F_isError(errorCode)) goto _output_error;
+                LZ4F_resetDecompressionContext(dctx);
+            }
+            LZ4F_freeCDict(cdict);
+            LZ4F_freeDecompressionContext(dctx);
+        }
+
+        DISPLAYLEVEL(3, "block checksum : \n");
+        {
+            const size_t blockSize = 64 KB;
+            const size_t srcSize = 3 * blockSize;   /* 2 compressed blocks, then 1 uncompressed block */
+            BYTE* const src = (BYTE*)malloc(srcSize);
+            LZ4F_decompressionContext_t dctx;
+            LZ4F_frameInfo_t fi;
+            size_t frameSize, pos;
+            int n;
+            if (src == NULL) goto _output_error;
+            memcpy(src, CNBuffer, 2 * blockSize);
+            for (pos = 2 * blockSize; pos < srcSize; pos++) src[pos] = (BYTE)FUZ_rand(&randState);
+            errorCode = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+            if (LZ4F_isError(errorCode)) { free(src); goto _output_error; }
+            for (n=0; n<4; n++)
+            {
+                size_t decodedSize = srcSize;
+                size_t srcSizeCheck;
+                memset(&prefs, 0, sizeof(prefs));
+                prefs.frameInfo.blockSizeID = max64KB;
+                prefs.frameInfo.blockMode = (n&1) ? blockLinked : blockIndependent;
+                prefs.frameInfo.blockChecksumFlag = blockChecksumEnabled;
+                prefs.compressionLevel = (n&2) ? 9 : 0;
+                frameSize = LZ4F_compressFrame(compressedBuffer, LZ4F_compressFrameBound(srcSize, &prefs), src, srcSize, &prefs);
+                if (LZ4F_isError(frameSize)) break;
+
+                /* decoded by small pieces, so that checksums get split */
+                {
+                    const BYTE* ip = (const BYTE*)compressedBuffer;
+                    const BYTE* const iend = ip + frameSize;
+                    BYTE* dp = (BYTE*)decodedBuffer;
+                    errorCode = 1;
+                    while ((ip < iend) && !LZ4F_isError(errorCode))
+                    {
+                        size_t iSize = (FUZ_rand(&randState) & 7) + 1;
+                        size_t oSize = srcSize - (size_t)(dp - (BYTE*)decodedBuffer);
+                        if (iSize > (size_t)(iend-ip)) iSize = iend-ip;
+                        errorCode = LZ4F_decompress(dctx, dp, &oSize, ip, &iSize, NULL);
+                        ip += iSize;
+                        dp += oSize;
+                    }
+                    if ((errorCode != 0) || (dp - (BYTE*)decodedBuffer != (int)srcSize) || memcmp(decodedBuffer, src, srcSize)) break;
+                }
+                srcSizeCheck = frameSize;
+                errorCode = LZ4F_getFrameInfo(dctx, &fi, compressedBuffer, &srcSizeCheck);
+                if (LZ4F_isError(errorCode) || (fi.blockChecksumFlag != blockChecksumEnabled)) break;
+                LZ4F_resetDecompressionContext(dctx);
+
+                /* corrupted block, compressed (2nd) or not (3rd) : detected before decoding it, hence before the end of the frame */
+                {
+                    BYTE* const block1 = (BYTE*)compressedBuffer + srcSizeCheck;
+                    BYTE* const block2 = block1 + 4 + (FUZ_readLE32(block1) & 0x7FFFFFFF) + 4;
+                    BYTE* const block3 = block2 + 4 + (FUZ_readLE32(block2) & 0x7FFFFFFF) + 4;
+                    BYTE* const corrupted = (n&2) ? block3 + 4 + 100 : block2 + 4 + 10;
+                    if (!(FUZ_readLE32(block3) & 0x80000000U)) break;   /* 3rd block must be stored uncompressed */
+                    *corrupted ^= 0x40;
+                    srcSizeCheck = frameSize;
+                    errorCode = LZ4F_decompress(dctx, decodedBuffer, &decodedSize, compressedBuffer, &srcSizeCheck, NULL);
+                    *corrupted ^= 0x40;
+                    if (errorCode != (size_t)-ERROR_blockChecksum_invalid) break;
+                    LZ4F_resetDecompressionContext(dctx);
+                }
+            }
+            LZ4F_freeDecompressionContext(dctx);
+            free(src);
+            if (n<4) goto _output_error;
+            DISPLAYLEVEL(3, "Corrupted blocks correctly detected \n");
+        }
+
         errorCode = LZ4F_freeCompressionContext(cctx);
         if (LZ4F_isError(errorCode)) goto _output_error;
     }
@@ -520,6 +799,734 @@ _output_error:
 }
 
 
+/* lz4g : every API must produce the same frame as the single-threaded FILE* one, and decode it back */
+#define FUZ_LZ4G_INFILE  "frametest-lz4g.tmp"
+#define FUZ_LZ4G_OUTFILE "frametest-lz4g.tmp.out"
+
+/* FUZ_lz4gLegacyRun() : compresses (or decompresses) src into dst, through the context-less lz4g API,
+ * which closes both files on success.
+ * result : size written into dst, or (size_t)-1 on error */
+static size_t FUZ_lz4gLegacyRun(int decompress, int compressionLevel,
+                                const void* src, size_t srcSize, void* dst, size_t dstCapacity)
+{
+    char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    FILE* inFile = fopen(FUZ_LZ4G_INFILE, "wb");
+    FILE* outFile = NULL;
+    size_t resultSize = (size_t)-1;
+    int result;
+
+    if (inFile == NULL) { DISPLAYLEVEL(2, "cannot create %s \n", FUZ_LZ4G_INFILE); return (size_t)-1; }
+    result = (fwrite(src, 1, srcSize, inFile) != srcSize);
+    fclose(inFile);
+    inFile = NULL;
+    if (result) goto _end;
+    inFile = fopen(FUZ_LZ4G_INFILE, "rb");
+    outFile = fopen(FUZ_LZ4G_OUTFILE, "wb");
+    if ((inFile == NULL) || (outFile == NULL)) goto _end;
+    if (decompress)
+        result = LZ4G_decompressFramedFileStream(inFile, outFile, &errString, &errSize);
+    else
+        result = LZ4G_compressFramedFileStream(inFile, outFile, compressionLevel, &errString, &errSize);
+    if (result) { DISPLAYLEVEL(3, "%s\n", errBuff); goto _end; }
+    inFile = outFile = NULL;   /* closed by lz4g */
+
+    outFile = fopen(FUZ_LZ4G_OUTFILE, "rb");
+    if (outFile == NULL) goto _end;
+    resultSize = fread(dst, 1, dstCapacity, outFile);
+    if ((resultSize == dstCapacity) && (fgetc(outFile) != EOF)) resultSize = (size_t)-1;   /* larger than dstCapacity */
+_end:
+    if (inFile) fclose(inFile);
+    if (outFile) fclose(outFile);
+    remove(FUZ_LZ4G_INFILE);
+    remove(FUZ_LZ4G_OUTFILE);
+    return resultSize;
+}
+
+typedef struct {
+    char*  buffer;
+    size_t size;
+    size_t pos;
+} FUZ_memStream_t;
+
+static size_t FUZ_memRead(void* opaque, void* buffer, size_t size)
+{
+    FUZ_memStream_t* const stream = (FUZ_memStream_t*)opaque;
+    if (size > stream->size - stream->pos) size = stream->size - stream->pos;
+    memcpy(buffer, stream->buffer + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+static size_t FUZ_memWrite(void* opaque, const void* buffer, size_t size)
+{
+    FUZ_memStream_t* const stream = (FUZ_memStream_t*)opaque;
+    if (size > stream->size - stream->pos) return 0;
+    memcpy(stream->buffer + stream->pos, buffer, size);
+    stream->pos += size;
+    return size;
+}
+
+typedef enum { FUZ_fileApi, FUZ_callbackApi, FUZ_fdApi } FUZ_lz4gApi_t;
+static const char* const FUZ_lz4gApiNames[] = { "FILE*", "callback", "fd" };
+#define FUZ_NB_LZ4G_APIS (2 + FUZ_FDAPI)
+
+/* FUZ_lz4gRunFile() : compresses (or decompresses) inFile into dst, through the FILE* or fd lz4g API.
+ * result : size written into dst, or (size_t)-1 on error */
+static size_t FUZ_lz4gRunFile(LZ4G_ctx* ctx, FUZ_lz4gApi_t api, int decompress, int compressionLevel,
+                              FILE* inFile, void* dst, size_t dstCapacity)
+{
+    char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    FILE* const outFile = tmpfile();
+    long resultSize = -1;
+    int result;
+
+    if (outFile == NULL) { DISPLAYLEVEL(2, "tmpfile() failed \n"); return (size_t)-1; }
+#if FUZ_FDAPI
+    if (api == FUZ_fdApi)
+    {
+        if (decompress)
+            result = LZ4G_decompressFd_withCtx(ctx, fileno(inFile), fileno(outFile), &errString, &errSize);
+        else
+            result = LZ4G_compressFd_withCtx(ctx, fileno(inFile), fileno(outFile), compressionLevel, &errString, &errSize);
+    }
+    else
+#endif
+    {
+        if (decompress)
+            result = LZ4G_decompressFramedFileStream_withCtx(ctx, inFile, outFile, &errString, &errSize);
+        else
+            result = LZ4G_compressFramedFileStream_withCtx(ctx, inFile, outFile, compressionLevel, &errString, &errSize);
+    }
+    if (result) { DISPLAYLEVEL(3, "%s\n", errBuff); goto _end; }
+    fseek(outFile, 0, SEEK_END);
+    resultSize = ftell(outFile);
+    if ((resultSize < 0) || ((size_t)resultSize > dstCapacity)) { resultSize = -1; goto _end; }
+    rewind(outFile);
+    if (fread(dst, 1, (size_t)resultSize, outFile) != (size_t)resultSize) resultSize = -1;
+_end:
+    fclose(outFile);
+    return (resultSize < 0) ? (size_t)-1 : (size_t)resultSize;
+}
+
+/* FUZ_lz4gRun() : compresses (or decompresses) src into dst, through one of the lz4g streaming APIs.
+ * result : size written into dst, or (size_t)-1 on error */
+static size_t FUZ_lz4gRun(LZ4G_ctx* ctx, FUZ_lz4gApi_t api, int decompress, int compressionLevel,
+                          const void* src, size_t srcSize, void* dst, size_t dstCapacity)
+{
+    FILE* inFile;
+    size_t result = (size_t)-1;
+
+    if (api == FUZ_callbackApi)
+    {
+        char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+        FUZ_memStream_t in, out;
+        int error;
+        in.buffer = (char*)src; in.size = srcSize; in.pos = 0;
+        out.buffer = (char*)dst; out.size = dstCapacity; out.pos = 0;
+        if (decompress)
+            error = LZ4G_decompressStream_withCtx(ctx, FUZ_memRead, &in, FUZ_memWrite, &out, &errString, &errSize);
+        else
+            error = LZ4G_compressStream_withCtx(ctx, FUZ_memRead, &in, FUZ_memWrite, &out, compressionLevel, &errString, &errSize);
+        if (error) { DISPLAYLEVEL(3, "%s\n", errBuff); return (size_t)-1; }
+        return out.pos;
+    }
+
+    inFile = tmpfile();
+    if (inFile == NULL) { DISPLAYLEVEL(2, "tmpfile() failed \n"); return (size_t)-1; }
+    if (fwrite(src, 1, srcSize, inFile) == srcSize)
+    {
+        fflush(inFile);
+        rewind(inFile);
+        result = FUZ_lz4gRunFile(ctx, api, decompress, compressionLevel, inFile, dst, dstCapacity);
+    }
+    fclose(inFile);
+    return result;
+}
+
+/* FUZ_lz4gReadRange() : LZ4G_readRange() over a file holding frame; result : lz4g error code, 0 on success */
+static int FUZ_lz4gReadRange(LZ4G_ctx* ctx, const void* frame, size_t frameSize,
+                             unsigned long long offset, void* dst, size_t size, size_t* readSize)
+{
+    char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    FILE* const file = tmpfile();
+    int result = -1;
+    *readSize = 0;
+    if (file == NULL) { DISPLAYLEVEL(2, "tmpfile() failed \n"); return -1; }
+    if (fwrite(frame, 1, frameSize, file) == frameSize)
+    {
+        fflush(file);
+        result = LZ4G_readRange(ctx, file, offset, dst, size, readSize, &errString, &errSize);
+        if (result) DISPLAYLEVEL(3, "%s\n", errBuff);
+    }
+    fclose(file);
+    return result;
+}
+
+/* FUZ_readerJob() : random reads through a shared LZ4G_reader, checked against source */
+#define FUZ_READER_NBREADS 300
+#define FUZ_READER_MAXREAD (200 KB)
+typedef struct {
+    LZ4G_reader* reader;
+    const char* src;
+    size_t srcSize;
+    U32 seed;
+    int error;
+} FUZ_readerJob_t;
+
+static void* FUZ_readerJob(void* arg)
+{
+    FUZ_readerJob_t* const job = (FUZ_readerJob_t*)arg;
+    char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    char* const dst = (char*)malloc(FUZ_READER_MAXREAD);
+    U32 randState = job->seed;
+    unsigned n;
+
+    job->error = (dst == NULL);
+    for (n=0; (n<FUZ_READER_NBREADS) && !job->error; n++)
+    {
+        size_t const offset = FUZ_rand(&randState) % (job->srcSize + 1000);   /* also beyond content */
+        size_t const size = (FUZ_rand(&randState) & 1) ? FUZ_rand(&randState) % FUZ_READER_MAXREAD : FUZ_rand(&randState) % 100;
+        size_t const expected = (offset >= job->srcSize) ? 0 : (size < job->srcSize - offset) ? size : job->srcSize - offset;
+        size_t readSize;
+        if (LZ4G_readerRead(job->reader, offset, dst, size, &readSize, &errString, &errSize)) { DISPLAY("%s\n", errBuff); job->error = 1; }
+        else if ((readSize != expected) || memcmp(dst, job->src + offset, readSize))
+        {
+            DISPLAY("LZ4G_readerRead(%u, %u) : wrong result (%u bytes) \n", (U32)offset, (U32)size, (U32)readSize);
+            job->error = 1;
+        }
+    }
+    free(dst);
+    return NULL;
+}
+
+#define FUZ_LZ4G_NBTHREADS 4
+
+int lz4gTests(U32 seed, double compressibility)
+{
+    static const size_t testSizes[] = { 0, 1, 64 KB, 64 KB + 1, 1 MB + 12345 };   /* 64 KB : one block (blockSizeID 4) */
+    size_t const srcMax = 1 MB + 12345;
+    size_t const frameMax = 2*srcMax + 64 KB;
+    static const char* const ctxNames[] = { "single-threaded", "multi-threaded", "async I/O" };
+    int testResult = 0;
+    U32 randState = seed;
+    char* src = (char*)malloc(srcMax);
+    char* refFrame = (char*)malloc(frameMax);
+    char* frame = (char*)malloc(frameMax);
+    char* decoded = (char*)malloc(srcMax);
+    LZ4G_ctx* ctxs[3] = { NULL, NULL, NULL };   /* nbThreads 1, nbThreads FUZ_LZ4G_NBTHREADS, asyncIO */
+    LZ4G_params_t params;
+    unsigned sizeNb, config, ctxNb, apiNb;
+    int level;
+
+    if ((src==NULL) || (refFrame==NULL) || (frame==NULL) || (decoded==NULL)) goto _output_error;
+    for (ctxNb=0; ctxNb<3; ctxNb++)
+    {
+        ctxs[ctxNb] = LZ4G_createCtx(NULL);
+        if (ctxs[ctxNb]==NULL) goto _output_error;
+        LZ4G_getCtxParams(ctxs[ctxNb], &params);
+        params.blockSizeID = 4;
+        params.blockIndependence = 1;
+        params.streamChecksum = 1;
+        params.contentSize = 0;
+        params.nbThreads = (ctxNb==1) ? FUZ_LZ4G_NBTHREADS : 1;
+        params.asyncIO = (ctxNb==2);
+        if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+    }
+    FUZ_fillCompressibleNoiseBuffer(src, (unsigned)srcMax, compressibility, &randState);
+    {   /* incompressible tail : last blocks are stored uncompressed */
+        size_t i;
+        for (i = srcMax - 100 KB; i < srcMax; i++) src[i] = (char)FUZ_rand(&randState);
+    }
+    memset(src + 200 KB, 0, 300 KB);   /* zero run : holes in sparse output */
+
+    for (sizeNb=0; sizeNb < sizeof(testSizes)/sizeof(testSizes[0]); sizeNb++)
+    for (config=0; config<8; config++)
+    {
+        size_t const srcSize = testSizes[sizeNb];
+        size_t refSize, resultSize;
+
+        level = (config & 1) ? 9 : 1;
+        DISPLAYLEVEL(3, "lz4g : %u bytes, level %i, block checksum %u, seekable %u \n", (U32)srcSize, level, (config>>1) & 1, (config>>2) & 1);
+        for (ctxNb=0; ctxNb<3; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.blockChecksum = (config>>1) & 1;
+            params.seekable = (config>>2) & 1;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+        }
+
+        /* reference : single-threaded FILE* */
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, level, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+
+        /* compression : byte-identical frames */
+        for (ctxNb=0; ctxNb<3; ctxNb++)
+        for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+        {
+            if ((ctxNb==0) && (apiNb==FUZ_fileApi)) continue;
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 0, level, src, srcSize, frame, frameMax);
+            if ((resultSize != refSize) || memcmp(frame, refFrame, refSize))
+            {
+                DISPLAY("lz4g : %s %s compression of %u bytes differs from single-threaded FILE* one (%i / %i bytes) \n",
+                        ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb], (U32)srcSize, (int)resultSize, (int)refSize);
+                goto _output_error;
+            }
+        }
+
+        /* context-less API, with the same settings */
+        LZ4G_setBlockSizeID(4);
+        LZ4G_setNbThreads(FUZ_LZ4G_NBTHREADS);
+        LZ4G_setBlockChecksumMode((config>>1) & 1);
+        LZ4G_setSeekable((config>>2) & 1);
+        resultSize = FUZ_lz4gLegacyRun(0, level, src, srcSize, frame, frameMax);
+        LZ4G_setBlockSizeID(7);
+        LZ4G_setNbThreads(1);
+        LZ4G_setBlockChecksumMode(0);
+        LZ4G_setSeekable(0);
+        if ((resultSize != refSize) || memcmp(frame, refFrame, refSize))
+        {
+            DISPLAY("lz4g : context-less compression of %u bytes differs from single-threaded one \n", (U32)srcSize);
+            goto _output_error;
+        }
+
+        /* decompression */
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+        {
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 1, 0, refFrame, refSize, decoded, srcMax);
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize))
+            {
+                DISPLAY("lz4g : %s %s decompression of %u bytes failed \n", ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb], (U32)srcSize);
+                goto _output_error;
+            }
+        }
+        resultSize = FUZ_lz4gLegacyRun(1, 0, refFrame, refSize, decoded, srcMax);
+        if ((resultSize != srcSize) || memcmp(decoded, src, srcSize))
+        {
+            DISPLAY("lz4g : context-less decompression of %u bytes failed \n", (U32)srcSize);
+            goto _output_error;
+        }
+
+        /* buffer API : round trip, through a frame recording its content size */
+        {
+            char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+            unsigned long long contentSize;
+            if (LZ4G_compressFrameBound(ctxs[1], srcSize) > frameMax) goto _output_error;
+            if (LZ4G_compressFrameToBuffer(ctxs[1], frame, frameMax, &resultSize, src, srcSize, level, &errString, &errSize)) { DISPLAY("%s\n", errBuff); goto _output_error; }
+            if (srcSize && (LZ4G_getFrameContentSize(frame, resultSize, &contentSize) || (contentSize != srcSize)))
+            {
+                DISPLAY("lz4g : buffer frame of %u bytes does not record its content size \n", (U32)srcSize);
+                goto _output_error;
+            }
+            if (LZ4G_decompressFrameToBuffer(ctxs[1], decoded, srcMax, &resultSize, frame, resultSize, &errString, &errSize)) { DISPLAY("%s\n", errBuff); goto _output_error; }
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) { DISPLAY("lz4g : buffer round trip of %u bytes failed \n", (U32)srcSize); goto _output_error; }
+        }
+
+        /* corrupted frame : error, then the same context decodes a valid frame */
+        if (srcSize > 64 KB)
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        {
+            size_t const pos = 7 + 4 + 100;   /* within first block (frame header, block size) */
+            refFrame[pos] ^= 0x10;
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], FUZ_fileApi, 1, 0, refFrame, refSize, decoded, srcMax);
+            refFrame[pos] ^= 0x10;
+            if (resultSize != (size_t)-1) { DISPLAY("lz4g : %s decompression of a corrupted frame not detected \n", ctxNames[ctxNb]); goto _output_error; }
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], FUZ_fileApi, 1, 0, refFrame, refSize, decoded, srcMax);
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize))
+            {
+                DISPLAY("lz4g : %s context not reusable after an error \n", ctxNames[ctxNb]);
+                goto _output_error;
+            }
+        }
+    }
+
+    for (ctxNb=0; ctxNb<3; ctxNb++)
+    {
+        LZ4G_getCtxParams(ctxs[ctxNb], &params);
+        params.blockChecksum = 0;
+        params.seekable = 0;
+        if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+    }
+
+    /* seekable frame : LZ4G_readRange() decodes any range, up to end of content */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        size_t const footerSize = 10, entrySize = 8;
+        char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+        FILE* const file = tmpfile();
+        size_t refSize, readSize;
+        unsigned n;
+        DISPLAYLEVEL(3, "LZ4G_readRange() of a seekable frame : ");
+        if (file == NULL) goto _output_error;
+        LZ4G_getCtxParams(ctxs[1], &params);
+        params.seekable = 1;
+        if (LZ4G_setCtxParams(ctxs[1], &params)) { fclose(file); goto _output_error; }
+        refSize = FUZ_lz4gRun(ctxs[1], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        params.seekable = 0;
+        if (LZ4G_setCtxParams(ctxs[1], &params) || (refSize == (size_t)-1)) { fclose(file); goto _output_error; }
+        if (fwrite(refFrame, 1, refSize, file) != refSize) { fclose(file); goto _output_error; }
+        fflush(file);
+        for (n=0; n<50; n++)
+        {
+            size_t const offset = FUZ_rand(&randState) % (srcSize + 1000);   /* also beyond content */
+            size_t const size = (FUZ_rand(&randState) & 1) ? FUZ_rand(&randState) % (300 KB) : FUZ_rand(&randState) % 100;
+            size_t const expected = (offset >= srcSize) ? 0 : (size < srcSize - offset) ? size : srcSize - offset;
+            if (LZ4G_readRange(ctxs[0], file, offset, decoded, size, &readSize, &errString, &errSize)) { DISPLAY("%s\n", errBuff); fclose(file); goto _output_error; }
+            if ((readSize != expected) || memcmp(decoded, src + offset, readSize))
+            {
+                DISPLAY("LZ4G_readRange(%u, %u) : wrong result (%u bytes) \n", (U32)offset, (U32)size, (U32)readSize);
+                fclose(file);
+                goto _output_error;
+            }
+        }
+        DISPLAYLEVEL(3, "OK \n");
+
+        DISPLAYLEVEL(3, "forged block index : ");
+        memcpy(frame, refFrame, refSize);
+        FUZ_writeLE32(frame + refSize - footerSize - 4, 0xFFFFFFF0U);       /* last decoded size : beyond block size */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        FUZ_writeLE32(frame + refSize - footerSize - 4, 0);                 /* last decoded size : empty block */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        memcpy(frame, refFrame, refSize);
+        FUZ_writeLE32(frame + refSize - footerSize - entrySize, 0x7FFFFFF0U); /* last compressed size : beyond block size */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        FUZ_writeLE32(frame + refSize - footerSize - entrySize, FUZ_readLE32(refFrame + refSize - footerSize - entrySize) + 1);   /* frame header is then misplaced */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        memcpy(frame, refFrame, refSize);
+        frame[0] ^= 1;                                                      /* magic number */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        memcpy(frame, refFrame, refSize);
+        frame[5] = (char)(7 << 4);                                          /* block size, header checksum no longer matches */
+        if (!FUZ_lz4gReadRange(ctxs[0], frame, refSize, 0, decoded, 1000, &readSize)) { fclose(file); goto _output_error; }
+        DISPLAYLEVEL(3, "rejected \n");
+
+        /* random-access reader : concurrent random reads, then LZ4G_readRange() on the same file */
+        {
+            static const size_t cacheSizes[] = { 0, 256 KB, 4 MB };   /* none, less than content, all of it */
+            FUZ_readerJob_t jobs[FUZ_LZ4G_NBTHREADS];
+            unsigned cacheNb, jobNb;
+
+            for (cacheNb=0; cacheNb < sizeof(cacheSizes)/sizeof(cacheSizes[0]); cacheNb++)
+            {
+                LZ4G_reader* reader;
+                int error = 0;
+                DISPLAYLEVEL(3, "LZ4G_readerRead() from %i threads, cache of %u KB : ", FUZ_LZ4G_NBTHREADS, (U32)(cacheSizes[cacheNb] >> 10));
+                if (LZ4G_createReader(&reader, file, cacheSizes[cacheNb], &errString, &errSize)) { DISPLAY("%s\n", errBuff); fclose(file); goto _output_error; }
+                if (LZ4G_readerContentSize(reader) != srcSize) error = 1;
+                for (jobNb=0; jobNb<FUZ_LZ4G_NBTHREADS; jobNb++)
+                {
+                    jobs[jobNb].reader = reader;
+                    jobs[jobNb].src = src;
+                    jobs[jobNb].srcSize = srcSize;
+                    jobs[jobNb].seed = FUZ_rand(&randState);
+                    jobs[jobNb].error = 0;
+                }
+#if FUZ_THREADS
+                {
+                    pthread_t threads[FUZ_LZ4G_NBTHREADS];
+                    int started[FUZ_LZ4G_NBTHREADS];
+                    for (jobNb=0; jobNb<FUZ_LZ4G_NBTHREADS; jobNb++)
+                        started[jobNb] = !pthread_create(&threads[jobNb], NULL, FUZ_readerJob, &jobs[jobNb]);
+                    for (jobNb=0; jobNb<FUZ_LZ4G_NBTHREADS; jobNb++)
+                    {
+                        if (started[jobNb]) pthread_join(threads[jobNb], NULL);
+                        else jobs[jobNb].error = 1;
+                    }
+                }
+#else
+                for (jobNb=0; jobNb<FUZ_LZ4G_NBTHREADS; jobNb++) FUZ_readerJob(&jobs[jobNb]);
+#endif
+                for (jobNb=0; jobNb<FUZ_LZ4G_NBTHREADS; jobNb++) error |= jobs[jobNb].error;
+
+                /* LZ4G_readRange() moves file position : reader must not depend on it */
+                for (n=0; (n<20) && !error; n++)
+                {
+                    size_t const offset = FUZ_rand(&randState) % srcSize;
+                    size_t const size = FUZ_rand(&randState) % (srcSize - offset + 1);
+                    if (LZ4G_readRange(ctxs[0], file, offset, decoded, size, &readSize, &errString, &errSize)) { DISPLAY("%s\n", errBuff); error = 1; }
+                    else if ((readSize != size) || memcmp(decoded, src + offset, size)) error = 1;
+                }
+                if (!error)
+                {
+                    jobs[0].seed = FUZ_rand(&randState);
+                    FUZ_readerJob(&jobs[0]);
+                    error = jobs[0].error;
+                }
+                LZ4G_freeReader(reader);
+                if (error) { fclose(file); goto _output_error; }
+                DISPLAYLEVEL(3, "OK \n");
+            }
+        }
+        fclose(file);
+    }
+
+    /* content size : written into frame header from regular file inputs, whatever the context */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        unsigned long long contentSize;
+        size_t refSize, resultSize;
+        DISPLAYLEVEL(3, "lz4g content size of regular files : ");
+        for (ctxNb=0; ctxNb<3; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.contentSize = 1;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+        }
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+        if (LZ4G_getFrameContentSize(refFrame, refSize, &contentSize) || (contentSize != srcSize)) goto _output_error;
+        for (ctxNb=0; ctxNb<3; ctxNb++)
+        for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+        {
+            if (apiNb != FUZ_callbackApi)   /* not a regular file */
+            {
+                resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 0, 1, src, srcSize, frame, frameMax);
+                if ((resultSize != refSize) || memcmp(frame, refFrame, refSize)) goto _output_error;
+            }
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 1, 0, refFrame, refSize, decoded, srcMax);
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) goto _output_error;
+        }
+        for (ctxNb=0; ctxNb<3; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.contentSize = 0;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+#if FUZ_FDAPI
+    /* file descriptor API : output written through io_uring with O_DIRECT, where supported, unaligned end included */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        size_t refSize, resultSize;
+        DISPLAYLEVEL(3, "lz4g direct I/O : ");
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.directIO = 1;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], FUZ_fdApi, 1, 0, refFrame, refSize, decoded, srcMax);
+            params.directIO = 0;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) goto _output_error;
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+#endif
+
+    /* sparse output : zero runs are skipped, content is unchanged */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        unsigned long long storedSkips = 0;
+        FILE* const file = tmpfile();
+        size_t refSize, resultSize;
+        DISPLAYLEVEL(3, "lz4g sparse output : ");
+        if (file == NULL) goto _output_error;
+        if (LZ4G_sparseWrite(file, src, srcSize, &storedSkips) || LZ4G_sparseWriteEnd(file, storedSkips)) { fclose(file); goto _output_error; }
+        rewind(file);
+        resultSize = fread(decoded, 1, srcMax, file);
+        fclose(file);
+        if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) goto _output_error;
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.sparseFileSupport = 1;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 1, 0, refFrame, refSize, decoded, srcMax);
+            params.sparseFileSupport = 0;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) goto _output_error;
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+    /* sparse input : holes are compressed as zeroes, frames are unchanged */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        unsigned long long storedSkips = 0;
+        FILE* const file = tmpfile();
+        size_t refSize, resultSize;
+        DISPLAYLEVEL(3, "lz4g sparse input : ");
+        if (file == NULL) goto _output_error;
+        if (LZ4G_sparseWrite(file, src, srcSize, &storedSkips) || LZ4G_sparseWriteEnd(file, storedSkips)) { fclose(file); goto _output_error; }
+        for (level=1; level<=9; level+=8)
+        {
+            refSize = FUZ_lz4gRun(ctxs[0], FUZ_callbackApi, 0, level, src, srcSize, refFrame, frameMax);
+            for (ctxNb=0; ctxNb<3; ctxNb++)
+            for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+            {
+                if (apiNb == FUZ_callbackApi) continue;
+                rewind(file);
+                resultSize = FUZ_lz4gRunFile(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 0, level, file, frame, frameMax);
+                if ((refSize == (size_t)-1) || (resultSize != refSize) || memcmp(frame, refFrame, refSize))
+                {
+                    DISPLAY("lz4g : %s %s compression of a sparse file differs from dense one \n", ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb]);
+                    fclose(file);
+                    goto _output_error;
+                }
+            }
+        }
+        fclose(file);
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+    /* dictionary : same frames from every context and API, recorded dictID, and small records gain from it */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        size_t const dictSize = 64 KB;
+        const char* const dict = src + 600 KB;
+        const char* const record = dict + dictSize - 10 KB;   /* shares its content with dict */
+        size_t const recordSize = 4 KB;
+        unsigned const dictID = 0x1234;
+        unsigned frameDictID;
+        size_t refSize, resultSize, noDictSize;
+        DISPLAYLEVEL(3, "lz4g dictionary : ");
+        noDictSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, record, recordSize, frame, frameMax);
+        for (ctxNb=0; ctxNb<3; ctxNb++) if (LZ4G_loadDictionary(ctxs[ctxNb], dict, dictSize, dictID)) goto _output_error;
+        for (level=1; level<=9; level+=8)
+        {
+            refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, level, src, srcSize, refFrame, frameMax);
+            if (refSize == (size_t)-1) goto _output_error;
+            if (LZ4G_getFrameDictID(refFrame, refSize, &frameDictID) || (frameDictID != dictID)) goto _output_error;
+            for (ctxNb=0; ctxNb<3; ctxNb++)
+            for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+            {
+                resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 0, level, src, srcSize, frame, frameMax);
+                if ((resultSize != refSize) || memcmp(frame, refFrame, refSize))
+                {
+                    DISPLAY("lz4g : %s %s compression with a dictionary differs from single-threaded FILE* one \n", ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb]);
+                    goto _output_error;
+                }
+                if (ctxNb==2) continue;
+                resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 1, 0, refFrame, refSize, decoded, srcMax);
+                if ((resultSize != srcSize) || memcmp(decoded, src, srcSize))
+                {
+                    DISPLAY("lz4g : %s %s decompression with a dictionary failed \n", ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb]);
+                    goto _output_error;
+                }
+            }
+        }
+        resultSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, record, recordSize, frame, frameMax);
+        if ((noDictSize == (size_t)-1) || (resultSize > noDictSize / 4))
+        {
+            DISPLAY("lz4g : record compressed into %u bytes with a dictionary, %u bytes without \n", (U32)resultSize, (U32)noDictSize);
+            goto _output_error;
+        }
+        {   /* random-access reader of a seekable frame, with the dictionary */
+            char errBuff[256]; char* errString = errBuff; int errSize = sizeof(errBuff);
+            FILE* const file = tmpfile();
+            LZ4G_reader* reader;
+            FUZ_readerJob_t job;
+            if (file == NULL) goto _output_error;
+            LZ4G_getCtxParams(ctxs[1], &params);
+            params.seekable = 1;
+            if (LZ4G_setCtxParams(ctxs[1], &params)) { fclose(file); goto _output_error; }
+            resultSize = FUZ_lz4gRun(ctxs[1], FUZ_fileApi, 0, 1, src, srcSize, frame, frameMax);
+            params.seekable = 0;
+            if (LZ4G_setCtxParams(ctxs[1], &params) || (resultSize == (size_t)-1)) { fclose(file); goto _output_error; }
+            if (fwrite(frame, 1, resultSize, file) != resultSize) { fclose(file); goto _output_error; }
+            fflush(file);
+            if (LZ4G_createReader(&reader, file, 256 KB, &errString, &errSize)) { DISPLAY("%s\n", errBuff); fclose(file); goto _output_error; }
+            job.reader = reader;
+            job.src = src;
+            job.srcSize = srcSize;
+            job.seed = FUZ_rand(&randState);
+            job.error = LZ4G_readerLoadDictionary(reader, dict, dictSize);
+            if (!job.error) FUZ_readerJob(&job);
+            LZ4G_freeReader(reader);
+            fclose(file);
+            if (job.error) goto _output_error;
+        }
+        for (ctxNb=0; ctxNb<3; ctxNb++) LZ4G_loadDictionary(ctxs[ctxNb], NULL, 0, 0);
+        if (FUZ_lz4gRun(ctxs[1], FUZ_fileApi, 1, 0, refFrame, refSize, decoded, srcMax) != (size_t)-1)
+        {
+            DISPLAY("lz4g : frame requiring a dictionary decoded without it \n");
+            goto _output_error;
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+    /* block checksums : a corrupted block is detected by every decoder, without content checksum */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        size_t const pos = 7 + 4 + 100;   /* within first block */
+        size_t refSize, resultSize;
+        DISPLAYLEVEL(3, "lz4g block checksums : ");
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.blockChecksum = 1;
+            params.streamChecksum = 0;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+        }
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+        refFrame[pos] ^= 0x10;
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        for (apiNb=0; apiNb<FUZ_NB_LZ4G_APIS; apiNb++)
+        {
+            resultSize = FUZ_lz4gRun(ctxs[ctxNb], (FUZ_lz4gApi_t)apiNb, 1, 0, refFrame, refSize, decoded, srcMax);
+            if (resultSize != (size_t)-1)
+            {
+                DISPLAY("lz4g : %s %s decompression of a corrupted block not detected \n", ctxNames[ctxNb], FUZ_lz4gApiNames[apiNb]);
+                goto _output_error;
+            }
+        }
+        refFrame[pos] ^= 0x10;
+        for (ctxNb=0; ctxNb<2; ctxNb++)
+        {
+            LZ4G_getCtxParams(ctxs[ctxNb], &params);
+            params.blockChecksum = 0;
+            params.streamChecksum = 1;
+            if (LZ4G_setCtxParams(ctxs[ctxNb], &params)) goto _output_error;
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+    /* context-less API : a pooled context goes back to the pool after an error, and LZ4G_freePool() releases it */
+    {
+        size_t const srcSize = testSizes[sizeof(testSizes)/sizeof(testSizes[0]) - 1];
+        size_t const pos = 7 + 4 + 100;   /* within first block */
+        size_t refSize, resultSize;
+        unsigned n;
+        DISPLAYLEVEL(3, "lz4g context pool : ");
+        refSize = FUZ_lz4gRun(ctxs[0], FUZ_fileApi, 0, 1, src, srcSize, refFrame, frameMax);
+        if (refSize == (size_t)-1) goto _output_error;
+        refFrame[pos] ^= 0x10;
+        resultSize = FUZ_lz4gLegacyRun(1, 0, refFrame, refSize, decoded, srcMax);
+        refFrame[pos] ^= 0x10;
+        if (resultSize != (size_t)-1) goto _output_error;
+        for (n=0; n<2; n++)   /* context back from the pool, then a new one after LZ4G_freePool() */
+        {
+            resultSize = FUZ_lz4gLegacyRun(1, 0, refFrame, refSize, decoded, srcMax);
+            if ((resultSize != srcSize) || memcmp(decoded, src, srcSize)) goto _output_error;
+            LZ4G_freePool();
+        }
+        DISPLAYLEVEL(3, "OK \n");
+    }
+
+    DISPLAY("lz4g tests completed \n");
+_end:
+    for (ctxNb=0; ctxNb<3; ctxNb++) LZ4G_freeCtx(ctxs[ctxNb]);
+    free(src);
+    free(refFrame);
+    free(frame);
+    free(decoded);
+    return testResult;
+
+_output_error:
+    testResult = 1;
+    DISPLAY("Error detected ! \n");
+    goto _end;
+}
+
+
 static void locateBuffDiff(const void* buff1, const void* buff2, size_t size, unsigned nonContiguous)
 {
     int p=0;
@@ -575,6 +1582,7 @@ int fuzzerTests(U32 seed, unsigned nbTests, unsigned startTest, double compressi
         unsigned BSId   = 4 + (FUZ_rand(&randState) & 3);
         unsigned BMId   = FUZ_rand(&randState) & 1;
         unsigned CCflag = FUZ_rand(&randState) & 1;
+        unsigned BCflag = FUZ_rand(&randState) & 1;
         unsigned autoflush = (FUZ_rand(&randState) & 7) == 2;
         LZ4F_preferences_t prefs;
         LZ4F_compressOptions_t cOptions;
@@ -594,6 +1602,7 @@ int fuzzerTests(U32 seed, unsigned nbTests, unsigned startTest, double compressi
         prefs.frameInfo.blockMode = (blockMode_t)BMId;
         prefs.frameInfo.blockSizeID = (blockSizeID_t)BSId;
         prefs.frameInfo.contentChecksumFlag = (contentChecksum_t)CCflag;
+        prefs.frameInfo.blockChecksumFlag = (blockChecksum_t)BCflag;
         prefs.frameInfo.contentSize = frameContentSize;
         prefs.autoFlush = autoflush;
         prefs.compressionLevel = FUZ_rand(&randState) % 5;
@@ -840,6 +1849,7 @@ int main(int argc, char** argv)
     if (nbTests<=0) nbTests=1;
 
     if (testNb==0) result = basicTests(seed, ((double)proba) / 100);
+    if (testNb==0 && !result) result = lz4gTests(seed, ((double)proba) / 100);
     if (result) return 1;
     return fuzzerTests(seed, nbTests, testNb, ((double)proba) / 100);
 }
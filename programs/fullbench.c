@@ -63,6 +63,7 @@
 #include "lz4.h"
 #include "lz4hc.h"
 #include "lz4frame.h"
+#include "lz4g.h"
 
 #include "xxhash.h"
 
@@ -398,6 +399,54 @@ static int local_LZ4_compress_limitedOutput_withState(const char* in, char* out,
 }
 
 static LZ4_stream_t* ctx;
+/* batch compression : all chunks are compressed in a single call (compressionFunction==NULL) */
+static const char** batchSources;
+static char** batchDests;
+static int* batchSizes;
+static int* batchCapacities;
+static int* batchResults;
+
+static void local_LZ4_compress_batch_init(struct chunkParameters* chunkP, int nbChunks)
+{
+    int i;
+    batchSources = (const char**)malloc(nbChunks * sizeof(*batchSources));
+    batchDests = (char**)malloc(nbChunks * sizeof(*batchDests));
+    batchSizes = (int*)malloc(nbChunks * sizeof(int));
+    batchCapacities = (int*)malloc(nbChunks * sizeof(int));
+    batchResults = (int*)malloc(nbChunks * sizeof(int));
+    if (!batchSources || !batchDests || !batchSizes || !batchCapacities || !batchResults) DISPLAY("batch allocation issue \n"), exit(1);
+    for (i=0; i<nbChunks; i++)
+    {
+        batchSources[i] = chunkP[i].origBuffer;
+        batchDests[i] = chunkP[i].compressedBuffer;
+        batchSizes[i] = chunkP[i].origSize;
+        batchCapacities[i] = LZ4_compressBound(chunkP[i].origSize);
+    }
+}
+
+/* batch decompression : same arrays, from compressed chunks back into original buffers */
+static void local_LZ4_decompress_batch_init(struct chunkParameters* chunkP, int nbChunks)
+{
+    int i;
+    local_LZ4_compress_batch_init(chunkP, nbChunks);
+    for (i=0; i<nbChunks; i++)
+    {
+        batchSources[i] = chunkP[i].compressedBuffer;
+        batchDests[i] = chunkP[i].origBuffer;
+        batchSizes[i] = chunkP[i].compressedSize;
+        batchCapacities[i] = chunkP[i].origSize;
+    }
+}
+
+static void local_LZ4_compress_batch_free(void)
+{
+    free((void*)batchSources); batchSources = NULL;
+    free(batchDests); batchDests = NULL;
+    free(batchSizes); batchSizes = NULL;
+    free(batchCapacities); batchCapacities = NULL;
+    free(batchResults); batchResults = NULL;
+}
+
 static int local_LZ4_compress_continue(const char* in, char* out, int inSize)
 {
     return LZ4_compress_continue(ctx, in, out, inSize);
@@ -469,6 +518,36 @@ static int local_LZ4_saveDictHC(const char* in, char* out, int inSize)
 }
 
 
+/* checksums : digest is written into out, and inSize is returned, like LZ4_saveDict() */
+static int local_XXH32(const char* in, char* out, int inSize)
+{
+    U32 const h32 = XXH32(in, inSize, 0);
+    memcpy(out, &h32, sizeof(h32));
+    return inSize;
+}
+
+/* by 64 KB updates, as frame content checksum does */
+static int local_XXH32_update(const char* in, char* out, int inSize)
+{
+    XXH32_state_t state;
+    U32 h32;
+    int pos;
+    XXH32_reset(&state, 0);
+    for (pos=0; pos<inSize; pos+=64 KB)
+        XXH32_update(&state, in+pos, (inSize-pos < 64 KB) ? (size_t)(inSize-pos) : 64 KB);
+    h32 = XXH32_digest(&state);
+    memcpy(out, &h32, sizeof(h32));
+    return inSize;
+}
+
+static int local_XXH64(const char* in, char* out, int inSize)
+{
+    U64 const h64 = XXH64(in, inSize, 0);
+    memcpy(out, &h64, sizeof(h64));
+    return inSize;
+}
+
+
 static int local_LZ4_decompress_fast(const char* in, char* out, int inSize, int outSize)
 {
     (void)inSize;
@@ -507,6 +586,8 @@ static int local_LZ4_decompress_safe_forceExtDict(const char* in, char* out, int
     return outSize;
 }
 
+extern int LZ4_decompress_safe_forceScalar(const char* in, char* out, int inSize, int outSize);
+
 static int local_LZ4_decompress_safe_partial(const char* in, char* out, int inSize, int outSize)
 {
     return LZ4_decompress_safe_partial(in, out, inSize, outSize - 5, outSize);
@@ -525,15 +606,115 @@ static int local_LZ4F_decompress(const char* in, char* out, int inSize, int outS
     return (int)dstSize;
 }
 
+/* lz4g : callbacks over memory buffers, compared to FILE* (tmpfile) streams */
+typedef struct {
+    char*  buffer;
+    size_t size;
+    size_t pos;
+} memStream_t;
+
+static size_t local_memRead(void* opaque, void* buffer, size_t size)
+{
+    memStream_t* const stream = (memStream_t*)opaque;
+    if (size > stream->size - stream->pos) size = stream->size - stream->pos;
+    memcpy(buffer, stream->buffer + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+static size_t local_memWrite(void* opaque, const void* buffer, size_t size)
+{
+    memStream_t* const stream = (memStream_t*)opaque;
+    if (size > stream->size - stream->pos) return 0;
+    memcpy(stream->buffer + stream->pos, buffer, size);
+    stream->pos += size;
+    return size;
+}
+
+static LZ4G_ctx* g_gCtx;
+static FILE* g_gCInFile;   /* always receives the same data, hence no leftover from previous loops */
+static FILE* g_gDInFile;
+static FILE* g_gOutFile;
+
+static int local_LZ4G_compressStream(const char* in, char* out, int inSize)
+{
+    char errBuff[1024]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    memStream_t src, dst;
+    src.buffer = (char*)in; src.size = inSize; src.pos = 0;
+    dst.buffer = out; dst.size = LZ4F_compressFrameBound(inSize, NULL); dst.pos = 0;
+    if (LZ4G_compressStream_withCtx(g_gCtx, local_memRead, &src, local_memWrite, &dst, 0, &errString, &errSize)) { DISPLAY("%s\n", errBuff); return 0; }
+    return (int)dst.pos;
+}
+
+static int local_LZ4G_decompressStream(const char* in, char* out, int inSize, int outSize)
+{
+    char errBuff[1024]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    memStream_t src, dst;
+    src.buffer = (char*)in; src.size = inSize; src.pos = 0;
+    dst.buffer = out; dst.size = outSize; dst.pos = 0;
+    if (LZ4G_decompressStream_withCtx(g_gCtx, local_memRead, &src, local_memWrite, &dst, &errString, &errSize)) { DISPLAY("%s\n", errBuff); exit(8); }
+    return (int)dst.pos;
+}
+
+static int local_LZ4G_compressFrameToBuffer(const char* in, char* out, int inSize)
+{
+    char errBuff[1024]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    size_t dstSize;
+    if (LZ4G_compressFrameToBuffer(g_gCtx, out, LZ4G_compressFrameBound(g_gCtx, inSize), &dstSize, in, inSize, 0, &errString, &errSize)) { DISPLAY("%s\n", errBuff); return 0; }
+    return (int)dstSize;
+}
+
+static int local_LZ4G_decompressFrameToBuffer(const char* in, char* out, int inSize, int outSize)
+{
+    char errBuff[1024]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    size_t dstSize;
+    if (LZ4G_decompressFrameToBuffer(g_gCtx, out, outSize, &dstSize, in, inSize, &errString, &errSize)) { DISPLAY("%s\n", errBuff); exit(8); }
+    return (int)dstSize;
+}
+
+/* FILE* path : data is written into input file, and result read back from output file, as a pipe user would do */
+static int local_LZ4G_fileStream(const char* in, char* out, int inSize, int outSize, int decompress)
+{
+    char errBuff[1024]; char* errString = errBuff; int errSize = sizeof(errBuff);
+    FILE* const inFile = decompress ? g_gDInFile : g_gCInFile;
+    long resultSize;
+    int result;
+    rewind(inFile);
+    if (fwrite(in, 1, inSize, inFile) != (size_t)inSize) { DISPLAY("tmpfile write error\n"); exit(8); }
+    fflush(inFile);
+    rewind(inFile);
+    rewind(g_gOutFile);
+    if (decompress)
+        result = LZ4G_decompressFramedFileStream_withCtx(g_gCtx, inFile, g_gOutFile, &errString, &errSize);
+    else
+        result = LZ4G_compressFramedFileStream_withCtx(g_gCtx, inFile, g_gOutFile, 0, &errString, &errSize);
+    if (result) { DISPLAY("%s\n", errBuff); exit(8); }
+    resultSize = ftell(g_gOutFile);
+    if ((resultSize < 0) || (resultSize > outSize)) { DISPLAY("tmpfile size error\n"); exit(8); }
+    rewind(g_gOutFile);
+    if (fread(out, 1, (size_t)resultSize, g_gOutFile) != (size_t)resultSize) { DISPLAY("tmpfile read error\n"); exit(8); }
+    return (int)resultSize;
+}
+
+static int local_LZ4G_compressFramedFileStream(const char* in, char* out, int inSize)
+{
+    return local_LZ4G_fileStream(in, out, inSize, (int)LZ4F_compressFrameBound(inSize, NULL), 0);
+}
+
+static int local_LZ4G_decompressFramedFileStream(const char* in, char* out, int inSize, int outSize)
+{
+    return local_LZ4G_fileStream(in, out, inSize, outSize, 1);
+}
+
 
 int fullSpeedBench(char** fileNamesTable, int nbFiles)
 {
   int fileIdx=0;
   char* orig_buff;
-# define NB_COMPRESSION_ALGORITHMS 16
+# define NB_COMPRESSION_ALGORITHMS 23
   double totalCTime[NB_COMPRESSION_ALGORITHMS+1] = {0};
   double totalCSize[NB_COMPRESSION_ALGORITHMS+1] = {0};
-# define NB_DECOMPRESSION_ALGORITHMS 9
+# define NB_DECOMPRESSION_ALGORITHMS 14
   double totalDTime[NB_DECOMPRESSION_ALGORITHMS+1] = {0};
   size_t errorCode;
 
@@ -543,6 +724,12 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
      DISPLAY("dctx allocation issue \n");
      return 10;
   }
+  g_gCtx = LZ4G_createCtx(NULL);
+  if (!g_gCtx)
+  {
+     DISPLAY("lz4g context allocation issue \n");
+     return 10;
+  }
 
   // Loop for each file
   while (fileIdx<nbFiles)
@@ -562,6 +749,14 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
       // Init
       stateLZ4   = LZ4_createStream();
       stateLZ4HC = LZ4_createStreamHC();
+      g_gCInFile = tmpfile();
+      g_gDInFile = tmpfile();
+      g_gOutFile = tmpfile();
+      if (!g_gCInFile || !g_gDInFile || !g_gOutFile)
+      {
+        DISPLAY( "Pb creating tmpfile\n");
+        return 11;
+      }
 
       // Check file existence
       inFileName = fileNamesTable[fileIdx++];
@@ -680,6 +875,21 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
             case 16: compressionFunction = local_LZ4_saveDictHC; compressorName = "LZ4_saveDictHC";
                         LZ4_loadDictHC(&LZ4_dictHC, chunkP[0].origBuffer, chunkP[0].origSize);
                         break;
+            case 17: compressionFunction = local_LZ4G_compressStream; compressorName = "LZ4G_compressStream";
+                        chunkP[0].origSize = (int)benchedSize; nbChunks=1;
+                        break;
+            case 18: compressionFunction = local_LZ4G_compressFramedFileStream; compressorName = "LZ4G_compressFramedFileStream";
+                        chunkP[0].origSize = (int)benchedSize; nbChunks=1;
+                        break;
+            case 19: compressionFunction = local_LZ4G_compressFrameToBuffer; compressorName = "LZ4G_compressFrameToBuffer";
+                        chunkP[0].origSize = (int)benchedSize; nbChunks=1;
+                        break;
+            case 20: compressionFunction = NULL; compressorName = "LZ4_compress_batch_withState";
+                        local_LZ4_compress_batch_init(chunkP, nbChunks);
+                        break;
+            case 21: compressionFunction = local_XXH32; compressorName = "XXH32"; break;
+            case 22: compressionFunction = local_XXH32_update; compressorName = "XXH32_update"; break;
+            case 23: compressionFunction = local_XXH64; compressorName = "XXH64"; break;
             default : DISPLAY("ERROR ! Bad algorithm Id !! \n"); free(chunkP); return 1;
             }
 
@@ -698,10 +908,19 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
                 while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
                 {
                     if (initFunction!=NULL) ctx = (LZ4_stream_t*)initFunction(chunkP[0].origBuffer);
-                    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                    if (compressionFunction==NULL)
+                    {
+                        if (LZ4_compress_batch_withState(stateLZ4, batchSources, batchSizes, batchDests, batchCapacities, batchResults, nbChunks))
+                            DISPLAY("ERROR ! %s() failed !! \n", compressorName), exit(1);
+                        for (chunkNb=0; chunkNb<nbChunks; chunkNb++) chunkP[chunkNb].compressedSize = batchResults[chunkNb];
+                    }
+                    else
                     {
-                        chunkP[chunkNb].compressedSize = compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
-                        if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR ! %s() = 0 !! \n", compressorName), exit(1);
+                        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                        {
+                            chunkP[chunkNb].compressedSize = compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
+                            if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR ! %s() = 0 !! \n", compressorName), exit(1);
+                        }
                     }
                     if (initFunction!=NULL) free(ctx);
                     nb_loops++;
@@ -722,6 +941,7 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
 
             totalCTime[cAlgNb] += bestTime;
             totalCSize[cAlgNb] += cSize;
+            if (compressionFunction==NULL) local_LZ4_compress_batch_free();
         }
 
         // Prepare layout for decompression
@@ -767,7 +987,23 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
             case 6: decompressionFunction = local_LZ4_decompress_safe_usingDict; dName = "LZ4_decompress_safe_usingDict"; break;
             case 7: decompressionFunction = local_LZ4_decompress_safe_partial; dName = "LZ4_decompress_safe_partial"; break;
             case 8: decompressionFunction = local_LZ4_decompress_safe_forceExtDict; dName = "LZ4_decompress_safe_forceExtDict"; break;
-            case 9: decompressionFunction = local_LZ4F_decompress; dName = "LZ4F_decompress";
+            case 9: decompressionFunction = LZ4_decompress_safe_forceScalar; dName = "LZ4_decompress_safe_forceScalar"; break;
+            case 10: decompressionFunction = NULL; dName = "LZ4_decompress_safe_batch";
+                    local_LZ4_decompress_batch_init(chunkP, nbChunks);
+                    break;
+            case 11: decompressionFunction = local_LZ4F_decompress; dName = "LZ4F_decompress";
+                    errorCode = LZ4F_compressFrame(compressed_buff, compressedBuffSize, orig_buff, benchedSize, NULL);
+                    if (LZ4F_isError(errorCode)) { DISPLAY("Preparation error compressing frame\n"); return 1; }
+                    chunkP[0].origSize = (int)benchedSize;
+                    chunkP[0].compressedSize = (int)errorCode;
+                    nbChunks = 1;
+                    break;
+            case 12:
+            case 13:
+            case 14:
+                    if (dAlgNb==12) { decompressionFunction = local_LZ4G_decompressStream; dName = "LZ4G_decompressStream"; }
+                    else if (dAlgNb==13) { decompressionFunction = local_LZ4G_decompressFramedFileStream; dName = "LZ4G_decompressFramedFileStream"; }
+                    else { decompressionFunction = local_LZ4G_decompressFrameToBuffer; dName = "LZ4G_decompressFrameToBuffer"; }
                     errorCode = LZ4F_compressFrame(compressed_buff, compressedBuffSize, orig_buff, benchedSize, NULL);
                     if (LZ4F_isError(errorCode)) { DISPLAY("Preparation error compressing frame\n"); return 1; }
                     chunkP[0].origSize = (int)benchedSize;
@@ -793,10 +1029,18 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
                 milliTime = BMK_GetMilliStart();
                 while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
                 {
-                    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                    if (decompressionFunction==NULL)
                     {
-                        int decodedSize = decompressionFunction(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedSize, chunkP[chunkNb].origSize);
-                        if (chunkP[chunkNb].origSize != decodedSize) DISPLAY("ERROR ! %s() == %i != %i !! \n", dName, decodedSize, chunkP[chunkNb].origSize), exit(1);
+                        if (LZ4_decompress_safe_batch(batchSources, batchDests, batchSizes, batchCapacities, batchResults, nbChunks))
+                            DISPLAY("ERROR ! %s() failed !! \n", dName), exit(1);
+                    }
+                    else
+                    {
+                        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                        {
+                            int decodedSize = decompressionFunction(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedSize, chunkP[chunkNb].origSize);
+                            if (chunkP[chunkNb].origSize != decodedSize) DISPLAY("ERROR ! %s() == %i != %i !! \n", dName, decodedSize, chunkP[chunkNb].origSize), exit(1);
+                        }
                     }
                     nb_loops++;
                 }
@@ -815,6 +1059,7 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
             DISPLAY("%2i-%-29.29s :%10i -> %7.1f MB/s\n", dAlgNb, dName, (int)benchedSize, (double)benchedSize / bestTime / 1000.);
 
             totalDTime[dAlgNb] += bestTime;
+            if (decompressionFunction==NULL) local_LZ4_compress_batch_free();
         }
 
       }
@@ -822,8 +1067,13 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
       free(orig_buff);
       free(compressed_buff);
       free(chunkP);
+      fclose(g_gCInFile);
+      fclose(g_gDInFile);
+      fclose(g_gOutFile);
   }
 
+  LZ4G_freeCtx(g_gCtx);
+
   if (BMK_pause) { printf("press enter...\n"); getchar(); }
 
   return 0;
@@ -847,7 +1097,8 @@ int usage_advanced(void)
     DISPLAY( " -c#    : test only compression function # [1-%i]\n", NB_COMPRESSION_ALGORITHMS);
     DISPLAY( " -d#    : test only decompression function # [1-%i]\n", NB_DECOMPRESSION_ALGORITHMS);
     DISPLAY( " -i#    : iteration loops [1-9](default : %i)\n", NBLOOPS);
-    DISPLAY( " -B#    : Block size [4-7](default : 7)\n");
+    DISPLAY( " -B#    : Block size [0-7](default : 7), from 256 bytes to 4 MB\n");
+    DISPLAY( " -K#    : restrict CPU kernels to instruction sets # (LZ4_CPU_* flags, 0 : baseline)\n");
     return 0;
 }
 
@@ -921,6 +1172,10 @@ int main(int argc, char** argv)
                     while (argument[1]!=0)
                     switch(argument[1])
                     {
+                    case '0':
+                    case '1':
+                    case '2':
+                    case '3':
                     case '4':
                     case '5':
                     case '6':
@@ -948,6 +1203,20 @@ _exit_blockProperties:
                     }
                     break;
 
+                    // Restrict CPU kernels
+                case 'K':
+                    {
+                        unsigned features = 0;
+                        while ((argument[1]>= '0') && (argument[1]<= '9'))
+                        {
+                            features *= 10;
+                            features += argument[1] - '0';
+                            argument++;
+                        }
+                        LZ4_limitCpuFeatures(features);
+                    }
+                    break;
+
                     // Pause at the end (hidden option)
                 case 'p': BMK_SetPause(); break;
 
@@ -966,6 +1235,8 @@ _exit_blockProperties:
     // No input filename ==> Error
     if(!input_filename) { badusage(exename); return 1; }
 
+    DISPLAY("Kernels : %s\n", LZ4_kernelName());
+
     return fullSpeedBench(argv+filenamesStart, argc-filenamesStart);
 
 }
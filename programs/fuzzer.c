@@ -50,6 +50,9 @@
 #include "lz4hc.h"
 #include "xxhash.h"
 
+/* hidden debug function, in lz4.c : decodes without the vector copy routines */
+int LZ4_decompress_safe_forceScalar(const char* source, char* dest, int compressedSize, int maxDecompressedSize);
+
 /* Use ftime() if gettimeofday() is not available on your target */
 #if defined(FUZ_LEGACY_TIMER)
 #  include <sys/timeb.h>   /* timeb, ftime */
@@ -88,6 +91,7 @@ typedef unsigned long long  U64;
 #define COMPRESSIBLE_NOISE_LENGTH (1 << 21)
 #define FUZ_MAX_BLOCK_SIZE (1 << 17)
 #define FUZ_MAX_DICT_SIZE  (1 << 15)
+#define FUZ_MAX_BATCH      16
 #define FUZ_COMPRESSIBILITY_DEFAULT 60
 #define PRIME1   2654435761U
 #define PRIME2   2246822519U
@@ -309,6 +313,7 @@ static int FUZ_test(U32 seed, const U32 nbCycles, const U32 startCycle, const do
     void* CNBuffer;
     char* compressedBuffer;
     char* decodedBuffer;
+    char* batchBuffer;
 #   define FUZ_max   LZ4_COMPRESSBOUND(LEN)
     int ret;
     unsigned cycleNb;
@@ -334,6 +339,7 @@ static int FUZ_test(U32 seed, const U32 nbCycles, const U32 startCycle, const do
     FUZ_fillCompressibleNoiseBuffer(CNBuffer, COMPRESSIBLE_NOISE_LENGTH, compressibility, &randState);
     compressedBuffer = (char*)malloc(LZ4_compressBound(FUZ_MAX_BLOCK_SIZE));
     decodedBuffer = (char*)malloc(FUZ_MAX_DICT_SIZE + FUZ_MAX_BLOCK_SIZE);
+    batchBuffer = (char*)malloc(LZ4_compressBound(FUZ_MAX_BLOCK_SIZE) + FUZ_MAX_BATCH*16);
 
     // move to startCycle
     for (cycleNb = 0; cycleNb < startCycle; cycleNb++)
@@ -441,6 +447,15 @@ static int FUZ_test(U32 seed, const U32 nbCycles, const U32 startCycle, const do
         crcCheck = XXH32(decodedBuffer, blockSize, 0);
         FUZ_CHECKTEST(crcCheck!=crcOrig, "LZ4_decompress_safe corrupted decoded data");
 
+        // Test scalar decoding, bypassing the vector decoder selected at runtime => must work
+        FUZ_DISPLAYTEST;
+        decodedBuffer[blockSize] = 0;
+        ret = LZ4_decompress_safe_forceScalar(compressedBuffer, decodedBuffer, compressedSize, blockSize);
+        FUZ_CHECKTEST(ret!=blockSize, "LZ4_decompress_safe_forceScalar did not regenerate original data");
+        FUZ_CHECKTEST(decodedBuffer[blockSize], "LZ4_decompress_safe_forceScalar overrun specified output buffer size");
+        crcCheck = XXH32(decodedBuffer, blockSize, 0);
+        FUZ_CHECKTEST(crcCheck!=crcOrig, "LZ4_decompress_safe_forceScalar corrupted decoded data");
+
         // Test decoding with more than enough output size => must work
         FUZ_DISPLAYTEST;
         decodedBuffer[blockSize] = 0;
@@ -538,6 +553,66 @@ static int FUZ_test(U32 seed, const U32 nbCycles, const U32 startCycle, const do
             FUZ_CHECKTEST(compressedBuffer[HCcompressedSize-missingBytes], "LZ4_compressHC_limitedOutput overran output buffer ! (%i missingBytes)", missingBytes)
         }
 
+        /* Test batch compression : block is cut into independent pieces */
+        FUZ_DISPLAYTEST;
+        {
+            const char* sources[FUZ_MAX_BATCH];
+            char* dests[FUZ_MAX_BATCH];
+            int sizes[FUZ_MAX_BATCH], capacities[FUZ_MAX_BATCH], results[FUZ_MAX_BATCH];
+            int nbPieces = (FUZ_rand(&randState) % FUZ_MAX_BATCH) + 1;
+            int n, pos = 0;
+            char* op = batchBuffer;
+            for (n=0; n<nbPieces; n++)
+            {
+                sizes[n] = (n==nbPieces-1) ? blockSize-pos : (int)(FUZ_rand(&randState) % (blockSize-pos+1)) >> (FUZ_rand(&randState) % 10);
+                sources[n] = block + pos; pos += sizes[n];
+                dests[n] = op;
+                capacities[n] = LZ4_compressBound(sizes[n]); op += capacities[n];
+            }
+            ret = LZ4_compress_batch_withState(stateLZ4, sources, sizes, dests, capacities, results, nbPieces);
+            FUZ_CHECKTEST(ret, "LZ4_compress_batch_withState() failed on %i inputs", ret);
+            for (n=0; n<nbPieces; n++)
+            {
+                ret = LZ4_decompress_safe(dests[n], decodedBuffer, results[n], sizes[n]);
+                FUZ_CHECKTEST(ret!=sizes[n], "LZ4_compress_batch_withState() : piece %i of %i not regenerated", n, nbPieces);
+                FUZ_CHECKTEST(memcmp(decodedBuffer, sources[n], sizes[n]), "LZ4_compress_batch_withState() : piece %i of %i corrupted", n, nbPieces);
+            }
+
+            /* batch decompression : pieces are regenerated next to each other, back into the original block */
+            {
+                char* decDests[FUZ_MAX_BATCH];
+                int decResults[FUZ_MAX_BATCH];
+                for (n=0; n<nbPieces; n++) decDests[n] = decodedBuffer + (sources[n]-block);
+                ret = LZ4_decompress_safe_batch((const char* const*)dests, decDests, results, sizes, decResults, nbPieces);
+                FUZ_CHECKTEST(ret, "LZ4_decompress_safe_batch() failed on %i blocks", ret);
+                for (n=0; n<nbPieces; n++)
+                    FUZ_CHECKTEST(decResults[n]!=sizes[n], "LZ4_decompress_safe_batch() : piece %i of %i not regenerated", n, nbPieces);
+                FUZ_CHECKTEST(memcmp(decodedBuffer, block, blockSize), "LZ4_decompress_safe_batch() : block corrupted");
+
+                /* output buffer one byte too small for one non-empty piece => only this piece must fail */
+                n = FUZ_rand(&randState) % nbPieces;
+                if (sizes[n])
+                {
+                    char* const last = decDests[n] + sizes[n] - 1;
+                    int const capacity = sizes[n];
+                    *last = ~block[(sources[n]-block) + sizes[n] - 1];
+                    sizes[n]--;
+                    ret = LZ4_decompress_safe_batch((const char* const*)dests, decDests, results, sizes, decResults, nbPieces);
+                    sizes[n] = capacity;
+                    FUZ_CHECKTEST((ret!=1) || (decResults[n]>=0), "LZ4_decompress_safe_batch() should have failed on piece %i only", n);
+                    FUZ_CHECKTEST(*last != (char)~block[(sources[n]-block) + sizes[n] - 1], "LZ4_decompress_safe_batch() overran output buffer of piece %i", n);
+                }
+            }
+
+            /* output buffer one byte too small for one piece => only this piece must fail */
+            n = FUZ_rand(&randState) % nbPieces;
+            capacities[n] = results[n]-1;
+            dests[n][capacities[n]] = 0;
+            ret = LZ4_compress_batch_withState(stateLZ4, sources, sizes, dests, capacities, results, nbPieces);
+            FUZ_CHECKTEST((ret!=1) || results[n], "LZ4_compress_batch_withState() should have failed on piece %i only", n);
+            FUZ_CHECKTEST(dests[n][capacities[n]], "LZ4_compress_batch_withState() overran output buffer of piece %i", n);
+        }
+
 
         /********************/
         /* Dictionary tests */
@@ -693,6 +768,7 @@ _exit:
         free(CNBuffer);
         free(compressedBuffer);
         free(decodedBuffer);
+        free(batchBuffer);
         free(stateLZ4);
         free(stateLZ4HC);
         return result;
@@ -725,6 +801,29 @@ static void FUZ_unitTests(void)
     // 32-bits address space overflow test
     FUZ_AddressOverflow();
 
+    // CPU kernels test : kernels selected at runtime must produce the same compressed data as baseline ones
+    {
+        const int inputSize = 32 KB;
+        char* const cSelected = testCompressed;
+        char* const cBaseline = testCompressed + LZ4_COMPRESSBOUND(32 KB);
+        int hc, result;
+
+        for (hc=0; hc<2; hc++)
+        {
+            int selectedSize, baselineSize;
+            LZ4_limitCpuFeatures(~0U);
+            selectedSize = hc ? LZ4_compressHC(testInput, cSelected, inputSize) : LZ4_compress(testInput, cSelected, inputSize);
+            LZ4_limitCpuFeatures(0);
+            baselineSize = hc ? LZ4_compressHC(testInput, cBaseline, inputSize) : LZ4_compress(testInput, cBaseline, inputSize);
+            FUZ_CHECKTEST(selectedSize==0, "CPU kernels : compression failed");
+            FUZ_CHECKTEST((selectedSize!=baselineSize) || memcmp(cSelected, cBaseline, selectedSize), "CPU kernels : %s differs from baseline", LZ4_kernelName());
+
+            result = LZ4_decompress_safe(cSelected, testVerify, selectedSize, inputSize);
+            FUZ_CHECKTEST((result!=inputSize) || memcmp(testVerify, testInput, inputSize), "CPU kernels : baseline decoder failed");
+        }
+        LZ4_limitCpuFeatures(~0U);
+    }
+
     // LZ4 streaming tests
     {
         LZ4_stream_t* statePtr;
@@ -792,6 +891,23 @@ static void FUZ_unitTests(void)
                 if (dNext + messageSize > dBufferSize) dNext = 0;
             }
         }
+
+        // fast reset test : after LZ4_resetStream_fast(), each message is compressed independently
+        {
+            U32 msgNb;
+            LZ4_resetStream(&streamingState);
+            for (msgNb=0; msgNb<64; msgNb++)
+            {
+                const U32 messageSize = (FUZ_rand(&randState) & 1023) + 1;   /* above 512 bytes, table gets cleared */
+                const char* const message = testInput + (FUZ_rand(&randState) % (testInputSize - messageSize));
+                LZ4_resetStream_fast(&streamingState);
+                result = LZ4_compress_limitedOutput_continue(&streamingState, message, testCompressed, messageSize, LZ4_compressBound(messageSize));
+                FUZ_CHECKTEST(result==0, "LZ4_resetStream_fast() : compression of message %u failed", msgNb);
+                result = LZ4_decompress_safe(testCompressed, testVerify, result, messageSize);
+                FUZ_CHECKTEST(result!=(int)messageSize, "LZ4_resetStream_fast() : message %u not regenerated", msgNb);
+                FUZ_CHECKTEST(memcmp(testVerify, message, messageSize), "LZ4_resetStream_fast() : message %u corrupted", msgNb);
+            }
+        }
     }
 
     // LZ4 HC streaming tests
@@ -819,6 +935,26 @@ static void FUZ_unitTests(void)
         crcNew = XXH64(testVerify, testCompressedSize, 0);
         FUZ_CHECKTEST(crcOrig!=crcNew, "LZ4_decompress_safe() decompression corruption");
 
+        // fast reset test : each message is compressed exactly as with a fresh state
+        {
+            LZ4_streamHC_t* const refState = LZ4_createStreamHC();
+            char* const refCompressed = testVerify + testCompressedSize;
+            U32 msgNb;
+            FUZ_CHECKTEST(refState==NULL, "LZ4_createStreamHC() allocation failed");
+            for (msgNb=0; msgNb<32; msgNb++)
+            {
+                const int level = (int)(FUZ_rand(&randState) % 12) + 1;
+                const U32 messageSize = (FUZ_rand(&randState) % ((FUZ_rand(&randState) & 1) ? 60 KB : 1 KB)) + 1;
+                const char* const message = testInput + (FUZ_rand(&randState) % (testInputSize - messageSize));
+                const int refSize = LZ4_compressHC2_limitedOutput_withStateHC(refState, message, refCompressed, messageSize, LZ4_compressBound(messageSize), level);
+                LZ4_resetStreamHC_fast(&sHC, level);
+                result = LZ4_compressHC_limitedOutput_continue(&sHC, message, testCompressed, messageSize, LZ4_compressBound(messageSize));
+                FUZ_CHECKTEST(result==0, "LZ4_resetStreamHC_fast() : compression of message %u failed", msgNb);
+                FUZ_CHECKTEST((result!=refSize) || memcmp(testCompressed, refCompressed, result), "LZ4_resetStreamHC_fast() : message %u differs from fresh state compression", msgNb);
+            }
+            LZ4_freeStreamHC(refState);
+        }
+
         // simple dictionary compression test
         crcOrig = XXH64(testInput + 64 KB, testCompressedSize, 0);
         LZ4_resetStreamHC(&sHC, 0);
@@ -60,6 +60,7 @@
 #include <string.h>   /* strcmp, strlen */
 #include "bench.h"    /* BMK_benchFile, BMK_SetNbIterations, BMK_SetBlocksize, BMK_SetPause */
 #include "lz4io.h"    /* LZ4IO_compressFilename, LZ4IO_decompressFilename, LZ4IO_compressMultipleFilenames */
+#include "dictbuilder.h"   /* DiB_trainFromFiles */
 
 
 /****************************
@@ -89,6 +90,7 @@
 #define LZ4_EXTENSION ".lz4"
 #define LZ4CAT "lz4cat"
 #define UNLZ4 "unlz4"
+#define DICTIONARY_DEFAULT "dictionary"
 
 #define KB *(1U<<10)
 #define MB *(1U<<20)
@@ -172,10 +174,15 @@ static int usage_advanced(void)
     DISPLAY( " -l     : compress using Legacy format (Linux kernel compression)\n");
     DISPLAY( " -B#    : Block size [4-7](default : 7)\n");
     DISPLAY( " -BD    : Block dependency (improve compression ratio)\n");
-    /* DISPLAY( " -BX    : enable block checksum (default:disabled)\n");   *//* Option currently inactive */
+    DISPLAY( " -BX    : enable block checksum (default:disabled)\n");
     DISPLAY( "--no-frame-crc : disable stream checksum (default:enabled)\n");
     DISPLAY( "--content-size : compressed frame includes original size (default:not present)\n");
     DISPLAY( "--sparse       : enable sparse file (default:disabled)(experimental)\n");
+    DISPLAY( " -D file: use file as dictionary (compression, decompression and benchmark)\n");
+    DISPLAY( "Dictionary builder :\n");
+    DISPLAY( "--train files   : create a dictionary from a set of sample files (implies -m)\n");
+    DISPLAY( " -D file        : dictionary file name (default : %s)\n", DICTIONARY_DEFAULT);
+    DISPLAY( "--maxdict=#     : limit dictionary to # bytes, or # KB with a K suffix (default : 64 KB)\n");
     DISPLAY( "Benchmark arguments :\n");
     DISPLAY( " -b     : benchmark file(s)\n");
     DISPLAY( " -i#    : iteration loops [1-9](default : 3), benchmark mode only\n");
@@ -255,6 +262,26 @@ static void waitEnter(void)
 }
 
 
+/* load the last 64 KB of dictFileName (LZ4 cannot reference more); result must be freed */
+static void* loadDictionary(const char* dictFileName, size_t* dictSize)
+{
+    FILE* const dictFile = fopen(dictFileName, "rb");
+    void* dict;
+    long fileSize;
+    if (dictFile==NULL) EXM_THROW(20, "Pb opening dictionary %s", dictFileName);
+    if (fseek(dictFile, 0, SEEK_END)) EXM_THROW(21, "Pb reading dictionary %s", dictFileName);
+    fileSize = ftell(dictFile);
+    if (fileSize < 0) EXM_THROW(21, "Pb reading dictionary %s", dictFileName);
+    *dictSize = (fileSize > (long)(64 KB)) ? 64 KB : (size_t)fileSize;
+    dict = malloc(*dictSize + 1);
+    if (dict==NULL) EXM_THROW(22, "Allocation error : not enough memory");
+    if (fseek(dictFile, fileSize - (long)*dictSize, SEEK_SET)
+        || (fread(dict, 1, *dictSize, dictFile) != *dictSize)) EXM_THROW(21, "Pb reading dictionary %s", dictFileName);
+    fclose(dictFile);
+    return dict;
+}
+
+
 int main(int argc, char** argv)
 {
     int i,
@@ -265,9 +292,14 @@ int main(int argc, char** argv)
         forceStdout=0,
         forceCompress=0,
         main_pause=0,
-        multiple_inputs=0;
+        multiple_inputs=0,
+        train=0;
     const char* input_filename=0;
     const char* output_filename=0;
+    const char* dictFileName=0;
+    void* dict=0;
+    size_t dictSize=0;
+    size_t maxDictSize = DIB_DICTSIZE_MAX;
     char* dynNameSpace=0;
     const char** inFileNames = NULL;
     unsigned ifnIdx=0;
@@ -310,6 +342,23 @@ int main(int argc, char** argv)
         if (!strcmp(argument, "--quiet")) { if (displayLevel) displayLevel--; continue; }
         if (!strcmp(argument, "--version")) { DISPLAY(WELCOME_MESSAGE); return 0; }
         if (!strcmp(argument, "--keep")) { continue; }   /* keep source file (default anyway; just for xz/lzma compatibility) */
+        if (!strcmp(argument, "--train"))
+        {
+            train=1; multiple_inputs=1;
+            if (inFileNames == NULL)
+                inFileNames = (const char**) malloc(argc * sizeof(char*));
+            continue;
+        }
+        if (!strncmp(argument, "--maxdict=", 10))
+        {
+            const char* p = argument + 10;
+            maxDictSize = 0;
+            while ((*p >= '0') && (*p <= '9')) { maxDictSize *= 10; maxDictSize += *p - '0'; p++; }
+            if ((*p=='K') || (*p=='k')) { maxDictSize <<= 10; p++; }
+            if (*p || (maxDictSize==0)) badusage();
+            if (maxDictSize > DIB_DICTSIZE_MAX) maxDictSize = DIB_DICTSIZE_MAX;
+            continue;
+        }
 
         /* Short commands (note : aggregated short commands are allowed) */
         if (argument[0]=='-')
@@ -399,7 +448,7 @@ int main(int argc, char** argv)
                             break;
                         }
                         case 'D': LZ4IO_setBlockMode(LZ4IO_blockLinked); argument++; break;
-                        case 'X': LZ4IO_setBlockChecksumMode(1); argument ++; break;   /* currently disabled */
+                        case 'X': LZ4IO_setBlockChecksumMode(1); argument ++; break;
                         default : exitBlockProperties=1;
                         }
                         if (exitBlockProperties) break;
@@ -428,6 +477,12 @@ int main(int argc, char** argv)
                     }
                     break;
 
+                    /* Dictionary file (next argument) */
+                case 'D':
+                    if ((argument[1]!=0) || (i+1 >= argc)) badusage();
+                    dictFileName = argv[++i];
+                    break;
+
                     /* Pause at the end (hidden option) */
                 case 'p': main_pause=1; BMK_setPause(); break;
 
@@ -469,6 +524,25 @@ int main(int argc, char** argv)
     /* Check if input or output are defined as console; trigger an error in this case */
     if (!strcmp(input_filename, stdinmark) && IS_CONSOLE(stdin) ) badusage();
 
+    /* Check if dictionary training is selected */
+    if (train)
+    {
+        int result;
+        if (ifnIdx==0) badusage();
+        DiB_setNotificationLevel(displayLevel);
+        result = DiB_trainFromFiles(dictFileName ? dictFileName : DICTIONARY_DEFAULT, maxDictSize, inFileNames, ifnIdx, cLevel);
+        free((void*)inFileNames);
+        return result;
+    }
+
+    /* Load dictionary */
+    if (dictFileName)
+    {
+        dict = loadDictionary(dictFileName, &dictSize);
+        BMK_setDictionary(dict, dictSize);
+        if (LZ4IO_setDictionary(dict, dictSize)) EXM_THROW(22, "Allocation error : not enough memory");
+    }
+
     /* Check if benchmark is selected */
     if (bench) return BMK_benchFiles(inFileNames, ifnIdx, cLevel);
 
@@ -534,6 +608,8 @@ int main(int argc, char** argv)
     }
 
     if (main_pause) waitEnter();
+    LZ4IO_setDictionary(NULL, 0);
+    free(dict);
     free(dynNameSpace);
     free((void*)inFileNames);
     return 0;
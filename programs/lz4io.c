@@ -56,6 +56,9 @@
 #include "lz4.h"      /* still required for legacy format */
 #include "lz4hc.h"    /* still required for legacy format */
 #include "lz4frame.h"
+#include "lz4frame_static.h"   /* LZ4F_insertBlock, LZ4F_CDict */
+#include "lz4g.h"     /* LZ4G_sparseWrite, LZ4G_skipHole */
+#include "xxhash.h"   /* XXH32, dictionary ID */
 
 
 /******************************
@@ -104,9 +107,6 @@
 #define MIN_STREAM_BUFSIZE (192 KB)
 #define LZ4IO_BLOCKSIZEID_DEFAULT 7
 
-#define sizeT sizeof(size_t)
-#define maskT (sizeT - 1)
-
 
 /**************************************
 *  Macros
@@ -133,6 +133,10 @@ static int g_streamChecksum = 1;
 static int g_blockIndependence = 1;
 static int g_sparseFileSupport = 0;
 static int g_contentSizeFlag = 0;
+static const void* g_dict = NULL;
+static size_t g_dictSize = 0;
+static unsigned g_dictID = 0;
+static LZ4F_CDict* g_cdict = NULL;
 
 static const int minBlockSizeID = 4;
 static const int maxBlockSizeID = 7;
@@ -223,6 +227,23 @@ int LZ4IO_setContentSize(int enable)
     return g_contentSizeFlag;
 }
 
+/* Default setting : no dictionary */
+int LZ4IO_setDictionary(const void* dict, size_t dictSize)
+{
+    LZ4F_freeCDict(g_cdict);
+    g_cdict = NULL;
+    g_dict = NULL; g_dictSize = 0; g_dictID = 0;
+    if ((dict==NULL) || (dictSize==0)) return 0;
+    if (dictSize > 64 KB) { dict = (const char*)dict + dictSize - 64 KB; dictSize = 64 KB; }
+    g_cdict = LZ4F_createCDict(dict, dictSize);
+    if (g_cdict==NULL) return 1;
+    g_dict = dict;
+    g_dictSize = dictSize;
+    g_dictID = XXH32(dict, (unsigned)dictSize, 0);
+    if (g_dictID==0) g_dictID = 1;   /* 0 means no dictionary */
+    return 0;
+}
+
 static unsigned LZ4IO_GetMilliSpan(clock_t nPrevious)
 {
     clock_t nCurrent = clock();
@@ -403,7 +424,11 @@ int LZ4IO_compressFilename(const char* input_filename, const char* output_filena
     FILE* foutput;
     clock_t start, end;
     int blockSize;
+    char* zeroBlock;
     size_t sizeCheck, headerSize, readSize, outBuffSize;
+    size_t zeroBlockSize = 0;
+    unsigned long long dataEnd = 0;
+    int inZero = 0;
     LZ4F_compressionContext_t ctx;
     LZ4F_errorCode_t errorCode;
     LZ4F_preferences_t prefs;
@@ -424,6 +449,8 @@ int LZ4IO_compressFilename(const char* input_filename, const char* output_filena
     prefs.frameInfo.blockMode = (blockMode_t)g_blockIndependence;
     prefs.frameInfo.blockSizeID = (blockSizeID_t)g_blockSizeId;
     prefs.frameInfo.contentChecksumFlag = (contentChecksum_t)g_streamChecksum;
+    prefs.frameInfo.blockChecksumFlag = (blockChecksum_t)g_blockChecksum;
+    prefs.frameInfo.dictID = g_dictID;
     if (g_contentSizeFlag)
     {
       unsigned long long fileSize = LZ4IO_GetFileSize(input_filename);
@@ -433,38 +460,49 @@ int LZ4IO_compressFilename(const char* input_filename, const char* output_filena
     /* Allocate Memory */
     in_buff  = (char*)malloc(blockSize);
     outBuffSize = LZ4F_compressBound(blockSize, &prefs);
-    out_buff = (char*)malloc(outBuffSize);
+    out_buff = (char*)malloc(2*outBuffSize);   /* second half keeps a compressed block of zeroes */
     if (!in_buff || !out_buff) EXM_THROW(31, "Allocation error : not enough memory");
+    zeroBlock = out_buff + outBuffSize;
 
     /* Write Archive Header */
-    headerSize = LZ4F_compressBegin(ctx, out_buff, outBuffSize, &prefs);
+    headerSize = LZ4F_compressBegin_usingCDict(ctx, out_buff, outBuffSize, g_cdict, &prefs);
     if (LZ4F_isError(headerSize)) EXM_THROW(32, "File header generation failed : %s", LZ4F_getErrorName(headerSize));
     sizeCheck = fwrite(out_buff, 1, headerSize, foutput);
     if (sizeCheck!=headerSize) EXM_THROW(33, "Write error : cannot write header");
     compressedfilesize += headerSize;
 
-    /* read first block */
-    readSize = fread(in_buff, (size_t)1, (size_t)blockSize, finput);
-    filesize += readSize;
-
-    /* Main Loop */
-    while (readSize>0)
+    /* Main Loop : blocks within holes of sparse inputs are not read */
+    for (;;)
     {
         size_t outSize;
 
-        /* Compress Block */
-        outSize = LZ4F_compressUpdate(ctx, out_buff, outBuffSize, in_buff, readSize, NULL);
+        /* Read Block */
+        if (LZ4G_skipHole(finput, (size_t)blockSize, &dataEnd))
+        {
+            if (!inZero) { memset(in_buff, 0, blockSize); inZero = 1; }
+            readSize = blockSize;
+        }
+        else
+        {
+            inZero = 0;
+            readSize = fread(in_buff, (size_t)1, (size_t)blockSize, finput);
+            if (readSize == 0) break;
+        }
+        filesize += readSize;
+
+        /* Compress Block (a block of zeroes is only compressed once with independent blocks) */
+        if (inZero && zeroBlockSize)
+            outSize = LZ4F_insertBlock(ctx, out_buff, outBuffSize, in_buff, readSize, zeroBlock, zeroBlockSize);
+        else
+            outSize = LZ4F_compressUpdate(ctx, out_buff, outBuffSize, in_buff, readSize, NULL);
         if (LZ4F_isError(outSize)) EXM_THROW(34, "Compression failed : %s", LZ4F_getErrorName(outSize));
+        if (inZero && !zeroBlockSize && g_blockIndependence) { memcpy(zeroBlock, out_buff, outSize); zeroBlockSize = outSize; }
         compressedfilesize += outSize;
         DISPLAYUPDATE(3, "\rRead : %i MB   ==> %.2f%%   ", (int)(filesize>>20), (double)compressedfilesize/filesize*100);
 
         /* Write Block */
         sizeCheck = fwrite(out_buff, 1, outSize, foutput);
         if (sizeCheck!=outSize) EXM_THROW(35, "Write error : cannot write compressed block");
-
-        /* Read next block */
-        readSize = fread(in_buff, (size_t)1, (size_t)blockSize, finput);
-        filesize += readSize;
     }
 
     /* End of Stream mark */
@@ -594,7 +632,7 @@ static unsigned long long decodeLZ4S(FILE* finput, FILE* foutput)
     const size_t outBuffSize = 256 KB;
     LZ4F_decompressionContext_t ctx;
     LZ4F_errorCode_t errorCode;
-    unsigned storedSkips = 0;
+    unsigned long long storedSkips = 0;
 
     /* init */
     errorCode = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
@@ -606,13 +644,28 @@ static unsigned long long decodeLZ4S(FILE* finput, FILE* foutput)
     outBuff = malloc(256 KB);
     if (!inBuff || !outBuff) EXM_THROW(61, "Allocation error : not enough memory");
 
-    /* Init feed with magic number (already consumed from FILE) */
+    /* Init feed with frame header (magic number already consumed from FILE), to check its dictionary ID */
     {
-        size_t inSize = 4;
-        size_t outSize=0;
-        LZ4IO_writeLE32(inBuff, LZ4IO_MAGICNUMBER);
-        errorCode = LZ4F_decompress(ctx, outBuff, &outSize, inBuff, &inSize, NULL);
+        size_t headerSize = MAGICNUMBER_SIZE + 2;
+        size_t inSize, outSize=0;
+        unsigned FLG;
+        LZ4F_frameInfo_t frameInfo;
+        if (fread(headerBuff+MAGICNUMBER_SIZE, 1, 2, finput) != 2) EXM_THROW(62, "Header error : unexpected end of file");
+        FLG = (unsigned char)headerBuff[4];
+        headerSize += ((FLG >> 3) & _1BIT) * 8 + (FLG & _1BIT) * 4 + 1;   /* content size, dictionary ID, header checksum */
+        if (fread(headerBuff+MAGICNUMBER_SIZE+2, 1, headerSize-(MAGICNUMBER_SIZE+2), finput) != headerSize-(MAGICNUMBER_SIZE+2))
+            EXM_THROW(62, "Header error : unexpected end of file");
+        inSize = headerSize;
+        errorCode = LZ4F_decompress_usingDict(ctx, outBuff, &outSize, headerBuff, &inSize, g_dict, g_dictSize, NULL);
         if (LZ4F_isError(errorCode)) EXM_THROW(62, "Header error : %s", LZ4F_getErrorName(errorCode));
+        inSize = 0;
+        errorCode = LZ4F_getFrameInfo(ctx, &frameInfo, NULL, &inSize);
+        if (LZ4F_isError(errorCode)) EXM_THROW(62, "Header error : %s", LZ4F_getErrorName(errorCode));
+        if (frameInfo.dictID && (frameInfo.dictID != g_dictID))
+        {
+            if (g_dictID==0) EXM_THROW(63, "Dictionary error : frame requires dictionary %08X (use -D)", frameInfo.dictID);
+            EXM_THROW(63, "Dictionary error : frame requires dictionary %08X, not %08X", frameInfo.dictID, g_dictID);
+        }
     }
 
 
@@ -631,7 +684,7 @@ static unsigned long long decodeLZ4S(FILE* finput, FILE* foutput)
             /* Decode Input (at least partially) */
             size_t remaining = readSize - pos;
             size_t decodedBytes = outBuffSize;
-            errorCode = LZ4F_decompress(ctx, outBuff, &decodedBytes, (char*)inBuff+pos, &remaining, NULL);
+            errorCode = LZ4F_decompress_usingDict(ctx, outBuff, &decodedBytes, (char*)inBuff+pos, &remaining, g_dict, g_dictSize, NULL);
             if (LZ4F_isError(errorCode)) EXM_THROW(66, "Decompression error : %s", LZ4F_getErrorName(errorCode));
             pos += remaining;
 
@@ -641,55 +694,7 @@ static unsigned long long decodeLZ4S(FILE* finput, FILE* foutput)
                 filesize += decodedBytes;
                 if (g_sparseFileSupport)
                 {
-                    size_t* const oBuffStartT = (size_t*)outBuff;   /* since outBuff is malloc'ed, it's aligned on size_t */
-                    size_t* oBuffPosT = oBuffStartT;
-                    size_t  oBuffSizeT = decodedBytes / sizeT;
-                    size_t* const oBuffEndT = oBuffStartT + oBuffSizeT;
-                    static const size_t bs0T = (32 KB) / sizeT;
-                    while (oBuffPosT < oBuffEndT)
-                    {
-                        size_t seg0SizeT = bs0T;
-                        size_t nb0T;
-                        int seekResult;
-                        if (seg0SizeT > oBuffSizeT) seg0SizeT = oBuffSizeT;
-                        oBuffSizeT -= seg0SizeT;
-                        for (nb0T=0; (nb0T < seg0SizeT) && (oBuffPosT[nb0T] == 0); nb0T++) ;
-                        storedSkips += (unsigned)(nb0T * sizeT);
-                        if (storedSkips > 1 GB)   /* avoid int overflow */
-                        {
-                            seekResult = fseek(foutput, 1 GB, SEEK_CUR);
-                            if (seekResult != 0) EXM_THROW(68, "1 GB skip error (sparse file)");
-                            storedSkips -= 1 GB;
-                        }
-                        if (nb0T != seg0SizeT)   /* not all 0s */
-                        {
-                            seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-                            if (seekResult) EXM_THROW(68, "Skip error (sparse file)");
-                            storedSkips = 0;
-                            seg0SizeT -= nb0T;
-                            oBuffPosT += nb0T;
-                            sizeCheck = fwrite(oBuffPosT, sizeT, seg0SizeT, foutput);
-                            if (sizeCheck != seg0SizeT) EXM_THROW(68, "Write error : cannot write decoded block");
-                        }
-                        oBuffPosT += seg0SizeT;
-                    }
-                    if (decodedBytes & maskT)   /* size not multiple of sizeT (necessarily end of block) */
-                    {
-                        const char* const restStart = (char*)oBuffEndT;
-                        const char* restPtr = restStart;
-                        size_t  restSize =  decodedBytes & maskT;
-                        const char* const restEnd = restStart + restSize;
-                        for (; (restPtr < restEnd) && (*restPtr == 0); restPtr++) ;
-                        storedSkips += (unsigned) (restPtr - restStart);
-                        if (restPtr != restEnd)
-                        {
-                            int seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-                            if (seekResult) EXM_THROW(68, "Skip error (end of block)");
-                            storedSkips = 0;
-                            sizeCheck = fwrite(restPtr, 1, restEnd - restPtr, foutput);
-                            if (sizeCheck != (size_t)(restEnd - restPtr)) EXM_THROW(68, "Write error : cannot write decoded end of block");
-                        }
-                    }
+                    if (LZ4G_sparseWrite(foutput, outBuff, decodedBytes, &storedSkips)) EXM_THROW(68, "Write error : cannot write decoded block (sparse file)");
                 }
                 else
                 {
@@ -701,16 +706,7 @@ static unsigned long long decodeLZ4S(FILE* finput, FILE* foutput)
 
     }
 
-    if ((g_sparseFileSupport) && (storedSkips>0))
-    {
-        int seekResult;
-        storedSkips --;
-        seekResult = fseek(foutput, storedSkips, SEEK_CUR);
-        if (seekResult != 0) EXM_THROW(69, "Final skip error (sparse file)\n");
-        memset(outBuff, 0, 1);
-        sizeCheck = fwrite(outBuff, 1, 1, foutput);
-        if (sizeCheck != 1) EXM_THROW(69, "Write error : cannot write last zero\n");
-    }
+    if ((g_sparseFileSupport) && LZ4G_sparseWriteEnd(foutput, storedSkips)) EXM_THROW(69, "Write error : cannot write last zero (sparse file)\n");
 
     /* Free */
     free(inBuff);
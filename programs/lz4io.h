@@ -31,6 +31,8 @@
 
 #pragma once
 
+#include <stddef.h>   /* size_t */
+
 /* ************************************************** */
 /* Special input/output values                        */
 /* ************************************************** */
@@ -84,3 +86,9 @@ int LZ4IO_setSparseFile(int enable);
 
 /* Default setting : 0 (disabled) */
 int LZ4IO_setContentSize(int enable);
+
+/* dict : use a dictionary, typically trained with lz4 --train, to compress and decompress frames (only its last 64 KB are used).
+          The buffer is not copied, and must remain valid while files are processed.
+          Frames record the dictionary ID; decompression checks it.
+   return : 0 on success, 1 on allocation error */
+int LZ4IO_setDictionary(const void* dict, size_t dictSize);